@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MONO_CLOCK_H
+#define MONO_CLOCK_H
+
+#include<stdint.h>
+#include<sys/time.h>
+
+/* Process-wide monotonic time source, immune to wall-clock jumps.
+ *
+ * mono_clock_now() reads a per-thread cached value while an event loop
+ * iteration holds it (mono_clock_update() ... mono_clock_release()), so
+ * the many timestamps taken while handling one event cost a single clock
+ * read; outside of it, the clock is read every time.
+ * mono_clock_precise() always reads the clock, with full resolution, and
+ * it is meant for pacing (e.g., network shaping).
+ * A fake clock, moved only by hand, makes time-dependent tests
+ * deterministic. */
+
+enum mono_clock_mode {MONO_CLOCK_COARSE, MONO_CLOCK_PRECISE, MONO_CLOCK_FAKE};
+
+/* the mode is process-wide: it applies to every thread and every
+ * psinstance in the process, so set it once at start up */
+void mono_clock_set_mode(enum mono_clock_mode mode);
+
+enum mono_clock_mode mono_clock_mode(void);
+
+void mono_clock_now(struct timeval *tv);
+
+void mono_clock_precise(struct timeval *tv);
+
+uint64_t mono_clock_us(void);
+
+/* caches the current time for the running loop iteration */
+void mono_clock_update(void);
+
+void mono_clock_release(void);
+
+/* switches to the fake clock, starting from us microseconds */
+void mono_clock_fake_set(uint64_t us);
+
+void mono_clock_fake_advance(uint64_t us);
+
+#endif
@@ -22,6 +22,7 @@
 #ifndef NET_HELPERS_H
 #define NET_HELPERS_H
 
+#include<sys/uio.h>
 #include<net_helper.h>
 
 #define NODE_STR_LENGTH 80
@@ -42,4 +43,13 @@ void net_helper_periodic(struct nodeID *s, struct timeval * interval);
 
 void net_helper_deinit(struct nodeID *s);
 
+size_t net_helper_outqueue_length(const struct nodeID *s);
+
+/* remote nodes with fragment reassembly or queueing state */
+size_t net_helper_endpoints(const struct nodeID *s);
+
+/* as send_to_peer, the message being the concatenation of the iovcnt
+ * buffers of iov */
+int send_to_peerv(const struct nodeID *from, const struct nodeID *to, const struct iovec *iov, int iovcnt);
+
 #endif	/* NET_HELPERS_H */
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<time.h>
+#include<mono_clock.h>
+
+#ifdef CLOCK_MONOTONIC_COARSE
+#define COARSE_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define COARSE_CLOCK CLOCK_MONOTONIC
+#endif
+
+static enum mono_clock_mode clock_mode = MONO_CLOCK_COARSE;  // shared by all the threads and instances
+static uint64_t fake_now = 0;
+static __thread struct timeval cached_now;
+static __thread int8_t cache_valid = 0;
+
+static void us2timeval(uint64_t us, struct timeval *tv)
+{
+	tv->tv_sec = us / 1000000;
+	tv->tv_usec = us % 1000000;
+}
+
+static void mono_clock_read(clockid_t id, struct timeval *tv)
+{
+	struct timespec ts;
+
+	if (clock_mode == MONO_CLOCK_FAKE)
+		us2timeval(fake_now, tv);
+	else
+	{
+		clock_gettime(id, &ts);
+		tv->tv_sec = ts.tv_sec;
+		tv->tv_usec = ts.tv_nsec / 1000;
+	}
+}
+
+void mono_clock_set_mode(enum mono_clock_mode mode)
+{
+	clock_mode = mode;
+	cache_valid = 0;
+}
+
+enum mono_clock_mode mono_clock_mode(void)
+{
+	return clock_mode;
+}
+
+void mono_clock_now(struct timeval *tv)
+{
+	if (tv)
+	{
+		if (cache_valid)
+			*tv = cached_now;
+		else
+			mono_clock_read(clock_mode == MONO_CLOCK_PRECISE ? CLOCK_MONOTONIC : COARSE_CLOCK, tv);
+	}
+}
+
+void mono_clock_precise(struct timeval *tv)
+{
+	if (tv)
+		mono_clock_read(CLOCK_MONOTONIC, tv);
+}
+
+uint64_t mono_clock_us(void)
+{
+	struct timeval tv;
+
+	mono_clock_now(&tv);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+void mono_clock_update(void)
+{
+	cache_valid = 0;
+	mono_clock_now(&cached_now);
+	cache_valid = 1;
+}
+
+void mono_clock_release(void)
+{
+	cache_valid = 0;
+}
+
+void mono_clock_fake_set(uint64_t us)
+{
+	mono_clock_set_mode(MONO_CLOCK_FAKE);
+	fake_now = us;
+}
+
+void mono_clock_fake_advance(uint64_t us)
+{
+	fake_now += us;
+}
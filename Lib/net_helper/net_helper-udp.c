@@ -204,6 +204,18 @@ int send_to_peer(const struct nodeID *from, const struct nodeID *to, const uint8
 	return sendto(from->fd, buffer_ptr, buffer_size, MSG_CONFIRM, (const struct sockaddr *)&(to->addr), sizeof(struct sockaddr_storage));
 }
 
+int send_to_peerv(const struct nodeID *from, const struct nodeID *to, const struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_name = (void *)&(to->addr);
+	msg.msg_namelen = sizeof(struct sockaddr_storage);
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = iovcnt;
+	return sendmsg(from->fd, &msg, MSG_CONFIRM);
+}
+
 int recv_from_peer(const struct nodeID *local, struct nodeID **remote, uint8_t *buffer_ptr, int buffer_size)
 {
 	struct nodeID * node;
@@ -385,6 +397,16 @@ void net_helper_periodic(struct nodeID *s, struct timeval * interval)
 		interval->tv_sec = 1000;
 }
 
+size_t net_helper_outqueue_length(const struct nodeID *s)
+{
+	return 0;  // messages are sent straight away
+}
+
+size_t net_helper_endpoints(const struct nodeID *s)
+{
+	return 0;
+}
+
 void net_helper_deinit(struct nodeID *s)
 {
 	nodeid_free(s);
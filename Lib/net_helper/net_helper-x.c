@@ -87,6 +87,20 @@ void net_helper_periodic(struct nodeID *s, struct timeval * interval)
 		net_helper_send_attempt(s, interval);
 }
 
+size_t net_helper_outqueue_length(const struct nodeID *s)
+{
+	if (s)
+		return network_manager_outgoing_queue_length(s->nm);
+	return 0;
+}
+
+size_t net_helper_endpoints(const struct nodeID *s)
+{
+	if (s)
+		return network_manager_endpoints(s->nm);
+	return 0;
+}
+
 int wait4data(const struct nodeID *s, struct timeval *tout, int *user_fds)
 /* returns 0 if timeout expires 
  * returns -1 in case of error of the select function
@@ -294,6 +308,21 @@ int send_to_peer(const struct nodeID *from, const struct nodeID *to, const uint8
 	return res >= 0 ? buffer_size : res;
 }
 
+int send_to_peerv(const struct nodeID *from, const struct nodeID *to, const struct iovec *iov, int iovcnt)
+{
+	int8_t res = -1;
+	int i, size = 0;
+
+	for (i = 0; iov && i < iovcnt; i++)
+		size += iov[i].iov_len;
+	if (from && from->nm && to && size > 0)
+	{
+		res = network_manager_enqueue_outgoing_packetv(from->nm, from, to, iov, iovcnt);
+		network_shaper_update_bitrate(from->shaper, size);
+	}
+	return res >= 0 ? size : res;
+}
+
 int recv_from_peer(const struct nodeID *local, struct nodeID **remote, uint8_t *buffer_ptr, int buffer_size)
 {
 	struct nodeID * node;
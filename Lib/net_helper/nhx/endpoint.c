@@ -30,11 +30,11 @@ struct endpoint {  // do not move node parameter
 	packet_id_t out_id;
 };
 
-struct list_head * endpoint_enqueue_outgoing_packet(struct endpoint * e, const struct nodeID * src, const uint8_t * data, size_t data_len)
+struct list_head * endpoint_enqueue_outgoing_packet(struct endpoint * e, const struct nodeID * src, const struct iovec * iov, int iovcnt)
 {
 	struct list_head * res = NULL;
-	if (e && src && data && data_len > 0)
-		res = packet_bucket_add_packet(e->outgoing, src, e->node, e->out_id++, data, data_len);
+	if (e && src && iov && iovcnt > 0)
+		res = packet_bucket_add_packet(e->outgoing, src, e->node, e->out_id++, iov, iovcnt);
 	return res;
 }
 
@@ -36,7 +36,7 @@ void endpoint_destroy(struct endpoint ** e);
 
 int8_t endpoint_cmp(const void * e1, const void *e2);
 
-struct list_head * endpoint_enqueue_outgoing_packet(struct endpoint * e, const struct nodeID * src, const uint8_t * data, size_t data_len);
+struct list_head * endpoint_enqueue_outgoing_packet(struct endpoint * e, const struct nodeID * src, const struct iovec * iov, int iovcnt);
 
 packet_state_t endpoint_add_incoming_fragment(struct endpoint * e, const struct fragment *f, struct list_head * requests);
 
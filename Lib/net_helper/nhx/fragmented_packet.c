@@ -41,13 +41,16 @@ packet_id_t fragmented_packet_id(const struct fragmented_packet *fp)
 	return 0;
 }
 
-struct fragmented_packet * fragmented_packet_create(packet_id_t id, const struct nodeID * from, const struct nodeID *to, const uint8_t * data, size_t data_size, size_t frag_size, struct list_head * msgs)
+struct fragmented_packet * fragmented_packet_create(packet_id_t id, const struct nodeID * from, const struct nodeID *to, const struct iovec * iov, int iovcnt, size_t frag_size, struct list_head * msgs)
 {
 	struct fragmented_packet * fp = NULL;
-	const uint8_t * data_ptr = data;
+	size_t data_size = 0, offset = 0;
 	frag_id_t i;
+	int j;
 
-	if (data && data_size > 0 && frag_size > 0)
+	for (j = 0; iov && j < iovcnt; j++)
+		data_size += iov[j].iov_len;
+	if (data_size > 0 && frag_size > 0)
 	{
 		fp = malloc(sizeof(struct fragmented_packet));
 		fp->packet_id = id;
@@ -59,10 +62,17 @@ struct fragmented_packet * fragmented_packet_create(packet_id_t id, const struct
 		if (data_size % frag_size)
 			fp->frag_num++;
 		fp->frags = malloc(sizeof(struct fragment) * fp->frag_num);
-		for (i = 0; i < fp->frag_num; i++)
+		fp->data = malloc(data_size);  // a single copy shared by the fragments
+		for (j = 0; j < iovcnt; j++)
 		{
-			fragment_init(&(fp->frags[i]), from, to, id, fp->frag_num, i, data+(i*frag_size), MIN(frag_size, data_size), msgs);
-			data_ptr += frag_size; 
+			memcpy(fp->data + offset, iov[j].iov_base, iov[j].iov_len);
+			offset += iov[j].iov_len;
+		}
+		for (i = 0, offset = 0; i < fp->frag_num; i++)
+		{
+			fragment_init(&(fp->frags[i]), from, to, id, fp->frag_num, i, NULL, MIN(frag_size, data_size), msgs);
+			fp->frags[i].data = fp->data + offset;
+			offset += frag_size;
 			data_size -= frag_size;
 		}
 	}
@@ -76,7 +86,13 @@ void fragmented_packet_destroy(struct fragmented_packet ** fp)
 	if (fp && *fp)
 	{
 		for (i = 0; i < (*fp)->frag_num; i++)
+		{
+			if ((*fp)->data)
+				(*fp)->frags[i].data = NULL;  // borrowed from the packet
 			fragment_deinit(&(*fp)->frags[i]);
+		}
+		if ((*fp)->data)
+			free((*fp)->data);
 		free((*fp)->frags);
 		free(*fp);
 		*fp = NULL;
@@ -90,6 +106,7 @@ struct fragmented_packet * fragmented_packet_empty(packet_id_t pid, const struct
 
 	fp = malloc(sizeof(struct fragmented_packet));
 	fp->packet_id = pid;
+	fp->data = NULL;
 	fp->creation_timestamp = time(NULL);
 	INIT_LIST_HEAD(&(fp->list));
 	fp->frag_num = num_frags;
@@ -22,6 +22,7 @@
 #define __FRAGMENTED_PACKET_H__
 
 #include<time.h>
+#include<sys/uio.h>
 #include<fragment.h>
 #include<net_helper.h>
 
@@ -30,6 +31,7 @@ typedef enum packet_state packet_state_t;
 
 struct fragmented_packet {
 	time_t creation_timestamp;
+	uint8_t * data;  // outgoing packets only, their fragments point into it
 	struct fragment * frags;
 	frag_id_t frag_num;
 	struct list_head list;
@@ -42,7 +44,8 @@ packet_id_t fragmented_packet_id(const struct fragmented_packet *fp);
 
 time_t fragmented_packet_creation_timestamp(const struct fragmented_packet *fp);
 
-struct fragmented_packet * fragmented_packet_create(packet_id_t id, const struct nodeID * from, const struct nodeID *to, const uint8_t * data, size_t data_size, size_t frag_size, struct list_head * msgs);
+/* the packet data is gathered from the iovcnt buffers of iov */
+struct fragmented_packet * fragmented_packet_create(packet_id_t id, const struct nodeID * from, const struct nodeID *to, const struct iovec * iov, int iovcnt, size_t frag_size, struct list_head * msgs);
 
 struct fragmented_packet * fragmented_packet_empty(packet_id_t pid, const struct nodeID *from, const struct nodeID *to, frag_id_t num_frags);
 
@@ -30,6 +30,7 @@
 
 struct network_manager {
 	struct list_head outqueue;
+	size_t outqueue_len;
 	struct ord_set * endpoints;
 	size_t frag_size;
 	uint16_t max_pkt_age; // in seconds
@@ -46,6 +47,7 @@ struct network_manager * network_manager_create(const char * config)
 	nm = malloc(sizeof(struct network_manager));
 	nm->endpoints = ord_set_new(10, endpoint_cmp);
 	INIT_LIST_HEAD(&(nm->outqueue));
+	nm->outqueue_len = 0;
 
 	if (config)
 	{
@@ -99,13 +101,33 @@ void network_manager_print_outqueue(const struct network_manager *nm)
 	}
 }
 
+void network_manager_outqueue_splice(struct network_manager *nm, struct list_head * msgs)
+{
+	struct list_head * pos;
+
+	list_for_each(pos, msgs)
+		nm->outqueue_len++;
+	list_splice(msgs, &(nm->outqueue));
+}
+
 int8_t network_manager_enqueue_outgoing_packet(struct network_manager *nm, const struct nodeID *src, const struct nodeID * dst, const uint8_t * data, size_t data_len)
+{
+	struct iovec iov;
+
+	if (data == NULL || data_len == 0)
+		return -1;
+	iov.iov_base = (void *) data;
+	iov.iov_len = data_len;
+	return network_manager_enqueue_outgoing_packetv(nm, src, dst, &iov, 1);
+}
+
+int8_t network_manager_enqueue_outgoing_packetv(struct network_manager *nm, const struct nodeID *src, const struct nodeID * dst, const struct iovec * iov, int iovcnt)
 {
 	int8_t res = -1;
 	struct endpoint * e;
 	struct list_head * frag_list;
 
-	if (nm && dst && data && data_len > 0)
+	if (nm && dst && iov && iovcnt > 0)
 	{
 		e = ord_set_find(nm->endpoints, &dst);
 		if (!e)
@@ -113,10 +135,10 @@ int8_t network_manager_enqueue_outgoing_packet(struct network_manager *nm, const
 			e = endpoint_create(dst, nm->frag_size, nm->max_pkt_age);
 			ord_set_insert(nm->endpoints, (void *)e, 0);
 		}
-		frag_list = endpoint_enqueue_outgoing_packet(e, src, data, data_len);
+		frag_list = endpoint_enqueue_outgoing_packet(e, src, iov, iovcnt);
 		if (frag_list)
 		{
-			list_splice(frag_list, &(nm->outqueue));
+			network_manager_outqueue_splice(nm, frag_list);
 			free(frag_list);
 			res = 0;
 		}
@@ -135,7 +157,10 @@ struct net_msg * network_manager_pop_outgoing_net_msg(struct network_manager *nm
 	{
 		el = list_pop(&(nm->outqueue));
 		if (el)
+		{
 			m = list_entry(el, struct net_msg, list);
+			nm->outqueue_len--;
+		}
 	}
 	return m;
 }
@@ -158,7 +183,7 @@ packet_state_t network_manager_add_incoming_fragment(struct network_manager * nm
 		}
 		INIT_LIST_HEAD(&requests);
 		res = endpoint_add_incoming_fragment(e, f, &requests);
-		list_splice(&requests, &(nm->outqueue));
+		network_manager_outqueue_splice(nm, &requests);
 	}
 	return res;
 }
@@ -198,6 +223,7 @@ int8_t network_manager_enqueue_outgoing_fragment(struct network_manager *nm, con
 			{
 				res = 0;  // ok
 				list_add_tail(fragment_list_element(f), &(nm->outqueue));
+				nm->outqueue_len++;
 			} else
 				res = 1;  // fragment already in sending queue
 		}
@@ -212,3 +238,17 @@ int8_t network_manager_outgoing_queue_ready(struct network_manager *nm)
 		return 1;
 	return 0;
 }
+
+size_t network_manager_outgoing_queue_length(const struct network_manager *nm)
+{
+	if (nm)
+		return nm->outqueue_len;
+	return 0;
+}
+
+size_t network_manager_endpoints(const struct network_manager *nm)
+{
+	if (nm)
+		return ord_set_length(nm->endpoints);
+	return 0;
+}
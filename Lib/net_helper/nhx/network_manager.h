@@ -38,10 +38,18 @@ void network_manager_destroy(struct network_manager ** nm);
 /***************************Ougoing*********************************/
 int8_t network_manager_enqueue_outgoing_packet(struct network_manager *nm, const struct nodeID *src, const struct nodeID * dst, const uint8_t * data, size_t data_len);
 
+/* as network_manager_enqueue_outgoing_packet, gathering the packet from
+ * the iovcnt buffers of iov */
+int8_t network_manager_enqueue_outgoing_packetv(struct network_manager *nm, const struct nodeID *src, const struct nodeID * dst, const struct iovec * iov, int iovcnt);
+
 struct net_msg * network_manager_pop_outgoing_net_msg(struct network_manager *nm);
 
 int8_t network_manager_outgoing_queue_ready(struct network_manager *nm);
 
+size_t network_manager_outgoing_queue_length(const struct network_manager *nm);
+
+size_t network_manager_endpoints(const struct network_manager *nm);
+
 /************************Incoming*************************************/
 
 packet_state_t network_manager_add_incoming_fragment(struct network_manager * nm, const struct fragment * f);
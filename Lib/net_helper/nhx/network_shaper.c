@@ -20,6 +20,7 @@
 
 #include<network_shaper.h>
 #include<grapes_config.h>
+#include<mono_clock.h>
 #include<stdio.h>
 
 struct network_shaper {
@@ -37,12 +38,12 @@ struct network_shaper * network_shaper_create(const char * config)
 	double mul;
 
 	ns = malloc(sizeof(struct network_shaper));
-	gettimeofday(&(ns->next_sending_event), NULL);
+	mono_clock_precise(&(ns->next_sending_event));
 	ns->multiplyer = DEFAULT_BYTERATE_MULTIPLYER;
 	ns->alpha_memory = 0.9;
 	ns->estimated_byterate_persecond = DEFAULT_BYTERATE;
-	gettimeofday(&(ns->last_update_time), NULL);
-	gettimeofday(&(ns->next_sending_event), NULL);
+	mono_clock_precise(&(ns->last_update_time));
+	mono_clock_precise(&(ns->next_sending_event));
 
 	if (config)
 	{
@@ -72,7 +73,7 @@ int8_t network_shaper_next_sending_interval(struct network_shaper * ns, struct t
 
 	if (ns && interval)
 	{
-		gettimeofday(&now, NULL);
+		mono_clock_precise(&now);
 		if (timercmp(&now, &(ns->next_sending_event), <))
 			timersub(&(ns->next_sending_event), &now, interval);
 		else
@@ -112,7 +113,7 @@ int8_t network_shaper_update_bitrate(struct network_shaper * ns, size_t data_siz
 
 	if (ns && data_size > 0)
 	{
-		gettimeofday(&now, NULL);
+		mono_clock_precise(&now);
 		timersub(&now, &(ns->last_update_time), &interval);
 		period = interval.tv_sec + ((double)interval.tv_usec)/1000000;
 		ns->estimated_byterate_persecond = ns->alpha_memory * ns->estimated_byterate_persecond + 
@@ -62,18 +62,18 @@ void packet_bucket_periodic_refresh(struct packet_bucket * pb)
 	}
 }
 
-struct list_head * packet_bucket_add_packet(struct packet_bucket * pb, const struct nodeID * src, const struct nodeID *dst, packet_id_t pid, const uint8_t *data, size_t data_len)
+struct list_head * packet_bucket_add_packet(struct packet_bucket * pb, const struct nodeID * src, const struct nodeID *dst, packet_id_t pid, const struct iovec * iov, int iovcnt)
 {
 	struct fragmented_packet * fp;
 	void * insert_res;
 	struct list_head * res = NULL;
 
-	if (pb && src && dst && data && data_len > 0)
+	if (pb && src && dst && iov && iovcnt > 0)
 	{
 		res = malloc(sizeof(struct list_head));
 		INIT_LIST_HEAD(res);
 		packet_bucket_periodic_refresh(pb);
-		fp = fragmented_packet_create(pid, src, dst, data, data_len, pb->frag_size, res);
+		fp = fragmented_packet_create(pid, src, dst, iov, iovcnt, pb->frag_size, res);
 		insert_res = ord_set_insert(pb->packet_set, fp, 0);
 		if (fp == insert_res)
 			list_add_tail(&(fp->list), &(pb->packet_list));
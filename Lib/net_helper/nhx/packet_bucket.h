@@ -33,7 +33,7 @@ struct packet_bucket * packet_bucket_create(size_t frag_size, uint16_t max_pkt_a
 
 void packet_bucket_destroy(struct packet_bucket ** pb);
 
-struct list_head * packet_bucket_add_packet(struct packet_bucket * pb, const struct nodeID * src, const struct nodeID *dst, packet_id_t pid, const uint8_t *data, size_t data_len);
+struct list_head * packet_bucket_add_packet(struct packet_bucket * pb, const struct nodeID * src, const struct nodeID *dst, packet_id_t pid, const struct iovec * iov, int iovcnt);
 
 packet_state_t packet_bucket_add_fragment(struct packet_bucket *pb, const struct fragment *f, struct list_head * requests);
 
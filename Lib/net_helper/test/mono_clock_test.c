@@ -0,0 +1,76 @@
+#include<malloc.h>
+#include<assert.h>
+#include<unistd.h>
+#include<mono_clock.h>
+
+void mono_clock_now_test()
+{
+	struct timeval t1, t2;
+
+	mono_clock_set_mode(MONO_CLOCK_PRECISE);
+	mono_clock_now(&t1);
+	usleep(2000);
+	mono_clock_now(&t2);
+	assert(timercmp(&t1, &t2, <));
+
+	mono_clock_precise(&t1);
+	assert(timercmp(&t2, &t1, <=));
+
+	mono_clock_now(NULL);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	assert(mono_clock_mode() == MONO_CLOCK_COARSE);
+	assert(mono_clock_us() > 0);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void mono_clock_cache_test()
+{
+	struct timeval t1, t2;
+
+	mono_clock_set_mode(MONO_CLOCK_PRECISE);
+	mono_clock_update();
+	mono_clock_now(&t1);
+	usleep(2000);
+	mono_clock_now(&t2);
+	assert(timercmp(&t1, &t2, ==));  // same loop iteration
+
+	mono_clock_update();
+	mono_clock_now(&t2);
+	assert(timercmp(&t1, &t2, <));
+
+	mono_clock_release();
+	usleep(2000);
+	mono_clock_now(&t1);
+	assert(timercmp(&t2, &t1, <));
+
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void mono_clock_fake_test()
+{
+	struct timeval t;
+
+	mono_clock_fake_set(1500000);
+	assert(mono_clock_mode() == MONO_CLOCK_FAKE);
+	mono_clock_now(&t);
+	assert(t.tv_sec == 1 && t.tv_usec == 500000);
+	usleep(1000);
+	assert(mono_clock_us() == 1500000);
+
+	mono_clock_fake_advance(600000);
+	mono_clock_precise(&t);
+	assert(t.tv_sec == 2 && t.tv_usec == 100000);
+
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	mono_clock_now_test();
+	mono_clock_cache_test();
+	mono_clock_fake_test();
+	return 0;
+}
@@ -314,6 +314,44 @@ void network_manager_pkt_expiring_test()
 	fprintf(stderr,"%s successfully passed!\n",__func__);
 }
 
+void network_manager_outgoing_queue_length_test()
+{
+	struct network_manager * nm = NULL;
+	struct nodeID *src, *dst;
+	uint8_t data[] = "ciao";
+	size_t data_len = 5;
+	struct net_msg * msg;
+
+	src = create_node("10.0.0.1", 6000);
+	dst = create_node("10.0.0.2", 6000);
+
+	assert(network_manager_outgoing_queue_length(nm) == 0);
+
+	nm = network_manager_create("frag_size=3");
+	assert(network_manager_outgoing_queue_length(nm) == 0);
+
+	network_manager_enqueue_outgoing_packet(nm, src, dst, data, data_len);
+	assert(network_manager_outgoing_queue_length(nm) == 2);
+
+	msg = network_manager_pop_outgoing_net_msg(nm);
+	assert(network_manager_outgoing_queue_length(nm) == 1);
+
+	network_manager_enqueue_outgoing_fragment(nm, dst, 0, 0);
+	assert(network_manager_outgoing_queue_length(nm) == 2);
+
+	network_manager_pop_outgoing_net_msg(nm);
+	network_manager_pop_outgoing_net_msg(nm);
+	assert(network_manager_outgoing_queue_length(nm) == 0);
+	assert(network_manager_pop_outgoing_net_msg(nm) == NULL);
+	assert(network_manager_outgoing_queue_length(nm) == 0);
+	assert(msg);
+
+	network_manager_destroy(&nm);
+	nodeid_free(src);
+	nodeid_free(dst);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
 int main()
 {
 	network_manager_create_test();
@@ -324,5 +362,6 @@ int main()
 	network_manager_enqueue_outgoing_fragment_test();
 	network_manager_add_redundant_fragment_test();
 	network_manager_pkt_expiring_test();
+	network_manager_outgoing_queue_length_test();
 	return 0;
 }
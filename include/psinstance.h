@@ -22,14 +22,27 @@
 #define __PSCONTEXT_H__ 
 
 #include<stdint.h>
+#include<poll.h>
 
 #define MSG_BUFFSIZE (512 * 1024)
 #define FDSSIZE 16
+#define DEFAULT_POLL_BUDGET 64  // messages handled per psinstance_poll_all call
+#define DEFAULT_TOPOLOGY_PERIOD 100  // milliseconds
 
 typedef long suseconds_t;
 
 struct psinstance;
 
+struct psinstance_poll_summary {
+	int data_state;  // wait outcome, as returned by psinstance_poll
+	uint16_t messages;
+	uint16_t offers;
+	uint16_t injections;
+	uint16_t tasks;  // periodic tasks run (topology, expiries, ...)
+	int8_t budget_exhausted;  // more messages might be pending
+	int8_t offer_first;  // both timers expired, the offer ran before the injection
+};
+
 /********************High-level Interface***********************/
 struct psinstance * psinstance_create(const char * srv_ip, const int srv_port, const char * config);
 
@@ -37,11 +50,57 @@ void psinstance_destroy(struct psinstance ** ps);
 
 int psinstance_poll(struct psinstance *ps, suseconds_t);
 
+/* Waits at most delta microseconds, then handles every pending message (up
+ * to poll_budget) and every expired timer in deadline order.
+ * summary may be NULL; returns the number of actions performed or -1 */
+int psinstance_poll_all(struct psinstance *ps, suseconds_t delta, struct psinstance_poll_summary * summary);
+
+/********************Event loop Interface***********************/
+/* For embedding into external event loops (libevent, libuv, ...): none of
+ * the following functions blocks or sleeps. The loop watches the fds
+ * returned by psinstance_fds, calls the on_* handler matching the reported
+ * readiness and, in any case, psinstance_on_timer once
+ * psinstance_next_deadline expires; fds and deadline are to be queried
+ * again after every handler call. */
+struct psinstance_fd {
+	int fd;
+	short events;  // POLLIN and/or POLLOUT
+};
+
+/* fills at most len fds to be watched; returns their number or -1 */
+int psinstance_fds(const struct psinstance * ps, struct psinstance_fd * fds, int len);
+
+/* microseconds left to the earliest timer (0 if already expired) */
+suseconds_t psinstance_next_deadline(struct psinstance * ps);
+
+/* handles the pending input of fd (up to poll_budget network messages);
+ * returns the number of handled events or -1 */
+int psinstance_on_readable(struct psinstance * ps, int fd);
+
+/* sends the queued messages the network shaper allows */
+int psinstance_on_writable(struct psinstance * ps);
+
+int psinstance_on_timer(struct psinstance * ps);
+
 /********************       Utils        ***********************/
 int psinstance_ip_address(const struct psinstance *ps, char * ip, int len);
 
 int psinstance_port(const struct psinstance *ps);
 
+/* sets the monotonic clock of the whole process from the clock key of
+ * config (coarse or precise), to be called once before creating the
+ * instances, which ignore their own clock key; returns -1 on bad values */
+int8_t psinstance_set_clock(const char * config);
+
+/* sets the log_chunk and log_signal sampling rates of ps (0 disables, n logs
+ * one event in n) from a config string, as the control socket next to the
+ * metrics socket does */
+int8_t psinstance_set_log(struct psinstance *ps, const char * config);
+
+/* writes the node metrics in the Prometheus text format, truncated to len
+ * bytes; returns the full text length or -1 */
+int psinstance_metrics(struct psinstance *ps, char * buff, int len);
+
 /********************Additional Interface***********************/
 int8_t psinstance_send_offer(struct psinstance * ps);
 
@@ -55,4 +114,9 @@ suseconds_t psinstance_offer_interval(const struct psinstance * ps);
 
 suseconds_t psinstance_network_periodic(struct psinstance * ps);
 
+/* fires the expired offer/injection deadlines and periodic tasks without
+ * waiting; next, if not NULL, is set to the microseconds left to the
+ * earliest deadline. Returns the number of actions performed */
+int psinstance_run_timers(struct psinstance * ps, suseconds_t * next);
+
 #endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __PSRUNTIME_H__
+#define __PSRUNTIME_H__
+
+#include<stdint.h>
+#include<psinstance.h>
+
+#define DEFAULT_RUNTIME_MAX_WAIT 100000  // microseconds
+
+/* A runtime drives many psinstances (e.g., one per channel) from shared
+ * reactors; each reactor owns one epoll set and one timer heap holding the
+ * next deadline of each of its instances. With threads=0 (default) there is
+ * a single reactor run by the caller through psruntime_run_once; with
+ * threads=N, instances are sharded among N reactors, each one running in
+ * its own thread between psruntime_start and psruntime_stop.
+ * The runtime config also sets the process-wide clock (clock=coarse|precise)
+ * shared by all the instances.
+ * Instances are owned by the caller and must be removed before being
+ * destroyed. */
+
+struct psruntime;
+
+struct psruntime * psruntime_create(const char * config);
+
+/* stops the threads, if any; registered instances are left untouched */
+void psruntime_destroy(struct psruntime ** rt);
+
+int8_t psruntime_add(struct psruntime * rt, struct psinstance * ps);
+
+/* safe while the reactors run: once it returns the instance is no longer
+ * touched and can be destroyed */
+int8_t psruntime_remove(struct psruntime * rt, struct psinstance * ps);
+
+int psruntime_instances(const struct psruntime * rt);
+
+/* single reactor mode only: waits at most max_wait microseconds and then
+ * handles every ready event; returns the number of handled events or -1 */
+int psruntime_run_once(struct psruntime * rt, suseconds_t max_wait);
+
+int8_t psruntime_start(struct psruntime * rt);
+
+void psruntime_stop(struct psruntime * rt);
+
+#endif
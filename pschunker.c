@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* pschunker: chunkises a media file once, with the same input modules and
+ * configuration of a pstreamer source, into a pre-chunkised container to
+ * be streamed with input_prechunked=1 */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include<poll.h>
+#include<chunk.h>
+#include<grapes_config.h>
+#include<input.h>
+#include<chunk_file.h>
+
+#define INPUT_WAIT 100  // milliseconds
+
+char * in_file = NULL;
+char * out_file = NULL;
+char * config = "";
+int index_interval = DEFAULT_CHUNK_FILE_INDEX_INTERVAL / 1000;
+
+void show_help()
+{
+	fprintf(stdout, "This is PSChunker, it pre-chunkises a media file for PStreamer sources\n");
+	fprintf(stdout, "Options:\n");
+	fprintf(stdout, "\t-f <filename>:\t\tmedia file to be chunkised\n");
+	fprintf(stdout, "\t-o <filename>:\t\tcontainer to be written\n");
+	fprintf(stdout, "\t-c <config_str>:\tchunkiser configuration CSV string, as for pstreamer but without input_loop\n");
+	fprintf(stdout, "\t-i <int>:\t\tmilliseconds of stream between two index entries (default=%d)\n", index_interval);
+	fprintf(stdout, "\t-h:\t\t\tshows this help\n");
+}
+
+int cmdline_parse(int argc, char *argv[])
+{
+	int o;
+	while ((o = getopt(argc, argv, "f:o:c:i:h")) != -1) {
+		switch(o) {
+			case 'f':
+				in_file = optarg;
+				break;
+			case 'o':
+				out_file = optarg;
+				break;
+			case 'c':
+				config = optarg;
+				break;
+			case 'i':
+				index_interval = atoi(optarg);
+				break;
+			case 'h':
+				show_help();
+				exit(0);
+			default:
+				fprintf(stderr, "Error: unknown option %c\n", o);
+				return -1;
+		}
+	}
+	return in_file && out_file && index_interval > 0 ? 0 : -1;
+}
+
+int8_t config_loops(const char * config)
+{
+	struct tag * tags;
+	int loop;
+
+	tags = grapes_config_parse(config);
+	grapes_config_value_int_default(tags, "input_loop", &loop, 0);
+	free(tags);
+	return loop != 0;
+}
+
+void wait_input(const int * fds)
+	/* until an fd driven input has the next chunk */
+{
+	struct pollfd pfds[FDSSIZE];
+	int n;
+
+	for (n = 0; n < FDSSIZE && fds[n] >= 0; n++)
+	{
+		pfds[n].fd = fds[n];
+		pfds[n].events = POLLIN;
+	}
+	if (n == 0 || poll(pfds, n, INPUT_WAIT) < 0)
+		usleep(INPUT_WAIT * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	struct input_desc * in;
+	struct chunk_file_writer * w;
+	struct chunk c;
+	int fds[FDSSIZE], res = 0, chunks = 0;
+	int8_t input_failed = 0, write_failed = 0;
+	char * fname;
+
+	if (cmdline_parse(argc, argv))
+	{
+		show_help();
+		return -1;
+	}
+	if (config_loops(config))
+	{
+		fprintf(stderr, "Error: input_loop would never end the container\n");
+		return -1;
+	}
+
+	fname = strdup(in_file);  // input_open trims it
+	in = input_open(fname, fds, FDSSIZE, config);
+	if (in == NULL)
+	{
+		fprintf(stderr, "Error: cannot open %s\n", in_file);
+		input_failed = 1;
+	}
+	w = input_failed ? NULL : chunk_file_writer_create(out_file, index_interval * 1000);
+	if (!input_failed && w == NULL)
+	{
+		fprintf(stderr, "Error: cannot create %s\n", out_file);
+		write_failed = 1;
+	}
+
+	while (!input_failed && !write_failed && res != -1)
+	{
+		memset(&c, 0, sizeof(struct chunk));
+		res = input_next(in, &c);
+		if (res > 0)
+		{
+			if (chunk_file_write(w, &c))
+			{
+				fprintf(stderr, "Error: cannot write chunk %d\n", c.id);
+				write_failed = 1;
+			} else
+				chunks++;
+			input_next_release(in, &c);
+		} else if (res == 0)
+			wait_input(fds);
+		else if (res < -1)
+		{
+			fprintf(stderr, "Error: cannot read %s\n", in_file);
+			input_failed = 1;
+		}
+	}
+
+	if (in)
+		input_close(in);
+	if (w && chunk_file_writer_close(&w))
+		write_failed = 1;
+	free(fname);
+	if (input_failed || write_failed)
+	{
+		fprintf(stderr, "Error: cannot chunkise %s into %s\n", in_file, out_file);
+		return -1;
+	}
+	fprintf(stderr, "%d chunks written to %s\n", chunks, out_file);
+	return 0;
+}
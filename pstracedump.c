@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* pstracedump: decodes a binary trace written by pstreamer (trace_file
+ * option) into the [CHUNK_LOG] and [SIGNAL_LOG] CSV lines */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<unistd.h>
+#include<tracer.h>
+
+void show_help()
+{
+	fprintf(stdout, "This is PSTraceDump, it decodes PStreamer binary traces into CSV logs\n");
+	fprintf(stdout, "Usage: pstracedump [-h] [<trace_file>]\n");
+	fprintf(stdout, "\t<trace_file>:\t\ttrace to be decoded (default=standard input)\n");
+	fprintf(stdout, "\t-h:\t\t\tshows this help\n");
+}
+
+int main(int argc, char **argv)
+{
+	FILE * in = stdin;
+	int64_t events;
+	int o;
+
+	while ((o = getopt(argc, argv, "h")) != -1) {
+		switch(o) {
+			case 'h':
+				show_help();
+				return 0;
+			default:
+				show_help();
+				return -1;
+		}
+	}
+	if (optind < argc && (in = fopen(argv[optind], "r")) == NULL)
+	{
+		fprintf(stderr, "Error: cannot open %s\n", argv[optind]);
+		return -1;
+	}
+
+	events = tracer_decode(in, stdout);
+	if (in != stdin)
+		fclose(in);
+	if (events < 0)
+	{
+		fprintf(stderr, "Error: not a PStreamer trace\n");
+		return -1;
+	}
+	fprintf(stderr, "%ld events decoded\n", (long) events);
+	return 0;
+}
@@ -31,7 +31,7 @@ int srv_port = 7000;
 char * srv_ip = "127.0.0.1";
 char * config = "iface=lo";
 int running = 1;
-int8_t ip_override = 0, config_override = 0;
+int8_t ip_override = 0, config_override = 0, drain_mode = 0;
 
 void leave(int sig) {
 	running = 0;
@@ -45,6 +45,7 @@ void show_help()
 	fprintf(stdout, "\t-i <srv_addr>:\t\tspecifies the bootstrap peer IP address\n");
 	fprintf(stdout, "\t-p <srv_port>:\t\tspecifies the bootstrap peer port number\n");
 	fprintf(stdout, "\t-h:\t\t\tshows this help\n");
+	fprintf(stdout, "\t-d:\t\t\tdrains every pending event at each wakeup\n");
 	fprintf(stdout, "\t-c <config_str>:\tdeclares configuration CSV string for the submodules\n");
 	fprintf(stdout, "\n");
 
@@ -52,22 +53,58 @@ void show_help()
 	fprintf(stdout, "\tiface=<string>:\t\t\tnetwork interface to be used (e.g., \"lo\")\n");
 	fprintf(stdout, "\tport=<int>:\t\t\tlocal port number to be used (default=6000)\n");
 	fprintf(stdout, "\toutbuff_size=<int>:\t\tsize in chunks for the output buffer (default=75)\n");
+	fprintf(stdout, "\toutput_raw=<string>:\t\twrite the chunk payloads to a file or pipe with vectored writes, bypassing the dechunkiser\n");
+	fprintf(stdout, "\toutput_thread=0|1:\t\twrite the output from a dedicated thread (default=0)\n");
+	fprintf(stdout, "\toutput_queue=<int>:\t\tchunks queued for the output thread (default=256)\n");
+	fprintf(stdout, "\toutput_overflow=drop|block:\twith a full output queue, drop the oldest chunk or wait (default=drop)\n");
+	fprintf(stdout, "\tplayout_delay=<int>:\t\tmilliseconds chunks wait for playout in the jitter buffer, 0 for ID based reordering (default=0)\n");
+	fprintf(stdout, "\tplayout_delay_max=<int>:\tupper bound in milliseconds for the adaptive playout delay (default=4*playout_delay)\n");
+	fprintf(stdout, "\tadaptive_playout=0|1:\t\tadapt the playout delay to the arrival jitter (default=1)\n");
 	fprintf(stdout, "\tchunkbuffer_size=<int>:\t\tsize in chunks for the trading buffer (default=50)\n");
+	fprintf(stdout, "\tchunk_slab_size=<int>:\t\tpreallocated bytes per chunk in the trading buffer (default=16384)\n");
+	fprintf(stdout, "\tarchive_dir=<string>:\t\tdirectory (e.g., a tmpfs) where traded chunks are archived to serve late peers (default=none)\n");
+	fprintf(stdout, "\tarchive_minutes=<int>:\t\tminutes of stream kept in the archive (default=5)\n");
+	fprintf(stdout, "\tarchive_segment=<int>:\t\tseconds of stream per archive segment file (default=10)\n");
+	fprintf(stdout, "\ttopology_period=<int>:\t\tmilliseconds between two topology updates (default=100)\n");
+	fprintf(stdout, "\tpoll_budget=<int>:\t\tmax messages handled per wakeup in drain mode (default=64)\n");
 	fprintf(stdout, "\tsource_multipolicity=<int>:\tnumber of chunks the source pushes in seeding (default=3)\n");
-	fprintf(stdout, "\tfilename=<string>:\t\tfilename of a media content to be streamed (source side only)\n");
+	fprintf(stdout, "\tfilename=<string>:\t\tfilename of a media content to be streamed (source side only), tracks separated by '|' are chunkised in parallel and merged\n");
+	fprintf(stdout, "\tinput_mmap=0|1:\t\t\tmap filename in memory and stream it in fixed size chunks, with no per-chunk read (default=0)\n");
+	fprintf(stdout, "\tinput_chunk_size=<int>:\t\tbytes per chunk with input_mmap (default=16384)\n");
+	fprintf(stdout, "\tinput_chunk_interval=<int>:\tmicroseconds between two chunks with input_mmap (default=40000)\n");
+	fprintf(stdout, "\tinput_loop=0|1:\t\t\trestart from the beginning of the file with input_mmap or input_prechunked (default=0)\n");
+	fprintf(stdout, "\tinput_prechunked=0|1:\t\tfilename is a container written by pschunker (default=0)\n");
+	fprintf(stdout, "\tinput_seek=<int>:\t\tmilliseconds of stream to skip with input_prechunked (default=0)\n");
+	fprintf(stdout, "\tsource_pacing=timerfd|select:\tinject the chunks of paced inputs on an absolute deadline timerfd or on the event loop timeout (default=timerfd)\n");
+	fprintf(stdout, "\tmetrics_socket=<string>:\tUnix socket path serving the node metrics in the Prometheus text format (default=none)\n");
+	fprintf(stdout, "\tmetrics_period=<int>:\t\tmilliseconds between two metrics snapshots (default=1000)\n");
+	fprintf(stdout, "\tlog_chunk=<int>:\t\tlog one chunk event in n, 0 for none, also settable at runtime through the metrics_socket.ctl control socket (default=1 with trace_file, 0 otherwise)\n");
+	fprintf(stdout, "\tlog_signal=<int>:\t\tlog one signalling event in n, 0 for none (default=as log_chunk)\n");
+	fprintf(stdout, "\ttrace_file=<string>:\t\twrite the chunk and signalling events to a binary trace, to be decoded with pstracedump (default=none)\n");
+	fprintf(stdout, "\ttrace_records=<int>:\t\tevents buffered for the trace writer thread (default=65536)\n");
+	fprintf(stdout, "\tclock=coarse|precise:\t\tmonotonic clock used for the event loop timers, process-wide (default=coarse)\n");
 	fprintf(stdout, "\tAF=INET|INET6:\t\t\taddress family, IPv4 or IPv6 (default=INET)\n");
 	fprintf(stdout, "\toffer_per_period=<int>:\t\tnumber of offers per approximated chunk interval (default=1)\n");
 	fprintf(stdout, "\tpeers_per_offer=<int>:\t\tnumber of peers to offer chunks to (default=1)\n");
 	fprintf(stdout, "\tchunks_per_peer_offer=<int>:\t\tmax number of chunks to be sent to a peer (default=1)\n");
+	fprintf(stdout, "\toffer_control=0|1:\t\tadapt offer rate and chunks per offer to accept ratio and upload queue (default=0)\n");
+	fprintf(stdout, "\tmax_chunks_per_peer_offer=<int>:\tupper bound for chunks per offer with offer_control (default=4*chunks_per_peer_offer)\n");
+	fprintf(stdout, "\toutqueue_threshold=<int>:\tqueued fragments considered as upload saturation with offer_control (default=500)\n");
 	fprintf(stdout, "\tneighbourhood_size=<int>:\ttarget neighbourhood size (default=30)\n");
 	fprintf(stdout, "\tpeer_timeout=<int>:\t\ttimeout in seconds after which a peer is considered dead (default=10)\n");
-	fprintf(stdout, "\tdist_type=random|turbo:\t\tP2P distribution policy (default=random)\n");
+	fprintf(stdout, "\tdist_type=random|turbo|capacity:\tP2P distribution policy (default=random)\n");
+	fprintf(stdout, "\ttrade_mode=push|pull|hybrid:\tpush with offers, pull with buffermap-driven requests or both (default=push)\n");
+	fprintf(stdout, "\tmax_requests_per_peer=<int>:\tmax outstanding requested chunks per neighbour in pull mode (default=4)\n");
+	fprintf(stdout, "\tbmap_period=<int>:\t\tmin milliseconds between buffermap advertisements in pull mode (default=200)\n");
+	fprintf(stdout, "\tseed_policy=rotate|random:\tsource seeding, capacity weighted rotation or weighted random (default=rotate)\n");
+	fprintf(stdout, "\tadaptive_multiplicity=0|1:\tadapt source_multiplicity to the neighbourhood delivery ratio (default=0)\n");
+	fprintf(stdout, "\tmax_source_multiplicity=<int>:\tupper bound for adaptive_multiplicity (default=2*source_multiplicity)\n");
 }
 
 void cmdline_parse(int argc, char *argv[])
 {
 	int o;
-	while ((o = getopt(argc, argv, "p:i:c:h")) != -1) {
+	while ((o = getopt(argc, argv, "p:i:c:hd")) != -1) {
 		switch(o) {
 			case 'p':
 				srv_port = atoi(optarg);
@@ -80,6 +117,9 @@ void cmdline_parse(int argc, char *argv[])
 				config = strdup(optarg);
 				config_override = 1;
 				break;
+			case 'd':
+				drain_mode = 1;
+				break;
 			case 'h':
 				show_help();
 				running = 0;
@@ -100,9 +140,17 @@ int main(int argc, char **argv)
 	(void) signal(SIGINT, leave);
 	cmdline_parse(argc, argv);
 
+	if (psinstance_set_clock(config))
+	{
+		fprintf(stderr, "Error: invalid clock\n");
+		return -1;
+	}
 	ps = psinstance_create(srv_ip, srv_port, config);
 	while (ps && running)
-		psinstance_poll(ps, 5000000);
+		if (drain_mode)
+			psinstance_poll_all(ps, 5000000, NULL);
+		else
+			psinstance_poll(ps, 5000000);
 
 	if (config_override)
 		free(config);
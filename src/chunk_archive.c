@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include<errno.h>
+#include<sys/uio.h>
+#include<chunk_archive.h>
+#include<chunk_file.h>
+#include<grapes_config.h>
+#include<mono_clock.h>
+
+struct archive_entry {
+	int id;
+	uint32_t len;  // record header included
+	uint64_t offset;
+};
+
+struct archive_segment {
+	int fd;
+	char * path;
+	uint64_t created;
+	uint64_t size;
+	struct archive_entry * entries;  // sorted by ID
+	uint32_t len;
+	uint32_t capacity;
+	struct archive_segment * next;
+};
+
+struct chunk_archive {
+	char * dir;
+	uint64_t retention;  // microseconds
+	uint64_t segment_time;
+	struct archive_segment * oldest;
+	struct archive_segment * newest;
+	uint32_t chunks;
+};
+
+void archive_segment_destroy(struct archive_segment ** s)
+{
+	if (s && *s)
+	{
+		close((*s)->fd);
+		unlink((*s)->path);
+		free((*s)->path);
+		free((*s)->entries);
+		free(*s);
+		*s = NULL;
+	}
+}
+
+struct archive_segment * archive_segment_create(const char * dir, uint64_t now)
+{
+	struct archive_segment * s;
+
+	s = malloc(sizeof(struct archive_segment));
+	memset(s, 0, sizeof(struct archive_segment));
+	s->path = malloc(strlen(dir) + 20);
+	sprintf(s->path, "%s/psarchive-XXXXXX", dir);
+	s->fd = mkstemp(s->path);
+	if (s->fd < 0)
+	{
+		fprintf(stderr, "[ERROR] cannot create an archive segment in %s: %s\n", dir, strerror(errno));
+		free(s->path);
+		free(s);
+		return NULL;
+	}
+	s->created = now;
+	return s;
+}
+
+int32_t archive_segment_find(const struct archive_segment * s, int id)
+	/* position of the first entry with ID not lower than id */
+{
+	uint32_t lo = 0, hi = s->len, mid;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (s->entries[mid].id < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+const struct archive_entry * archive_segment_get(const struct archive_segment * s, int id)
+{
+	uint32_t pos;
+
+	if (s->len == 0 || id < s->entries[0].id || id > s->entries[s->len - 1].id)
+		return NULL;
+	pos = archive_segment_find(s, id);
+	return pos < s->len && s->entries[pos].id == id ? &s->entries[pos] : NULL;
+}
+
+int8_t archive_segment_append(struct archive_segment * s, const struct chunk * c)
+{
+	uint8_t header[CHUNK_FILE_RECORD_HEADER_SIZE];
+	struct iovec iov[3];
+	uint32_t pos, len;
+	ssize_t w;
+
+	chunk_file_record_header_encode(header, c);
+	iov[0].iov_base = header;
+	iov[0].iov_len = CHUNK_FILE_RECORD_HEADER_SIZE;
+	iov[1].iov_base = c->data;
+	iov[1].iov_len = c->size;
+	iov[2].iov_base = c->attributes;
+	iov[2].iov_len = c->attributes_size;
+	len = CHUNK_FILE_RECORD_HEADER_SIZE + c->size + c->attributes_size;
+
+	do
+		w = pwritev(s->fd, iov, c->attributes_size ? 3 : 2, s->size);
+	while (w < 0 && errno == EINTR);
+	if (w != (ssize_t) len)
+		return -1;  // a short write is overwritten by the next record
+
+	if (s->len == s->capacity)
+	{
+		s->capacity = s->capacity ? s->capacity * 2 : 64;
+		s->entries = realloc(s->entries, s->capacity * sizeof(struct archive_entry));
+	}
+	pos = s->len;
+	while (pos > 0 && s->entries[pos - 1].id > c->id)  // chunks arrive mostly in order
+	{
+		s->entries[pos] = s->entries[pos - 1];
+		pos--;
+	}
+	s->entries[pos].id = c->id;
+	s->entries[pos].len = len;
+	s->entries[pos].offset = s->size;
+	s->len++;
+	s->size += len;
+	return 0;
+}
+
+struct chunk_archive * chunk_archive_create(const char * config)
+{
+	struct chunk_archive * ca = NULL;
+	struct tag * tags;
+	const char * dir;
+	int minutes, segment;
+
+	tags = grapes_config_parse(config);
+	dir = grapes_config_value_str_default(tags, "archive_dir", NULL);
+	grapes_config_value_int_default(tags, "archive_minutes", &minutes, DEFAULT_ARCHIVE_MINUTES);
+	grapes_config_value_int_default(tags, "archive_segment", &segment, DEFAULT_ARCHIVE_SEGMENT);
+	if (dir && access(dir, W_OK) == 0)
+	{
+		ca = malloc(sizeof(struct chunk_archive));
+		memset(ca, 0, sizeof(struct chunk_archive));
+		ca->dir = strdup(dir);
+		ca->retention = (minutes > 0 ? minutes : DEFAULT_ARCHIVE_MINUTES) * 60000000ULL;
+		ca->segment_time = (segment > 0 ? segment : DEFAULT_ARCHIVE_SEGMENT) * 1000000ULL;
+	} else if (dir)
+		fprintf(stderr, "[ERROR] archive_dir %s is not writable, archive disabled\n", dir);
+	free(tags);
+	return ca;
+}
+
+void chunk_archive_destroy(struct chunk_archive ** ca)
+{
+	struct archive_segment * s;
+
+	if (ca && *ca)
+	{
+		while ((*ca)->oldest)
+		{
+			s = (*ca)->oldest;
+			(*ca)->oldest = s->next;
+			archive_segment_destroy(&s);
+		}
+		free((*ca)->dir);
+		free(*ca);
+		*ca = NULL;
+	}
+}
+
+void chunk_archive_expire(struct chunk_archive * ca, uint64_t now)
+	/* drops the segments whose newest chunk is older than the retention */
+{
+	struct archive_segment * s;
+
+	while (ca->oldest && ca->oldest != ca->newest &&
+			ca->oldest->next->created + ca->retention <= now)
+	{
+		s = ca->oldest;
+		ca->oldest = s->next;
+		ca->chunks -= s->len;
+		archive_segment_destroy(&s);
+	}
+}
+
+int8_t chunk_archive_add(struct chunk_archive * ca, const struct chunk * c)
+{
+	struct archive_segment * s;
+	uint64_t now;
+
+	if (ca == NULL || c == NULL || c->size < 0 || c->attributes_size < 0)
+		return -1;
+	if (chunk_archive_contains(ca, c->id))
+		return 1;
+
+	now = mono_clock_us();
+	if (ca->newest == NULL || ca->newest->created + ca->segment_time <= now)
+	{
+		s = archive_segment_create(ca->dir, now);
+		if (s == NULL)
+			return -1;
+		if (ca->newest)
+			ca->newest->next = s;
+		else
+			ca->oldest = s;
+		ca->newest = s;
+		chunk_archive_expire(ca, now);
+	}
+	if (archive_segment_append(ca->newest, c))
+		return -1;
+	ca->chunks++;
+	return 0;
+}
+
+int8_t chunk_archive_contains(const struct chunk_archive * ca, int id)
+{
+	const struct archive_segment * s;
+
+	if (ca)
+		for (s = ca->oldest; s; s = s->next)
+			if (archive_segment_get(s, id))
+				return 1;
+	return 0;
+}
+
+struct shared_chunk * chunk_archive_get(const struct chunk_archive * ca, int id)
+{
+	const struct archive_segment * s;
+	const struct archive_entry * e = NULL;
+	struct shared_chunk * sc = NULL;
+	struct chunk c;
+	uint8_t * buff;
+	ssize_t r;
+
+	for (s = ca ? ca->oldest : NULL; s; s = s->next)
+		if ((e = archive_segment_get(s, id)))
+			break;
+	if (e)
+	{
+		buff = malloc(e->len);
+		do
+			r = pread(s->fd, buff, e->len, e->offset);
+		while (r < 0 && errno == EINTR);
+		if (r == (ssize_t) e->len)
+		{
+			chunk_file_record_header_decode(buff, &c);
+			c.data = buff + CHUNK_FILE_RECORD_HEADER_SIZE;
+			c.attributes = c.attributes_size ? c.data + c.size : NULL;
+			if (c.id == id && (uint32_t) (CHUNK_FILE_RECORD_HEADER_SIZE + c.size + c.attributes_size) == e->len)
+				sc = shared_chunk_create(NULL, &c);
+		}
+		free(buff);
+	}
+	return sc;
+}
+
+uint32_t chunk_archive_chunks(const struct chunk_archive * ca)
+{
+	return ca ? ca->chunks : 0;
+}
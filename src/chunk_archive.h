@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CHUNK_ARCHIVE_H__
+#define __CHUNK_ARCHIVE_H__
+
+#include<stdint.h>
+#include<chunk.h>
+#include<shared_chunk.h>
+
+/* Append-only, disk-backed store of the chunks which went through the
+ * trading buffer. Chunks are appended to segment files in archive_dir
+ * (possibly a tmpfs), each covering archive_segment seconds; segments
+ * older than archive_minutes are deleted. An in-memory, per-segment ID
+ * index locates the records, which use the chunk_file record layout.
+ * The archive is only a fallback: chunk_trader_lookup() serves chunks
+ * from the trading buffer and reads them back from disk only when they
+ * already left it. */
+
+#define DEFAULT_ARCHIVE_MINUTES 5
+#define DEFAULT_ARCHIVE_SEGMENT 10  // seconds
+
+struct chunk_archive;
+
+/* returns NULL if archive_dir is not configured or not writable */
+struct chunk_archive * chunk_archive_create(const char * config);
+
+/* deletes the segment files too */
+void chunk_archive_destroy(struct chunk_archive ** ca);
+
+/* returns 0 on success, 1 if the chunk is already archived, -1 on error */
+int8_t chunk_archive_add(struct chunk_archive * ca, const struct chunk * c);
+
+int8_t chunk_archive_contains(const struct chunk_archive * ca, int id);
+
+/* reads chunk id back in a new shared chunk, NULL if not archived */
+struct shared_chunk * chunk_archive_get(const struct chunk_archive * ca, int id);
+
+uint32_t chunk_archive_chunks(const struct chunk_archive * ca);
+
+#endif
@@ -4,6 +4,7 @@
 
 struct chunk_attributes {
 	uint16_t hopcount;
+	uint16_t track;  // of a multi-track source
 } __attribute__((packed));
 
 int8_t chunk_attributes_init(struct chunk *c)
@@ -16,6 +17,7 @@ int8_t chunk_attributes_init(struct chunk *c)
 		c->attributes_size = sizeof(struct chunk_attributes);
 		c->attributes = attr = malloc(c->attributes_size);
 		attr->hopcount = 0;
+		attr->track = 0;
 	}
 	return res;
 }
@@ -24,8 +26,37 @@ uint16_t chunk_attributes_get_hopcount(const struct chunk * c)
 {
 	struct chunk_attributes * attr;
 
-	attr = c->attributes;
-	return attr->hopcount;
+	if (c && c->attributes && c->attributes_size >= (int) sizeof(uint16_t))
+	{
+		attr = c->attributes;
+		return attr->hopcount;
+	}
+	return 0;
+}
+
+uint16_t chunk_attributes_get_track(const struct chunk * c)
+{
+	struct chunk_attributes * attr;
+
+	if (c && c->attributes && c->attributes_size >= (int) sizeof(struct chunk_attributes))
+	{
+		attr = c->attributes;
+		return attr->track;
+	}
+	return 0;
+}
+
+int8_t chunk_attributes_set_track(struct chunk * c, uint16_t track)
+{
+	struct chunk_attributes * attr;
+
+	if (c && c->attributes && c->attributes_size >= (int) sizeof(struct chunk_attributes))
+	{
+		attr = c->attributes;
+		attr->track = track;
+		return 0;
+	}
+	return -1;
 }
 
 int8_t chunk_attributes_deinit(struct chunk * c)
@@ -51,7 +82,7 @@ int8_t chunk_attributes_update_upon_reception(struct chunk *c)
 	return -1;
 }
 
-int8_t chunk_attributes_update_upon_sending(struct chunk *c)
+int8_t chunk_attributes_update_upon_sending(const struct chunk *c)
 {
 	return 0;
 }
@@ -14,7 +14,12 @@ int8_t chunk_attributes_deinit(struct chunk * c);
 
 uint16_t chunk_attributes_get_hopcount(const struct chunk * c);
 
-int8_t chunk_attributes_update_upon_sending(struct chunk *c);
+/* track of the chunk in a multi-track stream, 0 for single track ones */
+uint16_t chunk_attributes_get_track(const struct chunk * c);
+
+int8_t chunk_attributes_set_track(struct chunk * c, uint16_t track);
+
+int8_t chunk_attributes_update_upon_sending(const struct chunk *c);
 
 int8_t chunk_attributes_update_upon_reception(struct chunk *c);
 
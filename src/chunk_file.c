@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<chunk_file.h>
+#include<int_coding.h>
+
+#define CHUNK_FILE_MAGIC "PSCK"
+#define CHUNK_FILE_VERSION 1
+#define DEFAULT_CHUNK_FILE_INTERVAL 40000
+
+struct chunk_file_index {
+	uint64_t ts;
+	uint64_t offset;
+};
+
+struct chunk_file_writer {
+	FILE * fp;
+	uint64_t offset;
+	uint32_t chunks;
+	uint32_t index_interval;
+	uint64_t first_ts;
+	uint64_t last_ts;
+	struct chunk_file_index * index;
+	size_t index_len;
+	size_t index_size;
+};
+
+struct chunk_file {
+	const uint8_t * base;
+	uint64_t index_offset;  // end of the records
+	const uint8_t * index;
+	size_t index_len;
+	uint64_t pos;
+	uint32_t chunks;
+	uint32_t interval;
+	uint64_t first_ts;
+};
+
+void int64_cpy(uint8_t * p, uint64_t v)
+{
+	int_cpy(p, v >> 32);
+	int_cpy(p + 4, v & 0xffffffff);
+}
+
+uint64_t int64_rcpy(const uint8_t * p)
+{
+	return (((uint64_t)(uint32_t) int_rcpy(p)) << 32) | (uint32_t) int_rcpy(p + 4);
+}
+
+void chunk_file_record_header_encode(uint8_t * buff, const struct chunk * c)
+{
+	int_cpy(buff, c->id);
+	int64_cpy(buff + 4, c->timestamp);
+	int_cpy(buff + 12, c->size);
+	int_cpy(buff + 16, c->attributes_size);
+}
+
+void chunk_file_record_header_decode(const uint8_t * buff, struct chunk * c)
+{
+	c->id = int_rcpy(buff);
+	c->timestamp = int64_rcpy(buff + 4);
+	c->size = int_rcpy(buff + 12);
+	c->attributes_size = int_rcpy(buff + 16);
+}
+
+void chunk_file_header_encode(uint8_t * buff, uint32_t chunks, uint32_t interval, uint64_t first_ts, uint64_t index_offset)
+{
+	memcpy(buff, CHUNK_FILE_MAGIC, 4);
+	int16_cpy(buff + 4, CHUNK_FILE_VERSION);
+	int16_cpy(buff + 6, 0);
+	int_cpy(buff + 8, chunks);
+	int_cpy(buff + 12, interval);
+	int64_cpy(buff + 16, first_ts);
+	int64_cpy(buff + 24, index_offset);
+}
+
+struct chunk_file_writer * chunk_file_writer_create(const char * path, uint32_t index_interval)
+{
+	struct chunk_file_writer * w = NULL;
+	uint8_t header[CHUNK_FILE_HEADER_SIZE];
+	FILE * fp;
+
+	if (path && (fp = fopen(path, "wb")))
+	{
+		w = malloc(sizeof(struct chunk_file_writer));
+		memset(w, 0, sizeof(struct chunk_file_writer));
+		w->fp = fp;
+		w->index_interval = index_interval ? index_interval : DEFAULT_CHUNK_FILE_INDEX_INTERVAL;
+		chunk_file_header_encode(header, 0, 0, 0, 0);  // completed on close
+		if (fwrite(header, CHUNK_FILE_HEADER_SIZE, 1, fp) == 1)
+			w->offset = CHUNK_FILE_HEADER_SIZE;
+		else {
+			fclose(fp);
+			free(w);
+			w = NULL;
+		}
+	}
+	return w;
+}
+
+int8_t chunk_file_write(struct chunk_file_writer * w, const struct chunk * c)
+{
+	uint8_t header[CHUNK_FILE_RECORD_HEADER_SIZE];
+
+	if (w == NULL || c == NULL || c->size < 0 || c->attributes_size < 0 || (w->chunks && c->timestamp < w->last_ts))
+		return -1;
+
+	if (w->index_len == 0 || c->timestamp >= w->index[w->index_len - 1].ts + w->index_interval)
+	{
+		if (w->index_len == w->index_size)
+		{
+			w->index_size = w->index_size ? w->index_size * 2 : 64;
+			w->index = realloc(w->index, w->index_size * sizeof(struct chunk_file_index));
+		}
+		w->index[w->index_len].ts = c->timestamp;
+		w->index[w->index_len++].offset = w->offset;
+	}
+
+	chunk_file_record_header_encode(header, c);
+	if (fwrite(header, CHUNK_FILE_RECORD_HEADER_SIZE, 1, w->fp) != 1 ||
+			(c->size && fwrite(c->data, c->size, 1, w->fp) != 1) ||
+			(c->attributes_size && fwrite(c->attributes, c->attributes_size, 1, w->fp) != 1))
+		return -1;
+
+	if (w->chunks++ == 0)
+		w->first_ts = c->timestamp;
+	w->last_ts = c->timestamp;
+	w->offset += CHUNK_FILE_RECORD_HEADER_SIZE + c->size + c->attributes_size;
+	return 0;
+}
+
+int8_t chunk_file_writer_close(struct chunk_file_writer ** w)
+{
+	uint8_t buff[CHUNK_FILE_HEADER_SIZE];
+	uint32_t interval = DEFAULT_CHUNK_FILE_INTERVAL;
+	int8_t res = -1;
+	size_t i;
+
+	if (w && *w)
+	{
+		res = 0;
+		for (i = 0; i < (*w)->index_len && res == 0; i++)
+		{
+			int64_cpy(buff, (*w)->index[i].ts);
+			int64_cpy(buff + 8, (*w)->index[i].offset);
+			if (fwrite(buff, CHUNK_FILE_INDEX_ENTRY_SIZE, 1, (*w)->fp) != 1)
+				res = -1;
+		}
+		if ((*w)->chunks > 1 && (*w)->last_ts > (*w)->first_ts)
+			interval = ((*w)->last_ts - (*w)->first_ts) / ((*w)->chunks - 1);
+		chunk_file_header_encode(buff, (*w)->chunks, interval, (*w)->first_ts, (*w)->offset);
+		if (res || fseek((*w)->fp, 0, SEEK_SET) || fwrite(buff, CHUNK_FILE_HEADER_SIZE, 1, (*w)->fp) != 1)
+			res = -1;
+		if (fclose((*w)->fp))
+			res = -1;
+		free((*w)->index);
+		free(*w);
+		*w = NULL;
+	}
+	return res;
+}
+
+struct chunk_file * chunk_file_open(const uint8_t * base, size_t len)
+{
+	struct chunk_file * f = NULL;
+	uint64_t index_offset;
+
+	if (base && len >= CHUNK_FILE_HEADER_SIZE && memcmp(base, CHUNK_FILE_MAGIC, 4) == 0 &&
+			int16_rcpy(base + 4) == CHUNK_FILE_VERSION)
+	{
+		index_offset = int64_rcpy(base + 24);
+		if (index_offset >= CHUNK_FILE_HEADER_SIZE && index_offset <= len &&
+				(len - index_offset) % CHUNK_FILE_INDEX_ENTRY_SIZE == 0)
+		{
+			f = malloc(sizeof(struct chunk_file));
+			f->base = base;
+			f->index_offset = index_offset;
+			f->index = base + index_offset;
+			f->index_len = (len - index_offset) / CHUNK_FILE_INDEX_ENTRY_SIZE;
+			f->pos = CHUNK_FILE_HEADER_SIZE;
+			f->chunks = int_rcpy(base + 8);
+			f->interval = int_rcpy(base + 12);
+			f->first_ts = int64_rcpy(base + 16);
+		}
+	}
+	return f;
+}
+
+void chunk_file_close(struct chunk_file ** f)
+{
+	if (f && *f)
+	{
+		free(*f);
+		*f = NULL;
+	}
+}
+
+int8_t chunk_file_peek(const struct chunk_file * f, struct chunk * c)
+{
+	const uint8_t * rec;
+	uint64_t left;
+
+	if (f->pos >= f->index_offset)
+		return 0;
+	left = f->index_offset - f->pos;
+	rec = f->base + f->pos;
+	if (left < CHUNK_FILE_RECORD_HEADER_SIZE)
+		return -1;
+	chunk_file_record_header_decode(rec, c);
+	if (c->size < 0 || c->attributes_size < 0 ||
+			left < (uint64_t) CHUNK_FILE_RECORD_HEADER_SIZE + c->size + c->attributes_size)
+		return -1;
+	c->data = (uint8_t *) rec + CHUNK_FILE_RECORD_HEADER_SIZE;
+	c->attributes = c->attributes_size ? c->data + c->size : NULL;
+	return 1;
+}
+
+int8_t chunk_file_next(struct chunk_file * f, struct chunk * c)
+{
+	int8_t res = -1;
+
+	if (f && c)
+	{
+		res = chunk_file_peek(f, c);
+		if (res > 0)
+			f->pos += CHUNK_FILE_RECORD_HEADER_SIZE + c->size + c->attributes_size;
+	}
+	return res;
+}
+
+int8_t chunk_file_seek(struct chunk_file * f, uint64_t ts)
+{
+	struct chunk c;
+	size_t lo, hi, mid;
+	int8_t res;
+
+	if (f == NULL)
+		return -1;
+
+	// last index entry not after ts
+	f->pos = CHUNK_FILE_HEADER_SIZE;
+	lo = 0;
+	hi = f->index_len;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (int64_rcpy(f->index + mid * CHUNK_FILE_INDEX_ENTRY_SIZE) <= ts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo > 0)
+		f->pos = int64_rcpy(f->index + (lo - 1) * CHUNK_FILE_INDEX_ENTRY_SIZE + 8);
+	if (f->pos < CHUNK_FILE_HEADER_SIZE || f->pos > f->index_offset)
+		f->pos = f->index_offset;
+
+	// at most index_interval worth of records to skip
+	while ((res = chunk_file_peek(f, &c)) > 0 && c.timestamp < ts)
+		f->pos += CHUNK_FILE_RECORD_HEADER_SIZE + c.size + c.attributes_size;
+	return res > 0 ? 0 : -1;
+}
+
+uint32_t chunk_file_chunks(const struct chunk_file * f)
+{
+	return f ? f->chunks : 0;
+}
+
+uint64_t chunk_file_first_timestamp(const struct chunk_file * f)
+{
+	return f ? f->first_ts : 0;
+}
+
+suseconds_t chunk_file_interval(const struct chunk_file * f)
+{
+	return f ? f->interval : 0;
+}
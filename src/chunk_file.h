@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CHUNK_FILE_H__
+#define __CHUNK_FILE_H__
+
+#include<stdint.h>
+#include<stddef.h>
+#include<sys/time.h>
+#include<chunk.h>
+
+/* Pre-chunkised stream container. A fixed header is followed by the chunk
+ * records (ID, timestamp, size, attributes size, payload and attributes,
+ * integers in network order) and by a sparse index of (timestamp, offset)
+ * entries, one every index_interval microseconds of stream time:
+ *
+ * header: "PSCK" | version (16) | reserved (16) | chunks (32) |
+ *         interval (32) | first timestamp (64) | index offset (64)
+ */
+
+#define CHUNK_FILE_HEADER_SIZE 32
+#define CHUNK_FILE_RECORD_HEADER_SIZE 20
+#define CHUNK_FILE_INDEX_ENTRY_SIZE 16
+#define DEFAULT_CHUNK_FILE_INDEX_INTERVAL 1000000  // microseconds
+
+struct chunk_file_writer;
+
+struct chunk_file;
+
+/* record header (CHUNK_FILE_RECORD_HEADER_SIZE bytes) of chunk c; payload
+ * and attributes follow it */
+void chunk_file_record_header_encode(uint8_t * buff, const struct chunk * c);
+
+/* fills ID, timestamp and sizes of c, not payload and attributes */
+void chunk_file_record_header_decode(const uint8_t * buff, struct chunk * c);
+
+struct chunk_file_writer * chunk_file_writer_create(const char * path, uint32_t index_interval);
+
+/* chunk timestamps must not decrease; returns 0 on success */
+int8_t chunk_file_write(struct chunk_file_writer * w, const struct chunk * c);
+
+/* appends the index and completes the header; returns 0 on success */
+int8_t chunk_file_writer_close(struct chunk_file_writer ** w);
+
+/* reads the container held in base, which must outlive the reader */
+struct chunk_file * chunk_file_open(const uint8_t * base, size_t len);
+
+void chunk_file_close(struct chunk_file ** f);
+
+/* fills c with the next record, payload and attributes pointing into the
+ * container; returns 1, 0 at the end of the stream or -1 if corrupted */
+int8_t chunk_file_next(struct chunk_file * f, struct chunk * c);
+
+/* moves to the first chunk with timestamp not lower than ts, in O(log n)
+ * on the index; returns 0, or -1 if no such chunk exists */
+int8_t chunk_file_seek(struct chunk_file * f, uint64_t ts);
+
+uint32_t chunk_file_chunks(const struct chunk_file * f);
+
+uint64_t chunk_file_first_timestamp(const struct chunk_file * f);
+
+/* average interval between two chunks, in microseconds */
+suseconds_t chunk_file_interval(const struct chunk_file * f);
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<string.h>
+#include<chunk_ring.h>
+#include<chunkbuffer.h>
+
+struct chunk_ring {
+	struct shared_chunk ** slots;
+	struct shared_chunk_pool * pool;
+	int size;
+	int count;
+	int latest;
+};
+
+struct chunk_ring * chunk_ring_create(int size, size_t slab_size)
+{
+	struct chunk_ring * r = NULL;
+
+	if (size > 0)
+	{
+		r = malloc(sizeof(struct chunk_ring));
+		r->size = size;
+		r->count = 0;
+		r->latest = -1;
+		r->pool = shared_chunk_pool_create(slab_size, size);
+		r->slots = malloc(sizeof(struct shared_chunk *) * size);
+		memset(r->slots, 0, sizeof(struct shared_chunk *) * size);
+	}
+	return r;
+}
+
+void chunk_ring_destroy(struct chunk_ring ** r)
+{
+	int i;
+
+	if (r && *r)
+	{
+		for (i = 0; i < (*r)->size; i++)
+			shared_chunk_unref(&((*r)->slots[i]));
+		shared_chunk_pool_destroy(&((*r)->pool));
+		free((*r)->slots);
+		free(*r);
+		*r = NULL;
+	}
+}
+
+int8_t chunk_ring_in_window(const struct chunk_ring * r, int id)
+{
+	return id >= 0 && id <= r->latest && id > r->latest - r->size;
+}
+
+struct shared_chunk ** chunk_ring_slot(const struct chunk_ring * r, int id)
+{
+	return r->slots + (id % r->size);
+}
+
+int chunk_ring_slot_id(struct shared_chunk ** s)
+{
+	return *s ? shared_chunk_get(*s)->id : -1;
+}
+
+int chunk_ring_add(struct chunk_ring * r, struct chunk * c)
+{
+	struct shared_chunk ** s;
+	int id;
+
+	if (r == NULL || c == NULL || c->id < 0 || c->id <= r->latest - r->size)
+		return E_CB_OLD;
+	s = chunk_ring_slot(r, c->id);
+	if (chunk_ring_slot_id(s) == c->id)
+		return E_CB_DUPLICATE;
+
+	if (c->id > r->latest)  // slide the window, the skipped slots get evicted
+	{
+		for (id = r->latest + 1; id < c->id && id <= r->latest + r->size; id++)
+			if (r->latest >= 0 && *chunk_ring_slot(r, id))
+			{
+				shared_chunk_unref(chunk_ring_slot(r, id));
+				r->count--;
+			}
+		r->latest = c->id;
+	}
+	if (*s)
+	{
+		shared_chunk_unref(s);
+		r->count--;
+	}
+
+	*s = shared_chunk_create(r->pool, c);
+	r->count++;
+	return 0;
+}
+
+struct shared_chunk * chunk_ring_get_shared(const struct chunk_ring * r, int id)
+{
+	struct shared_chunk ** s;
+
+	if (r && chunk_ring_in_window(r, id))
+	{
+		s = chunk_ring_slot(r, id);
+		if (chunk_ring_slot_id(s) == id)
+			return *s;
+	}
+	return NULL;
+}
+
+const struct chunk * chunk_ring_get(const struct chunk_ring * r, int id)
+{
+	return shared_chunk_get(chunk_ring_get_shared(r, id));
+}
+
+int8_t chunk_ring_contains(const struct chunk_ring * r, int id)
+{
+	return chunk_ring_get(r, id) ? 1 : 0;
+}
+
+int chunk_ring_ids(const struct chunk_ring * r, int * ids)
+{
+	int id, n = 0;
+
+	if (r && ids && r->latest >= 0)
+		for (id = r->latest - r->size + 1; id <= r->latest; id++)
+			if (id >= 0 && chunk_ring_slot_id(chunk_ring_slot(r, id)) == id)
+				ids[n++] = id;
+	return n;
+}
+
+struct chunkID_set * chunk_ring_to_idset(const struct chunk_ring * r)
+{
+	struct chunkID_set * bmap;
+	int id;
+
+	bmap = chunkID_set_init("type=bitmap");
+	if (r && r->latest >= 0)
+		for (id = r->latest - r->size + 1; id <= r->latest; id++)
+			if (id >= 0 && chunk_ring_slot_id(chunk_ring_slot(r, id)) == id)
+				chunkID_set_add_chunk(bmap, id);
+	return bmap;
+}
+
+int chunk_ring_size(const struct chunk_ring * r)
+{
+	return r ? r->size : 0;
+}
+
+int chunk_ring_count(const struct chunk_ring * r)
+{
+	return r ? r->count : 0;
+}
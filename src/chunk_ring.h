@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CHUNK_RING_H__
+#define __CHUNK_RING_H__
+
+#include<stdint.h>
+#include<stdlib.h>
+#include<chunk.h>
+#include<chunkidset.h>
+#include<shared_chunk.h>
+
+/* Chunk buffer holding the latest `size` chunk IDs in a ring indexed by
+ * chunk_id % size. Chunks are stored as shared chunks, recycled through a
+ * pool of `slab_size` bytes blocks (larger chunks are allocated on
+ * demand), so lookup, insertion and eviction are O(1) and never allocate
+ * once the ring is warm. Evicted chunks live on while other modules (e.g.,
+ * the output) hold a reference to them. */
+
+#define DEFAULT_CHUNK_SLAB_SIZE 16384  // bytes
+
+struct chunk_ring;
+
+struct chunk_ring * chunk_ring_create(int size, size_t slab_size);
+
+void chunk_ring_destroy(struct chunk_ring ** r);
+
+/* copies the chunk in the ring, c and its memory stay with the caller
+ * (e.g., it can point into a receive buffer). Returns 0 on success,
+ * E_CB_OLD if the chunk is older than the ring window, E_CB_DUPLICATE if
+ * it is already stored. */
+int chunk_ring_add(struct chunk_ring * r, struct chunk * c);
+
+const struct chunk * chunk_ring_get(const struct chunk_ring * r, int id);
+
+/* the stored shared chunk, to be referenced by whoever keeps it */
+struct shared_chunk * chunk_ring_get_shared(const struct chunk_ring * r, int id);
+
+int8_t chunk_ring_contains(const struct chunk_ring * r, int id);
+
+/* fills ids (of at least chunk_ring_size elements) with the stored chunk
+ * IDs, in ascending order; returns their number */
+int chunk_ring_ids(const struct chunk_ring * r, int * ids);
+
+struct chunkID_set * chunk_ring_to_idset(const struct chunk_ring * r);
+
+int chunk_ring_size(const struct chunk_ring * r);
+
+int chunk_ring_count(const struct chunk_ring * r);
+
+#endif
@@ -3,7 +3,7 @@
 #include<measures.h>
 #include<grapes_config.h>
 #include<string.h>
-#include<chunkbuffer.h>
+#include<chunk_ring.h>
 #include<chunklock.h>
 #include<scheduler_common.h>
 #include<peer_metadata.h>
@@ -13,23 +13,39 @@
 #include<trade_msg_ha.h>
 #include<chunkidset.h>
 #include<chunk_attributes.h>
+#include<offer_controller.h>
+#include<seed_scheduler.h>
 
 #include<net_helpers.h>
+#include<mono_clock.h>
+#include<int_coding.h>
 
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define CHUNK_MSG_HEADER_SIZE 22  // transaction ID and GRAPES chunk header
 
-enum distribution_type {DIST_UNIFORM, DIST_TURBO};
+enum distribution_type {DIST_UNIFORM, DIST_TURBO, DIST_CAPACITY};
+enum trade_mode {TRADE_PUSH, TRADE_PULL, TRADE_HYBRID};
 
 struct chunk_trader{
-	struct chunk_buffer *cb;
+	struct chunk_ring * ring;
+	int * ids;  // chunk IDs scratch buffer
 	struct chunk_locks * ch_locks;
 	const struct psinstance * ps;
+	struct log_rates * log;
 	int cb_size;
 	enum distribution_type dist_type;
+	enum trade_mode mode;
+	int max_requests_per_peer;
+	int8_t bmap_changed;
+	int bmap_period;  // milliseconds between buffermap advertisements
+	uint64_t bmap_sent;  // microseconds, last advertisement
 	int offer_per_period;
 	struct service_times_element * transactions;
 	int peers_per_offer;
 	int chunks_per_peer_offer;
+	struct offer_controller * oc;
+	struct seed_scheduler * seeder;
+	struct chunk_archive * archive;  // chunks which left the ring, optional
 };
 
 int chunk_trader_buffer_size(const struct chunk_trader *ct)
@@ -37,28 +53,71 @@ int chunk_trader_buffer_size(const struct chunk_trader *ct)
 	return ct->cb_size;
 }
 
+int chunk_trader_chunks_per_offer(const struct chunk_trader *ct)
+{
+	if (ct->oc)
+		return offer_controller_chunks_per_offer(ct->oc);
+	return ct->chunks_per_peer_offer;
+}
+
+int8_t chunk_trader_stats(const struct chunk_trader *ct, struct chunk_trader_stats *stats)
+{
+	if (ct == NULL || stats == NULL)
+		return -1;
+	stats->buffered = chunk_ring_count(ct->ring);
+	stats->archived = chunk_archive_chunks(ct->archive);
+	stats->locks = chunk_locks_count(ct->ch_locks);
+	stats->transactions = transaction_count(ct->transactions);
+	stats->chunks_per_offer = chunk_trader_chunks_per_offer(ct);
+	return 0;
+}
+
 struct chunk_trader * chunk_trader_create(const struct psinstance *ps,const  char *config)
 {
 	struct chunk_trader *ct;
 	struct tag * tags;
-	char conf[80];
+	int offer_control, slab_size;
 
 	ct = malloc(sizeof(struct chunk_trader));
 	ct->dist_type = DIST_UNIFORM;
+	ct->mode = TRADE_PUSH;
+	ct->bmap_changed = 0;
+	ct->bmap_sent = 0;
 	ct->ps = ps;
+	ct->log = psinstance_log_rates(ps);
 	ct->transactions = NULL;
+	ct->oc = NULL;
+	ct->seeder = NULL;
+	ct->archive = chunk_archive_create(config);
 
 	tags = grapes_config_parse(config);
 	if (strcmp(grapes_config_value_str_default(tags, "dist_type", ""), "turbo") == 0)
 		ct->dist_type = DIST_TURBO;
+	if (strcmp(grapes_config_value_str_default(tags, "dist_type", ""), "capacity") == 0)
+		ct->dist_type = DIST_CAPACITY;
+	if (strcmp(grapes_config_value_str_default(tags, "trade_mode", ""), "pull") == 0)
+		ct->mode = TRADE_PULL;
+	if (strcmp(grapes_config_value_str_default(tags, "trade_mode", ""), "hybrid") == 0)
+		ct->mode = TRADE_HYBRID;
+	grapes_config_value_int_default(tags, "max_requests_per_peer", &(ct->max_requests_per_peer), 4);
+	grapes_config_value_int_default(tags, "bmap_period", &(ct->bmap_period), 200);
 	grapes_config_value_int_default(tags, "offer_per_period", &(ct->offer_per_period), 1);
 	grapes_config_value_int_default(tags, "peers_per_offer", &(ct->peers_per_offer), 1);
 	grapes_config_value_int_default(tags, "chunks_per_peer_offer", &(ct->chunks_per_peer_offer), 1);
 	grapes_config_value_int_default(tags, "chunkbuffer_size", &(ct->cb_size), 50);
+	grapes_config_value_int_default(tags, "chunk_slab_size", &slab_size, DEFAULT_CHUNK_SLAB_SIZE);
+	grapes_config_value_int_default(tags, "offer_control", &offer_control, 0);
+	if (strcmp(grapes_config_value_str_default(tags, "seed_policy", ""), "random") != 0)
+		ct->seeder = seed_scheduler_create(config);
 	free(tags);
 
-	sprintf(conf, "size=%d", ct->cb_size);
-	ct->cb = cb_init(conf);
+	if (offer_control)
+		ct->oc = offer_controller_create(ct->chunks_per_peer_offer, config);
+
+	if (ct->cb_size <= 0)
+		ct->cb_size = 50;
+	ct->ring = chunk_ring_create(ct->cb_size, slab_size > 0 ? slab_size : 0);
+	ct->ids = malloc(sizeof(int) * ct->cb_size);
 	ct->ch_locks = chunk_locks_create(80);  // milliseconds of lock time
 	return ct;
 }
@@ -71,8 +130,16 @@ void chunk_trader_destroy(struct chunk_trader **ct)
 			chunk_locks_destroy(&((*ct)->ch_locks));
 		if(((*ct)->transactions))
 			transaction_destroy(&((*ct)->transactions));
-		if(((*ct)->cb))
-			cb_destroy((*ct)->cb);
+		if(((*ct)->ring))
+			chunk_ring_destroy(&((*ct)->ring));
+		if(((*ct)->ids))
+			free((*ct)->ids);
+		if(((*ct)->oc))
+			offer_controller_destroy(&((*ct)->oc));
+		if(((*ct)->seeder))
+			seed_scheduler_destroy(&((*ct)->seeder));
+		if(((*ct)->archive))
+			chunk_archive_destroy(&((*ct)->archive));
 		free(*ct);
 		*ct = NULL;
 	}
@@ -84,34 +151,65 @@ int8_t chunk_trader_add_chunk(struct chunk_trader *ct, struct chunk *c)
 
 	if (ct && c)
 	{
-		res = cb_add_chunk(ct->cb, c);
+		res = chunk_ring_add(ct->ring, c);
 		if (res)
-			log_chunk_error(psinstance_nodeid(ct->ps), NULL, c, res);
+			LOG_CHUNK_ERROR(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), NULL, c, res);
+		else {
+			ct->bmap_changed = 1;
+			if (ct->archive)
+				chunk_archive_add(ct->archive, c);
+		}
 		res = res < 0 ? -1 : 0;
 	}
 	return res;
 }
 
+struct shared_chunk * chunk_trader_shared_chunk(const struct chunk_trader *ct, int id)
+{
+	return ct ? chunk_ring_get_shared(ct->ring, id) : NULL;
+}
+
+struct shared_chunk * chunk_trader_lookup(const struct chunk_trader *ct, int id)
+	/* a new reference to chunk id, from the ring or else from the archive */
+{
+	struct shared_chunk * sc;
+
+	sc = chunk_ring_get_shared(ct->ring, id);
+	if (sc)
+		return shared_chunk_ref(sc);
+	return chunk_archive_get(ct->archive, id);
+}
+
+int8_t chunk_trader_has_chunk(const struct chunk_trader *ct, int id)
+{
+	return chunk_ring_contains(ct->ring, id) || chunk_archive_contains(ct->archive, id);
+}
+
 int8_t peer_chunk_send(struct chunk_trader * ct, struct PeerChunk *pairs, int pairs_len, uint16_t transid)
 {
 	int i, res =-1;
 	struct peer * target_peer;
-	struct chunk * target_chunk;
+	struct shared_chunk * target;
+	const struct chunk * target_chunk;
 
 	for (i=0; i<pairs_len; i++)
 	{
 		target_peer = pairs[i].peer;
-		target_chunk = (struct chunk *) cb_get_chunk(ct->cb, pairs[i].chunk);
+		target = chunk_trader_lookup(ct, pairs[i].chunk);
+		if (target == NULL)
+			continue;
+		target_chunk = shared_chunk_get(target);
 
-		res = sendChunk(psinstance_nodeid(ct->ps),target_peer->id, target_chunk, transid);	//we use transactions in order to register acks for push
+		res = shared_chunk_send(target, psinstance_nodeid(ct->ps), target_peer->id, transid);	//we use transactions in order to register acks for push
 		if (res >= 0)
 		{
 			chunk_attributes_update_upon_sending(target_chunk);
 			chunkID_set_add_chunk(peer_bmap(target_peer), target_chunk->id);
-#ifdef LOG_CHUNK
-			log_chunk(psinstance_nodeid(ct->ps), target_peer->id, target_chunk, "SENT");
-#endif
+			transaction_reg_sent_bytes(ct->transactions, transid, target_chunk->size);
+			reg_chunk_upload(psinstance_measures(ct->ps), target_peer->id, target_chunk);
+			LOG_CHUNK_EVENT(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), target_peer->id, target_chunk, TRACE_SENT);
 		} 
+		shared_chunk_unref(&target);
 	}
 
 	return res >= 0? 0 : -1;
@@ -129,11 +227,31 @@ double peer_evaluation_turbo(struct peer **n)
 	return 1.0/trader_peer_neigh_size(n);
 }
 
+double peer_evaluation_capacity(struct peer **n)
+{
+	double capacity;
+
+	capacity = peer_capacity(*n);
+	return capacity > 0 ? capacity : DEFAULT_PEER_CAPACITY;  // unknown peers get probed optimistically
+}
+
 double peer_evaluation_uniform(struct peer **n)
 {
 	return 1.0;
 }
 
+peerEvaluateFunction chunk_trader_peer_evaluation(const struct chunk_trader *ct)
+{
+	switch (ct->dist_type) {
+		case DIST_TURBO:
+			return peer_evaluation_turbo;
+		case DIST_CAPACITY:
+			return peer_evaluation_capacity;
+		default:
+			return peer_evaluation_uniform;
+	}
+}
+
 double chunk_evaluation_latest(int *cid)
 {
 	return *cid;
@@ -155,56 +273,31 @@ int8_t chunk_trader_push_chunk(struct chunk_trader *ct, struct chunk *c, int mul
 		peer_num = peerset_size(pset);
 		peers = peerset_get_peers(pset);
 		
-		pairs_len = MIN(multiplicity, peer_num);
-		pairs = malloc(pairs_len * sizeof(struct PeerChunk));
-		
-		if (ct->dist_type == DIST_TURBO)
-			schedSelectChunkFirst(SCHED_WEIGHTED, peers, peer_num, (int *)&(c->id), 1, pairs, &pairs_len, NULL, peer_evaluation_turbo, chunk_evaluation_latest);
-		else
-			schedSelectChunkFirst(SCHED_WEIGHTED, peers, peer_num, (int *)&(c->id), 1, pairs, &pairs_len, NULL, peer_evaluation_uniform, chunk_evaluation_latest);
+		if (ct->seeder)
+		{
+			seed_scheduler_adapt(ct->seeder, peers, peer_num, c->id);
+			pairs = seed_scheduler_select(ct->seeder, peers, peer_num, c->id, multiplicity, chunk_trader_peer_evaluation(ct), &pairs_len);
+			res = peer_chunk_send(ct, pairs, pairs_len, INVALID_TRANSID);
+		} else {
+			pairs_len = MIN(multiplicity, peer_num);
+			pairs = malloc(pairs_len * sizeof(struct PeerChunk));
+			
+			schedSelectChunkFirst(SCHED_WEIGHTED, peers, peer_num, (int *)&(c->id), 1, pairs, &pairs_len, NULL, chunk_trader_peer_evaluation(ct), chunk_evaluation_latest);
 
-		peer_chunk_send(ct, pairs, pairs_len, INVALID_TRANSID);
-		free(pairs);
+			res = peer_chunk_send(ct, pairs, pairs_len, INVALID_TRANSID);
+			free(pairs);
+		}
 	}
 	return res;
 }
 
-int * chunk_buffer_to_idarray(struct chunk_buffer * chbuff, int *n)
-{
-	int * buff, i;
-	struct chunk * chunks;
-
-	chunks = cb_get_chunks(chbuff, n);
-	buff = malloc(sizeof(int)*(*n));
-	for(i=0; i<*n; i++)
-		buff[i] = chunks[i].id;
-	return buff;
-}
-
-struct chunkID_set * chunk_buffer_to_idset(struct chunk_buffer * chbuff)
-{
-	struct chunk * chunks;
-	int n, i;
-	struct chunkID_set * bmap;
-
-	bmap = chunkID_set_init("type=bitmap");
-	chunks = cb_get_chunks(chbuff, &n);
-
-	if (chunks)
-		for(i=0; i<n; i++)
-			chunkID_set_add_chunk(bmap, chunks[i].id);
-	return bmap;
-}
-
 int8_t chunk_trader_send_ack(struct chunk_trader *ct, struct nodeID *to, uint16_t transid)
 {
 	struct chunkID_set * bmap;
 
-	bmap = chunk_buffer_to_idset(ct->cb);
+	bmap = chunk_ring_to_idset(ct->ring);
 	sendAck(psinstance_nodeid(ct->ps), to, bmap, transid);
-#ifdef LOG_SIGNAL
-	log_signal(psinstance_nodeid(ct->ps), to, chunkID_set_size(bmap), transid, sig_ack, "SENT");
-#endif
+	LOG_SIGNAL_EVENT(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), to, chunkID_set_size(bmap), transid, sig_ack, TRACE_SENT);
 	chunkID_set_free(bmap);
 	return 0;
 }
@@ -221,39 +314,52 @@ void chunk_destroy(struct chunk **c)
 	}
 }
 
-struct chunk * chunk_trader_parse_chunk(struct chunk_trader *ct, struct nodeID *from, uint8_t *buff, int len)
+int chunk_decode_inplace(struct chunk *c, uint8_t *buff, int len, uint16_t *transid)
+	/* same wire format as GRAPES parseChunkMsg, but c payload and
+	 * attributes point into buff instead of being copied */
+{
+	if (len < CHUNK_MSG_HEADER_SIZE)
+		return -1;
+	*transid = int16_rcpy(buff);
+	buff += 2;
+	c->id = int_rcpy(buff);
+	c->timestamp = (((uint64_t)(uint32_t) int_rcpy(buff + 4)) << 32) | (uint32_t) int_rcpy(buff + 8);
+	c->size = int_rcpy(buff + 12);
+	c->attributes_size = int_rcpy(buff + 16);
+	if (c->size < 0 || c->attributes_size < 0 ||
+			(uint64_t) len < (uint64_t) CHUNK_MSG_HEADER_SIZE + c->size + c->attributes_size)
+		return -2;
+	c->data = buff + CHUNK_MSG_HEADER_SIZE - 2;
+	c->attributes = c->attributes_size ? c->data + c->size : NULL;
+	return CHUNK_MSG_HEADER_SIZE + c->size + c->attributes_size;
+}
+
+int8_t chunk_trader_parse_chunk(struct chunk_trader *ct, struct nodeID *from, uint8_t *buff, int len, struct chunk *c)
 {
-	int res;
-	struct chunk *c = NULL;
+	int8_t res = E_CANNOT_PARSE;
 	uint16_t transid;
 	struct peer * p;
 
-	if (ct && from && buff && len > 1)
+	if (ct && from && buff && len > 1 && c)
 	{
-		c = malloc(sizeof(struct chunk));
 		memset(c, 0, sizeof(struct chunk));
-		res = parseChunkMsg(buff+1, len-1, c, &transid);
-		if (res > 0)
+		if (chunk_decode_inplace(c, buff+1, len-1, &transid) > 0)
 		{
 			chunk_attributes_update_upon_reception(c);
 			chunk_unlock(ct->ch_locks, c->id); // in case we locked it in a select message
-#ifdef LOG_CHUNK
-			log_chunk(from, psinstance_nodeid(ct->ps), c, "RECEIVED");
-#endif
+			LOG_CHUNK_EVENT(ct->log, psinstance_tracer(ct->ps), from, psinstance_nodeid(ct->ps), c, TRACE_RECEIVED);
 			p = nodeid_to_peer(psinstance_topology(ct->ps), from, 0);
 			if (p)
 				chunkID_set_add_chunk(peer_bmap(p), c->id);  // keep track it has this chunk for sure
 			chunk_trader_send_ack(ct, from, transid);
-
+			res = 0;
 		} else {
-#ifdef LOG_CHUNK
-			log_chunk_error(from, psinstance_nodeid(ct->ps), c, E_CANNOT_PARSE);
-#endif
-			chunk_destroy(&c);
+			LOG_CHUNK_ERROR(ct->log, psinstance_tracer(ct->ps), from, psinstance_nodeid(ct->ps), c, E_CANNOT_PARSE);
+			memset(c, 0, sizeof(struct chunk));
 		}
 	}
 
-	return c;
+	return res;
 }
 
 /** signalling actions **/
@@ -286,14 +392,16 @@ int8_t chunk_trader_send_offer(struct chunk_trader *ct)
 	size_t n_pairs, i;
 	struct PeerChunk * pairs;
 	struct chunkID_set * offer_cset;
-	int * ch_buff;
 	int8_t res = 0;
 	uint16_t transid;
 
+	if (ct->mode == TRADE_PULL)
+		return 0;
+
 	pset = topology_get_neighbours(psinstance_topology(ct->ps));
 	n_neighs = peerset_size(pset);
 	neighs = peerset_get_peers(pset);
-	ch_buff = chunk_buffer_to_idarray(ct->cb, &n_chunks);
+	n_chunks = chunk_ring_ids(ct->ring, ct->ids);
 	pairs = malloc(sizeof(struct PeerChunk) * n_chunks);
 
 	for (j=0; j<ct->peers_per_offer; j++)
@@ -301,10 +409,7 @@ int8_t chunk_trader_send_offer(struct chunk_trader *ct)
 		n_pairs = n_chunks;  // we potentially offer everything
 
 		// the following scheduling function picks one peer at most
-		if (ct->dist_type == DIST_TURBO)
-			schedSelectPeerFirst(SCHED_WEIGHTED, neighs, n_neighs, ch_buff, n_chunks, pairs, &n_pairs, peer_needs_chunk_filter, peer_evaluation_turbo, chunk_evaluation_latest);
-		else
-			schedSelectPeerFirst(SCHED_WEIGHTED, neighs, n_neighs, ch_buff, n_chunks, pairs, &n_pairs, peer_needs_chunk_filter, peer_evaluation_uniform, chunk_evaluation_latest);
+		schedSelectPeerFirst(SCHED_WEIGHTED, neighs, n_neighs, ct->ids, n_chunks, pairs, &n_pairs, peer_needs_chunk_filter, chunk_trader_peer_evaluation(ct), chunk_evaluation_latest);
 
 		if (n_pairs > 0)
 		{
@@ -312,19 +417,130 @@ int8_t chunk_trader_send_offer(struct chunk_trader *ct)
 			for(i=0; i<n_pairs; i++)
 				chunkID_set_add_chunk(offer_cset, pairs[i].chunk);
 			transid = transaction_create(&(ct->transactions), pairs[0].peer->id);
-			offerChunks(psinstance_nodeid(ct->ps), pairs[0].peer->id, offer_cset, ct->chunks_per_peer_offer, transid);
-#ifdef LOG_SIGNAL
-			log_signal(psinstance_nodeid(ct->ps), pairs[0].peer->id, chunkID_set_size(offer_cset), transid, sig_offer, "SENT");
-#endif
+			offerChunks(psinstance_nodeid(ct->ps), pairs[0].peer->id, offer_cset, chunk_trader_chunks_per_offer(ct), transid);
+			offer_controller_reg_offer(ct->oc);
+			LOG_SIGNAL_EVENT(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), pairs[0].peer->id, chunkID_set_size(offer_cset), transid, sig_offer, TRACE_SENT);
 			chunkID_set_free(offer_cset);
 			res++;
 		}
 	}
+	offer_controller_update(ct->oc, net_helper_outqueue_length(psinstance_nodeid(ct->ps)));
 	free(pairs);
-	free(ch_buff);
 	return res;
 }
 
+/* Latest-missing chunk selection; each chunk is requested to the least
+ * loaded neighbour advertising it, up to max_requests_per_peer outstanding
+ * requests (i.e., locked chunks) per neighbour */
+int8_t chunk_trader_send_requests(struct chunk_trader *ct)
+{
+	struct peerset *pset;
+	struct peer ** neighs;
+	struct chunkID_set ** req_sets;
+	int * slots;
+	int n_neighs, i, best, cid, min, max = -1;
+	int8_t res = 0;
+
+	if (ct->mode == TRADE_PUSH || psinstance_is_source(ct->ps))
+		return 0;
+
+	pset = topology_get_neighbours(psinstance_topology(ct->ps));
+	n_neighs = peerset_size(pset);
+	neighs = peerset_get_peers(pset);
+	if (n_neighs <= 0)
+		return 0;
+
+	req_sets = calloc(n_neighs, sizeof(struct chunkID_set *));
+	slots = malloc(sizeof(int) * n_neighs);
+	for (i = 0; i < n_neighs; i++)
+	{
+		slots[i] = ct->max_requests_per_peer - chunk_locks_count_peer(ct->ch_locks, neighs[i]->id);
+		if (chunkID_set_size(peer_bmap(neighs[i])) > 0 && (int)chunkID_set_get_latest(peer_bmap(neighs[i])) > max)
+			max = chunkID_set_get_latest(peer_bmap(neighs[i]));
+	}
+	min = max - ct->cb_size + 1;
+	min = min < 0 ? 0 : min;
+
+	for (cid = max; cid >= min && max >= 0; cid--)
+		if (!chunk_trader_has_chunk(ct, cid) && !chunk_islocked(ct->ch_locks, cid))
+		{
+			best = -1;
+			for (i = 0; i < n_neighs; i++)
+				if (slots[i] > 0 && chunkID_set_check(peer_bmap(neighs[i]), cid) >= 0 && (best < 0 || slots[i] > slots[best]))
+					best = i;
+			if (best >= 0)
+			{
+				if (req_sets[best] == NULL)
+					req_sets[best] = chunkID_set_init("type=bitmap");
+				chunkID_set_add_chunk(req_sets[best], cid);
+				chunk_lock(ct->ch_locks, cid, neighs[best]);
+				slots[best]--;
+			}
+		}
+
+	for (i = 0; i < n_neighs; i++)
+		if (req_sets[i])
+		{
+			requestChunks(psinstance_nodeid(ct->ps), neighs[i]->id, req_sets[i], chunkID_set_size(req_sets[i]), INVALID_TRANSID);
+			reg_chunk_accept(psinstance_measures(ct->ps), neighs[i]->id, chunkID_set_size(req_sets[i]));
+			LOG_SIGNAL_EVENT(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), neighs[i]->id, chunkID_set_size(req_sets[i]), INVALID_TRANSID, sig_request, TRACE_SENT);
+			chunkID_set_free(req_sets[i]);
+			res++;
+		}
+
+	free(slots);
+	free(req_sets);
+	return res;
+}
+
+int8_t chunk_trader_advertise_bmap(struct chunk_trader *ct)
+{
+	struct peerset *pset;
+	const struct peer * p;
+	uint64_t now;
+	int i;
+	int8_t res = 0;
+
+	now = mono_clock_us();
+	if (ct->mode != TRADE_PUSH && ct->bmap_changed &&
+			now >= ct->bmap_sent + (uint64_t) ct->bmap_period * 1000)
+	{
+		pset = topology_get_neighbours(psinstance_topology(ct->ps));
+		peerset_for_each(pset, p, i)
+		{
+			chunk_trader_send_bmap(ct, p->id);
+			res++;
+		}
+		ct->bmap_changed = 0;
+		ct->bmap_sent = now;
+	}
+	return res;
+}
+
+int8_t chunk_trader_handle_request(struct chunk_trader *ct, struct peer *p, struct chunkID_set *cset, int max_deliver)
+{
+	int cid, i, pairs_len = 0;
+	struct PeerChunk * pairs;
+
+	pairs = malloc(sizeof(struct PeerChunk) * (chunkID_set_size(cset) > 0 ? chunkID_set_size(cset) : 1));
+	for(i=0; i<chunkID_set_size(cset) && pairs_len < max_deliver; i++)
+	{
+		cid = chunkID_set_get_chunk(cset, i);
+		if (chunk_trader_has_chunk(ct, cid))
+		{
+			pairs[pairs_len].peer = p;
+			pairs[pairs_len].chunk = cid;
+			pairs_len++;
+		}
+		else
+			LOG_CHUNK_ERROR(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), p->id, NULL, E_CACHE_MISS);
+	}
+	if (pairs_len > 0)
+		peer_chunk_send(ct, pairs, pairs_len, INVALID_TRANSID);
+	free(pairs);
+	return 0;
+}
+
 /* Latest-useful chunk selection */
 int8_t chunk_trader_handle_offer(struct chunk_trader *ct, struct peer *p, struct chunkID_set *cset, int max_deliver, uint16_t trans_id)
 {
@@ -335,7 +551,7 @@ int8_t chunk_trader_handle_offer(struct chunk_trader *ct, struct peer *p, struct
 
 	chunkID_set_union(peer_bmap(p), cset);
 	chunkID_set_trim(peer_bmap(p), peer_cb_size(p));
-	gettimeofday(peer_bmap_timestamp(p), NULL);
+	mono_clock_now(peer_bmap_timestamp(p));
 
 	/* we use counting sort to sort chunks in O(~|cset|) */
 	min = chunkID_set_get_earliest(cset);
@@ -353,7 +569,7 @@ int8_t chunk_trader_handle_offer(struct chunk_trader *ct, struct peer *p, struct
 	cid = max;
 	while(cid>=min && chunkID_set_size(acc_set) < max_deliver)
 	{
-		if (ids[cid-min] && !cb_get_chunk(ct->cb, cid) && !chunk_islocked(ct->ch_locks, cid))
+		if (ids[cid-min] && !chunk_trader_has_chunk(ct, cid) && !chunk_islocked(ct->ch_locks, cid))
 		{
 			chunkID_set_add_chunk(acc_set, cid);
 			chunk_lock(ct->ch_locks, cid, p);
@@ -362,9 +578,8 @@ int8_t chunk_trader_handle_offer(struct chunk_trader *ct, struct peer *p, struct
 	}
 
     acceptChunks(psinstance_nodeid(ct->ps), p->id, acc_set, trans_id);
-#ifdef LOG_SIGNAL
-	log_signal(psinstance_nodeid(ct->ps), p->id, chunkID_set_size(acc_set), trans_id, sig_accept, "SENT");
-#endif
+	reg_chunk_accept(psinstance_measures(ct->ps), p->id, chunkID_set_size(acc_set));
+	LOG_SIGNAL_EVENT(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), p->id, chunkID_set_size(acc_set), trans_id, sig_accept, TRACE_SENT);
 
 	chunkID_set_free(acc_set);
 	free(ids);
@@ -374,30 +589,31 @@ int8_t chunk_trader_handle_offer(struct chunk_trader *ct, struct peer *p, struct
 int8_t chunk_trader_handle_accept(struct chunk_trader *ct, struct peer *p, struct chunkID_set *cset, int max_deliver, uint16_t transid)
 {
 	int cid, i, max_chunks, pairs_len = 0;
-	const struct chunk *c;
 	struct PeerChunk * pairs;
 
-	max_chunks = MIN(chunkID_set_size(cset), ct->chunks_per_peer_offer);
+	max_chunks = MIN(chunkID_set_size(cset), chunk_trader_chunks_per_offer(ct));
 	pairs = malloc(sizeof(struct PeerChunk) * max_chunks);  
 
-	transaction_reg_accept(ct->transactions, transid, p->id);
+	if (transaction_reg_accept(ct->transactions, transid, p->id))
+		peer_update_rtt(p, transaction_rtt(ct->transactions, transid));
 
 	for(i=0, pairs_len=0; i<chunkID_set_size(cset) && pairs_len < max_chunks; i++)
 	{
 		cid = chunkID_set_get_chunk(cset, i);
-		c = cb_get_chunk(ct->cb, cid);
-		if (c)  // if we still have it in the chunk buffer
+		if (chunk_trader_has_chunk(ct, cid))  // in the chunk buffer or in the archive
 		{
 			pairs[pairs_len].peer = p;
 			pairs[pairs_len].chunk = cid;
 			pairs_len++;
 		} 
-#ifdef LOG_CHUNK
 		else
-			log_chunk_error(psinstance_nodeid(ct->ps), p->id, c, E_CACHE_MISS);
-#endif
+			LOG_CHUNK_ERROR(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), p->id, NULL, E_CACHE_MISS);
 	}
-	peer_chunk_send(ct, pairs, pairs_len, transid);
+	offer_controller_reg_accept(ct->oc, pairs_len);
+	if (pairs_len > 0)
+		peer_chunk_send(ct, pairs, pairs_len, transid);
+	else
+		transaction_remove(&(ct->transactions), transid);  // offer rejected, no ACK will come
 	free(pairs);
 
 	return 0;
@@ -407,8 +623,9 @@ int8_t chunk_trader_handle_ack(struct chunk_trader *ct, struct peer *p, struct c
 {
 	chunkID_set_union(peer_bmap(p), cset);
 	chunkID_set_trim(peer_bmap(p), peer_cb_size(p));
-	gettimeofday(peer_bmap_timestamp(p), NULL);
+	mono_clock_now(peer_bmap_timestamp(p));
 
+	peer_update_capacity(p, transaction_byterate(ct->transactions, transid));
 	transaction_remove(&(ct->transactions), transid);
 	return 0;
 }
@@ -422,10 +639,10 @@ int8_t chunk_trader_msg_parse(struct chunk_trader *ct, struct nodeID *from, uint
 	uint16_t trans_id;
 	enum signaling_type sig_type;
 
+	cset = NULL;
 	res = parseSignaling(buff+1, buff_len-1, &bmap_owner, &cset, &max_deliver, &trans_id, &sig_type);
-#ifdef LOG_SIGNAL
-    log_signal(from, psinstance_nodeid(ct->ps), chunkID_set_size(cset), trans_id, sig_type, "RECEIVED");
-#endif
+	if (res >= 0)
+		LOG_SIGNAL_EVENT(ct->log, psinstance_tracer(ct->ps), from, psinstance_nodeid(ct->ps), cset ? chunkID_set_size(cset) : 0, trans_id, sig_type, TRACE_RECEIVED);
 	if (res >= 0)
 	{
 		res = 0;
@@ -435,7 +652,7 @@ int8_t chunk_trader_msg_parse(struct chunk_trader *ct, struct nodeID *from, uint
 				case sig_send_buffermap:
 					chunkID_set_clear(peer_bmap(p), 0);
 					chunkID_set_union(peer_bmap(p), cset);
-					gettimeofday(peer_bmap_timestamp(p), NULL);
+					mono_clock_now(peer_bmap_timestamp(p));
 					break;
 				case sig_offer:
 					p = nodeid_to_peer(psinstance_topology(ct->ps), from, 1);
@@ -447,6 +664,13 @@ int8_t chunk_trader_msg_parse(struct chunk_trader *ct, struct nodeID *from, uint
 				case sig_ack:
 					chunk_trader_handle_ack(ct, p, cset, trans_id);
 					break;
+				case sig_request:
+					p = nodeid_to_peer(psinstance_topology(ct->ps), from, 1);
+					chunk_trader_handle_request(ct, p, cset, max_deliver);
+					break;
+				case sig_request_buffermap:
+					chunk_trader_send_bmap(ct, p->id);
+					break;
 				default:
 				  res = -1;
 			}
@@ -462,16 +686,27 @@ int8_t chunk_trader_send_bmap(const struct chunk_trader *ct, const struct nodeID
 {
 	struct chunkID_set *bmap;
 
-	bmap = chunk_buffer_to_idset(ct->cb);
+	bmap = chunk_ring_to_idset(ct->ring);
 	sendBufferMap(psinstance_nodeid(ct->ps), to, psinstance_nodeid(ct->ps), bmap, psinstance_is_source(ct->ps) ? 0 : ct->cb_size, INVALID_TRANSID);
-#ifdef LOG_SIGNAL
-	log_signal(psinstance_nodeid(ct->ps), to, chunkID_set_size(bmap), INVALID_TRANSID, sig_send_buffermap,"SENT");
-#endif
+	LOG_SIGNAL_EVENT(ct->log, psinstance_tracer(ct->ps), psinstance_nodeid(ct->ps), to, chunkID_set_size(bmap), INVALID_TRANSID, sig_send_buffermap, TRACE_SENT);
 	chunkID_set_free(bmap);
 	return 0;
 }
 
 /** utils **/
+uint16_t chunk_trader_expire(struct chunk_trader *ct)
+{
+	uint16_t expired = 0;
+
+	if (ct)
+	{
+		expired = transaction_expire(&(ct->transactions));
+		offer_controller_reg_timeouts(ct->oc, expired);
+		chunk_locks_cleanup(ct->ch_locks);
+	}
+	return expired;
+}
+
 suseconds_t chunk_trader_offer_interval(const struct chunk_trader *ct)
 {
 	struct peerset *pset;
@@ -492,5 +727,5 @@ suseconds_t chunk_trader_offer_interval(const struct chunk_trader *ct)
 		ms_int /= load;
 	} 
 
-	return (suseconds_t)(ms_int / ct->offer_per_period);
+	return (suseconds_t)(ms_int / (ct->offer_per_period * offer_controller_rate(ct->oc)));
 }
@@ -29,6 +29,8 @@
 #include<topology.h>
 #include<net_helper.h>
 #include<chunk_attributes.h>
+#include<shared_chunk.h>
+#include<chunk_archive.h>
 
 #define E_CANNOT_PARSE -3
 #define E_CACHE_MISS -4
@@ -39,25 +41,55 @@ struct chunk_trader * chunk_trader_create(const struct psinstance *ps, const cha
 
 void chunk_trader_destroy(struct chunk_trader **ct);
 
+/* copies the chunk in the trading buffer, c stays with the caller */
 int8_t chunk_trader_add_chunk(struct chunk_trader *ct, struct chunk *c);
 
+/* the buffered copy of chunk id, NULL if not (or no longer) buffered */
+struct shared_chunk * chunk_trader_shared_chunk(const struct chunk_trader *ct, int id);
+
 /** chunk actions **/
 void chunk_destroy(struct chunk **c);
 
 int8_t chunk_trader_push_chunk(struct chunk_trader *ct, struct chunk *c, int multiplicity);
 
-struct chunk * chunk_trader_parse_chunk(struct chunk_trader *ct, struct nodeID *from, uint8_t *buff, int len);
+/* decodes the chunk message body in buff (transaction ID and chunk), c
+ * payload and attributes pointing into it; returns the decoded length, -1
+ * if buff is shorter than the header or -2 if the sizes do not fit len */
+int chunk_decode_inplace(struct chunk *c, uint8_t *buff, int len, uint16_t *transid);
+
+/* parses a chunk message in place: c payload and attributes point into
+ * buff, which must outlive them. Returns 0 or E_CANNOT_PARSE */
+int8_t chunk_trader_parse_chunk(struct chunk_trader *ct, struct nodeID *from, uint8_t *buff, int len, struct chunk *c);
 
 /** signalling actions **/
 int8_t chunk_trader_send_offer(struct chunk_trader *ct);
 
+int8_t chunk_trader_send_requests(struct chunk_trader *ct);
+
+/* sends the buffermap to the neighbourhood if it changed, at most once
+ * every bmap_period milliseconds */
+int8_t chunk_trader_advertise_bmap(struct chunk_trader *ct);
+
 int8_t chunk_trader_msg_parse(struct chunk_trader *ct, struct nodeID *from, uint8_t *buff, int buff_len);
 
 int8_t chunk_trader_send_bmap(const struct chunk_trader *ct, const struct nodeID *to);
 
 /** utils **/
+/* drops expired transactions and chunk locks, returns the expired transactions */
+uint16_t chunk_trader_expire(struct chunk_trader *ct);
+
 suseconds_t chunk_trader_offer_interval(const struct chunk_trader *ct);
 
 int chunk_trader_buffer_size(const struct chunk_trader *ct);
 
+struct chunk_trader_stats {
+	int buffered;  // chunks in the trading buffer
+	int archived;
+	int locks;  // chunks accepted or requested and not yet received
+	int transactions;  // offers waiting for their accept
+	int chunks_per_offer;
+};
+
+int8_t chunk_trader_stats(const struct chunk_trader *ct, struct chunk_trader_stats *stats);
+
 #endif
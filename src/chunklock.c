@@ -29,6 +29,7 @@
 #include "chunklock.h"
 
 #include "net_helper.h"
+#include "mono_clock.h"
 #define LSIZE_INCREMENT 10
 
 
@@ -89,13 +90,12 @@ struct chunk_locks * chunk_locks_create(uint32_t lock_timeout_ms)
 	return cl;
 }
 
-int chunk_lock_timed_out(struct chunk_locks *cl, struct lock *l)
+int chunk_lock_timed_out(struct chunk_locks *cl, struct lock *l, const struct timeval *tnow)
 {
-  struct timeval tnow,tout;
-  gettimeofday(&tnow, NULL);
+  struct timeval tout;
   timeradd(&l->timestamp, &(cl->toutdiff), &tout);
 
-  return timercmp(&tnow, &tout, >);
+  return timercmp(tnow, &tout, >);
 }
 
 void chunk_lock_remove(struct chunk_locks * cl, struct lock *l){
@@ -107,9 +107,11 @@ void chunk_lock_remove(struct chunk_locks * cl, struct lock *l){
 
 void chunk_locks_cleanup(struct chunk_locks * cl){
   int i;
+  struct timeval tnow;
 
+  mono_clock_now(&tnow);
   for (i=(cl->lcount)-1; i>=0; i--) {
-    if (chunk_lock_timed_out(cl, cl->locks+i)) {
+    if (chunk_lock_timed_out(cl, cl->locks+i, &tnow)) {
       chunk_lock_remove(cl, cl->locks+i);
     }
   }
@@ -120,7 +122,7 @@ void chunk_lock(struct chunk_locks * cl, int chunkid, struct peer *from){
   {
 	  cl->locks[cl->lcount].chunkid = chunkid;
 	  cl->locks[cl->lcount].peer = from ? nodeid_dup(from->id) : NULL;
-	  gettimeofday(&((cl->locks)[cl->lcount].timestamp), NULL);
+	  mono_clock_now(&((cl->locks)[cl->lcount].timestamp));
 	  cl->lcount++;
 
 	  if (cl->lcount == cl->lsize) {
@@ -159,3 +161,24 @@ int chunk_islocked(struct chunk_locks * cl, int chunkid){
   }
   return 0;
 }
+
+int chunk_locks_count_peer(struct chunk_locks * cl, const struct nodeID *id){
+  size_t i;
+  int count = 0;
+
+  if (cl && id)
+  {
+	  chunk_locks_cleanup(cl);
+
+	  for (i=0; i<cl->lcount; i++) {
+		if ((cl->locks)[i].peer && nodeid_equal((cl->locks)[i].peer, id)) {
+		  count++;
+		}
+	  }
+  }
+  return count;
+}
+
+int chunk_locks_count(const struct chunk_locks * cl){
+  return cl ? (int) cl->lcount : 0;
+}
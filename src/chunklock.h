@@ -31,5 +31,8 @@ void chunk_locks_destroy(struct chunk_locks ** cl);
 void chunk_lock(struct chunk_locks * cl, int chunkid, struct peer *from);
 void chunk_unlock(struct chunk_locks * cl, int chunkid);
 int chunk_islocked(struct chunk_locks * cl, int chunkid);
+void chunk_locks_cleanup(struct chunk_locks * cl);
+int chunk_locks_count_peer(struct chunk_locks * cl, const struct nodeID *id);
+int chunk_locks_count(const struct chunk_locks * cl);
 
 #endif //CHUNKLOCK_H
@@ -23,14 +23,76 @@
 #include <stdarg.h>
 #include <time.h>
 #include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
 
 #include<dbg.h>
+#include<grapes_config.h>
 #include<chunk_trader.h>
 #include<net_helpers.h>
 #include <peerset.h>
 #include <chunkbuffer.h>
+#include <chunk_attributes.h>
 
 
+#ifdef LOG_CHUNK
+#define LOG_CHUNK_RATE 1
+#else
+#define LOG_CHUNK_RATE 0
+#endif
+#ifdef LOG_SIGNAL
+#define LOG_SIGNAL_RATE 1
+#else
+#define LOG_SIGNAL_RATE 0
+#endif
+
+static const char * log_keys[LOG_CATEGORIES] = {"log_chunk", "log_signal"};
+
+void log_rates_init(struct log_rates * l)
+{
+	memset(l, 0, sizeof(struct log_rates));
+	l->rate[LOG_CAT_CHUNK] = LOG_CHUNK_RATE;
+	l->rate[LOG_CAT_SIGNAL] = LOG_SIGNAL_RATE;
+}
+
+int8_t log_sample(struct log_rates * l, enum log_category cat)
+{
+	uint32_t rate;
+
+	rate = __atomic_load_n(&l->rate[cat], __ATOMIC_RELAXED);
+	if (rate <= 1)
+		return rate == 1;
+	return __atomic_fetch_add(&l->count[cat], 1, __ATOMIC_RELAXED) % rate == 0;
+}
+
+int8_t log_configure(struct log_rates * l, const char * config)
+{
+	struct tag * tags;
+	int i, rate;
+
+	if (l == NULL)
+		return -1;
+	tags = grapes_config_parse(config);
+	if (tags == NULL)
+		return -1;
+	for (i = 0; i < LOG_CATEGORIES; i++)
+	{
+		grapes_config_value_int_default(tags, log_keys[i], &rate, __atomic_load_n(&l->rate[i], __ATOMIC_RELAXED));
+		__atomic_store_n(&l->rate[i], rate > 0 ? rate : 0, __ATOMIC_RELAXED);
+	}
+	free(tags);
+	return 0;
+}
+
+int log_config_str(const struct log_rates * l, char * buff, int len)
+{
+	int i, n = 0;
+
+	for (i = 0; i < LOG_CATEGORIES && n < len; i++)
+		n += snprintf(buff + n, len - n, "%s%s=%u", i ? "," : "", log_keys[i], __atomic_load_n(&l->rate[i], __ATOMIC_RELAXED));
+	return n;
+}
+
 int ftprintf(FILE *stream, const char *format, ...)
 {
   va_list ap;
@@ -55,56 +117,55 @@ uint64_t gettimeofday_in_us(void)
 	return what_time.tv_sec * 1000000ULL + what_time.tv_usec;
 }
 
-void log_signal(const struct nodeID *fromid,const struct nodeID *toid,const int cidset_size,uint16_t trans_id,enum signaling_type type,const char *flag)
+void log_trace_names(const struct nodeID *from, const struct nodeID *to, char *sndr, char *rcvr)
 {
-	char typestr[24];
-	char sndr[NODE_STR_LENGTH],rcvr[NODE_STR_LENGTH];
-	node_addr(fromid,sndr,NODE_STR_LENGTH);
-	node_addr(toid,rcvr,NODE_STR_LENGTH);
+	strcpy(sndr, "ND");
+	strcpy(rcvr, "ND");
+	if (from)
+		node_addr(from, sndr, NODE_STR_LENGTH);
+	if (to)
+		node_addr(to, rcvr, NODE_STR_LENGTH);
+}
 
-	switch (type)
-	{
-		case sig_offer:
-			sprintf(typestr,"%s","OFFER_SIG");
-			break;
-		case sig_accept:
-			sprintf(typestr,"%s","ACCEPT_SIG");
-			break;
-		case sig_request:
-			sprintf(typestr,"%s","REQUEST_SIG");
-			break;
-		case sig_deliver:
-			sprintf(typestr,"%s","DELIVER_SIG");
-			break;
-		case sig_send_buffermap:
-			sprintf(typestr,"%s","SEND_BMAP_SIG");
-			break;
-		case sig_request_buffermap:
-			sprintf(typestr,"%s","REQUEST_BMAP_SIG");
-			break;
-		case sig_ack:
-			sprintf(typestr,"%s","CHUNK_ACK_SIG");
-			break;
-		default:
-			sprintf(typestr,"%s","UNKNOWN_SIG");
+void log_signal(struct tracer *t, const struct nodeID *fromid,const struct nodeID *toid,const int cidset_size,uint16_t trans_id,enum signaling_type type,enum trace_note note)
+{
+	struct trace_record r;
+	char sndr[NODE_STR_LENGTH],rcvr[NODE_STR_LENGTH];
 
+	if (t)
+		tracer_signal(t, fromid, toid, cidset_size, trans_id, type, note);
+	else {
+		memset(&r, 0, sizeof(struct trace_record));
+		r.time = gettimeofday_in_us();
+		r.event = TRACE_SIGNAL;
+		r.note = note;
+		r.trans_id = trans_id;
+		r.u.signal.cidset_size = cidset_size;
+		r.u.signal.type = type;
+		log_trace_names(fromid, toid, sndr, rcvr);
+		tracer_print_record(stderr, &r, sndr, rcvr);
 	}
-	fprintf(stderr,"[SIGNAL_LOG],%"PRIu64",%s,%s,%d,%s,%s\n",gettimeofday_in_us(),sndr,rcvr,trans_id,typestr,flag);
 }
 
-void log_chunk(const struct nodeID *from,const struct nodeID *to,const struct chunk *c,const char * note)
+void log_chunk(struct tracer *t, const struct nodeID *from,const struct nodeID *to,const struct chunk *c,enum trace_note note)
 {
-	// semantic: [CHUNK_LOG],log_date,sender,receiver,id,size(bytes),chunk_timestamp,hopcount,notes
-	char sndr[NODE_STR_LENGTH] = "ND",rcvr[NODE_STR_LENGTH] = "ND";
-	if (from)
-	node_addr(from,sndr,NODE_STR_LENGTH);
-	if (to)
-		node_addr(to,rcvr,NODE_STR_LENGTH);
+	struct trace_record r;
+	char sndr[NODE_STR_LENGTH],rcvr[NODE_STR_LENGTH];
 
-	if (c)
-		fprintf(stderr,"[CHUNK_LOG],%"PRIu64",%s,%s,%d,%d,%"PRIu64",%i,%s\n",gettimeofday_in_us(),sndr,rcvr,c->id,c->size,c->timestamp,chunk_attributes_get_hopcount(c),note);
-	else
-		fprintf(stderr,"[CHUNK_LOG],%"PRIu64",%s,%s,%d,%d,%d,%i,%s\n",gettimeofday_in_us(),sndr,rcvr,-1,-1,0,0,note);
+	if (t)
+		tracer_chunk(t, from, to, c, note);
+	else {
+		memset(&r, 0, sizeof(struct trace_record));
+		r.time = gettimeofday_in_us();
+		r.event = TRACE_CHUNK;
+		r.note = note;
+		r.u.chunk.id = c ? c->id : -1;
+		r.u.chunk.size = c ? c->size : -1;
+		r.u.chunk.timestamp = c ? c->timestamp : 0;
+		r.u.chunk.hopcount = c ? chunk_attributes_get_hopcount(c) : 0;
+		log_trace_names(from, to, sndr, rcvr);
+		tracer_print_record(stderr, &r, sndr, rcvr);
+	}
 }
 
 void log_neighbourhood(const struct psinstance * ps)
@@ -124,22 +185,22 @@ void log_neighbourhood(const struct psinstance * ps)
 
 }
 
-void log_chunk_error(const struct nodeID *from,const struct nodeID *to,const struct chunk *c,int error)
+void log_chunk_error(struct tracer *t, const struct nodeID *from,const struct nodeID *to,const struct chunk *c,int error)
 {
 	switch (error) {
 		case E_CB_OLD:
-			log_chunk(from,to,c,"TOO_OLD");
+			log_chunk(t,from,to,c,TRACE_TOO_OLD);
 			break;
 		case E_CB_DUPLICATE:
-			log_chunk(from,to,c,"DUPLICATED");
+			log_chunk(t,from,to,c,TRACE_DUPLICATED);
 			break;
 		case E_CANNOT_PARSE:
-			log_chunk(from,to,NULL,"CANNOT_PARSE");
+			log_chunk(t,from,to,NULL,TRACE_CANNOT_PARSE);
 			break;
 		case E_CACHE_MISS:
-			log_chunk(from,to,NULL,"CACHE_MISS");
+			log_chunk(t,from,to,NULL,TRACE_CACHE_MISS);
 			break;
 		default:
-			log_chunk(from,to,c,"ERROR");
+			log_chunk(t,from,to,c,TRACE_ERROR);
 	} 
 }
@@ -29,6 +29,7 @@
 #include <topology.h>
 #include <psinstance.h>
 #include <trade_sig_ha.h>
+#include <tracer.h>
 
 int ftprintf(FILE *stream, const char *format, ...);
 
@@ -40,12 +41,45 @@ int ftprintf(FILE *stream, const char *format, ...);
 #define dtprintf(...)
 #endif
 
-void log_signal(const struct nodeID *fromid,const struct nodeID *toid,const int cidset_size,uint16_t trans_id,enum signaling_type type,const char *flag);
+/* Chunk and signal logging is switched on at runtime, per instance and
+ * per category, with a sampling rate: 0 disables a category, n logs one
+ * event in n. The LOG_*_EVENT macros test the rate before evaluating any
+ * other argument, so a disabled category costs one predictable branch.
+ * LOG_CHUNK/LOG_SIGNAL at compile time only turn the categories on by
+ * default. */
+enum log_category {LOG_CAT_CHUNK, LOG_CAT_SIGNAL, LOG_CATEGORIES};
 
-void log_chunk(const struct nodeID *from,const struct nodeID *to,const struct chunk *c,const char * note);
+struct log_rates {
+	uint32_t rate[LOG_CATEGORIES];  // set from any thread
+	uint32_t count[LOG_CATEGORIES];  // events seen, for sampling
+};
+
+#define log_enabled(l, cat) __builtin_expect(__atomic_load_n(&(l)->rate[cat], __ATOMIC_RELAXED) != 0, 0)
+
+#define LOG_CHUNK_EVENT(l, ...) do { if (log_enabled(l, LOG_CAT_CHUNK) && log_sample(l, LOG_CAT_CHUNK)) log_chunk(__VA_ARGS__); } while (0)
+#define LOG_CHUNK_ERROR(l, ...) do { if (log_enabled(l, LOG_CAT_CHUNK) && log_sample(l, LOG_CAT_CHUNK)) log_chunk_error(__VA_ARGS__); } while (0)
+#define LOG_SIGNAL_EVENT(l, ...) do { if (log_enabled(l, LOG_CAT_SIGNAL) && log_sample(l, LOG_CAT_SIGNAL)) log_signal(__VA_ARGS__); } while (0)
+
+/* compile time defaults */
+void log_rates_init(struct log_rates * l);
+
+/* 1 if this event of an enabled category is to be logged */
+int8_t log_sample(struct log_rates * l, enum log_category cat);
+
+/* reads the log_chunk and log_signal rates, the categories not in config
+ * are left as they are; safe to be called from any thread */
+int8_t log_configure(struct log_rates * l, const char * config);
+
+/* writes the current rates as a config string */
+int log_config_str(const struct log_rates * l, char * buff, int len);
+
+/* the chunk and signal logs go to the tracer if any, otherwise to stderr */
+void log_signal(struct tracer *t, const struct nodeID *fromid,const struct nodeID *toid,const int cidset_size,uint16_t trans_id,enum signaling_type type,enum trace_note note);
+
+void log_chunk(struct tracer *t, const struct nodeID *from,const struct nodeID *to,const struct chunk *c,enum trace_note note);
 
 void log_neighbourhood(const struct psinstance * ps);
 
-void log_chunk_error(const struct nodeID *from,const struct nodeID *to,const struct chunk *c,int error);
+void log_chunk_error(struct tracer *t, const struct nodeID *from,const struct nodeID *to,const struct chunk *c,int error);
 
 #endif	/* DBG_H */
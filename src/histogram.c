@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<string.h>
+#include<histogram.h>
+
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+int histogram_index(uint64_t v)
+{
+	int e;
+
+	if (v < SUB_BUCKETS)
+		return v;
+	if (v >> HISTOGRAM_MAX_BITS)
+		v = (1ULL << HISTOGRAM_MAX_BITS) - 1;
+	e = 63 - __builtin_clzll(v);  // magnitude, at least HISTOGRAM_SUB_BITS
+	return ((e - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS) + ((v >> (e - HISTOGRAM_SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t histogram_bucket_value(int i)
+	/* middle of the bucket range */
+{
+	int e, shift;
+
+	if (i < SUB_BUCKETS)
+		return i;
+	e = (i >> HISTOGRAM_SUB_BITS) + HISTOGRAM_SUB_BITS - 1;
+	shift = e - HISTOGRAM_SUB_BITS;
+	return ((uint64_t)(SUB_BUCKETS + (i & (SUB_BUCKETS - 1))) << shift) + ((1ULL << shift) >> 1);
+}
+
+void histogram_reset(struct histogram * h)
+{
+	if (h)
+		memset(h, 0, sizeof(struct histogram));
+}
+
+void histogram_add(struct histogram * h, uint64_t v)
+{
+	if (h)
+	{
+		h->counts[histogram_index(v)]++;
+		h->count++;
+		h->sum += v;
+		if (v > h->max)
+			h->max = v;
+	}
+}
+
+void histogram_merge(struct histogram * h, const struct histogram * src)
+{
+	int i;
+
+	if (h && src && src->count)
+	{
+		for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+			h->counts[i] += src->counts[i];
+		h->count += src->count;
+		h->sum += src->sum;
+		if (src->max > h->max)
+			h->max = src->max;
+	}
+}
+
+uint64_t histogram_percentile(const struct histogram * h, double p)
+{
+	uint64_t target, seen = 0, v;
+	int i;
+
+	if (h == NULL || h->count == 0)
+		return 0;
+	if (p >= 100)
+		return h->max;
+	target = p <= 0 ? 1 : (uint64_t) (p / 100 * h->count + 0.5);
+	if (target < 1)
+		target = 1;
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		seen += h->counts[i];
+		if (seen >= target)
+		{
+			v = histogram_bucket_value(i);
+			return v < h->max ? v : h->max;
+		}
+	}
+	return h->max;
+}
+
+double histogram_mean(const struct histogram * h)
+{
+	return h && h->count ? (double) h->sum / h->count : 0;
+}
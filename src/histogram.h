@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include<stdint.h>
+
+/* Fixed memory, log-linear histogram in the HDR style: values below
+ * 2^HISTOGRAM_SUB_BITS are counted exactly, larger ones in buckets whose
+ * width is 1/2^HISTOGRAM_SUB_BITS of their magnitude, which bounds the
+ * relative error of percentiles to 12.5%. Values are clamped to
+ * 2^HISTOGRAM_MAX_BITS - 1. */
+
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+struct histogram {
+	uint32_t counts[HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+};
+
+void histogram_reset(struct histogram * h);
+
+void histogram_add(struct histogram * h, uint64_t v);
+
+/* adds the samples of src to h */
+void histogram_merge(struct histogram * h, const struct histogram * src);
+
+/* value below which fall p percent of the samples, 0 if empty */
+uint64_t histogram_percentile(const struct histogram * h, double p);
+
+double histogram_mean(const struct histogram * h);
+
+#endif
@@ -24,6 +24,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <chunk.h>
 #include <chunkiser.h>
@@ -31,22 +38,363 @@
 #include "input.h"
 #include "dbg.h"
 #include<chunk_attributes.h>
+#include<mono_clock.h>
+#include<grapes_config.h>
+#include<chunk_file.h>
 
 #define INITIAL_ID 0
 #define DEFAULT_DATA_INTERVAL 3000
+#define DEFAULT_MAP_CHUNK_SIZE 16384
+#define DEFAULT_MAP_CHUNK_INTERVAL 40000
+#define MAP_READAHEAD 64  // chunks
+#define MAX_TRACKS 8
+#define TRACK_QUEUE_SIZE 256  // chunks
+#define TRACK_POLL_TIMEOUT 100  // milliseconds
+#define TRACK_SEPARATOR '|'
+#define MAX_LATENESS 500000  // microseconds behind the media clock before rebasing it
+
+/* read-only file mapping, alive until the input and every chunk sliced
+ * from it have been released */
+struct input_map {
+  uint8_t *base;
+  size_t len;
+  uint32_t refs;
+};
+
+/* chunks handed out by input_chunk; map is NULL when the payload has been
+ * allocated by the GRAPES chunkiser */
+struct input_chunk {
+  struct chunk c;
+  struct input_map *map;
+};
+
+struct input_queued {
+  struct chunk c;
+  struct input_map *map;
+  uint16_t track;
+};
+
+struct input_multi;
+
+struct input_track {
+  struct input_desc *in;
+  int fds[FDSSIZE];
+  uint16_t n;
+  pthread_t thread;
+  struct input_multi *m;
+};
+
+/* tracks chunkised by one worker thread each and merged, in production
+ * order, through a bounded queue; a pipe wakes the source up */
+struct input_multi {
+  struct input_track tracks[MAX_TRACKS];
+  int n;
+  int started;  // tracks with a running thread
+  struct input_queued queue[TRACK_QUEUE_SIZE];
+  int head;
+  int len;
+  pthread_mutex_t lock;
+  pthread_cond_t space;
+  int pipe[2];
+  int running;
+};
 
 struct input_desc {
   struct input_stream *s;
+  struct input_multi *multi;
+  struct input_map *map;
+  struct chunk_file *cf;  // pre-chunkised container in map
+  int64_t loop_ts;  // added to the container timestamps and IDs, which
+  int loop_id;      // keep growing when it restarts
+  uint64_t last_ts;
+  int last_id;
+  int first_ts_set;
+  size_t offset;  // of the next mapped chunk
+  size_t advised;  // mapped bytes already announced with MADV_WILLNEED
+  uint64_t mapped_chunks;
+  int chunk_size;
+  int loop;
   int id;
   int interframe;
   uint64_t start_time;
   uint64_t first_ts;
+  uint64_t deadline;  // of the next chunk, monotonic microseconds
 };
 
+struct input_map *input_map_ref(struct input_map *m)
+  /* references can be taken and dropped by the track threads */
+{
+  if (m) {
+    __atomic_add_fetch(&m->refs, 1, __ATOMIC_RELAXED);
+  }
+  return m;
+}
+
+void input_map_unref(struct input_map **m)
+{
+  if (m && *m) {
+    if (__atomic_sub_fetch(&(*m)->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+      munmap((*m)->base, (*m)->len);
+      free(*m);
+    }
+    *m = NULL;
+  }
+}
+
+struct input_map *input_map_open(const char *fname)
+{
+  struct input_map *m = NULL;
+  struct stat st;
+  void *base;
+  int fd;
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open %s\n", fname);
+    return NULL;
+  }
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base != MAP_FAILED) {
+      madvise(base, st.st_size, MADV_SEQUENTIAL);
+      m = malloc(sizeof(struct input_map));
+      m->base = base;
+      m->len = st.st_size;
+      m->refs = 1;
+    } else
+      fprintf(stderr, "Cannot map %s\n", fname);
+  } else
+    fprintf(stderr, "Cannot map %s: empty or not a regular file\n", fname);
+  close(fd);  // the mapping keeps the file referenced
+
+  return m;
+}
+
+int input_map_chunkise(struct input_desc *s, struct chunk *c)
+  /* slices the next chunk_size bytes of the mapping as c payload */
+{
+  size_t ahead;
+
+  if (s->offset >= s->map->len) {
+    if (!s->loop) {
+      return -1;  // end of the file
+    }
+    s->offset = 0;
+    s->advised = 0;
+  }
+  c->data = s->map->base + s->offset;
+  c->size = s->map->len - s->offset < (size_t)s->chunk_size ? (int)(s->map->len - s->offset) : s->chunk_size;
+  s->offset += c->size;
+
+  ahead = s->offset + (size_t)s->chunk_size * MAP_READAHEAD;
+  if (ahead > s->map->len) {
+    ahead = s->map->len;
+  }
+  if (ahead > s->advised) {  // page aligned, as madvise wants it
+    size_t from = s->advised & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+    madvise(s->map->base + from, ahead - from, MADV_WILLNEED);
+    s->advised = ahead;
+  }
+
+  s->mapped_chunks++;
+  c->timestamp = s->mapped_chunks * s->interframe;
+  return 1;
+}
+
+int input_file_chunkise(struct input_desc *s, struct chunk *c)
+  /* serves the next container chunk, restarting it with input_loop;
+   * -1 at its end, -2 if it is corrupted */
+{
+  int res;
+
+  res = chunk_file_next(s->cf, c);
+  if (res == 0 && s->loop && chunk_file_chunks(s->cf) && chunk_file_seek(s->cf, 0) == 0) {
+    res = chunk_file_next(s->cf, c);
+    if (res > 0) {
+      s->loop_ts = (int64_t)(s->last_ts + s->interframe) - (int64_t)c->timestamp;
+      s->loop_id = s->last_id + 1 - c->id;
+    }
+  }
+  if (res > 0) {
+    c->timestamp += s->loop_ts;
+    c->id += s->loop_id;
+    s->last_ts = c->timestamp;
+    s->last_id = c->id;
+  }
+  if (res < 0) {
+    fprintf(stderr, "Corrupted chunk container\n");
+    return -2;
+  }
+  return res ? res : -1;
+}
+
+void *input_track_loop(void *arg)
+{
+  struct input_track *t = arg;
+  struct input_multi *m = t->m;
+  struct input_queued *q;
+  struct pollfd pfds[FDSSIZE];
+  struct timespec pause;
+  struct chunk c;
+  int delta, n;
+
+  while (__atomic_load_n(&m->running, __ATOMIC_ACQUIRE)) {
+    if (t->in->interframe == 0) {  // live input, wait for its fds
+      for (n = 0; n < FDSSIZE && t->fds[n] >= 0; n++) {
+        pfds[n].fd = t->fds[n];
+        pfds[n].events = POLLIN;
+      }
+      if (poll(pfds, n, TRACK_POLL_TIMEOUT) <= 0) {
+        continue;
+      }
+    }
+    memset(&c, 0, sizeof(struct chunk));
+    delta = input_get(t->in, &c);
+    if (delta < 0) {
+      fprintf(stderr, "Track %d ended\n", t->n);
+      break;
+    }
+    if (c.data) {
+      pthread_mutex_lock(&m->lock);
+      while (m->len == TRACK_QUEUE_SIZE && m->running) {
+        pthread_cond_wait(&m->space, &m->lock);
+      }
+      if (m->running) {
+        q = &m->queue[(m->head + m->len++) % TRACK_QUEUE_SIZE];
+        q->c = c;
+        q->map = input_map_ref(t->in->map);
+        q->track = t->n;
+        if (write(m->pipe[1], "", 1) != 1) {
+          fprintf(stderr, "Cannot wake the source up\n");
+        }
+      } else if (t->in->map == NULL) {
+        free(c.data);
+      }
+      pthread_mutex_unlock(&m->lock);
+    }
+    if (t->in->interframe && delta > 0) {  // paced input
+      pause.tv_sec = delta / 1000000;
+      pause.tv_nsec = (delta % 1000000) * 1000;
+      nanosleep(&pause, NULL);
+    }
+  }
+  return NULL;
+}
+
+void input_multi_close(struct input_multi *m)
+{
+  int i;
+
+  pthread_mutex_lock(&m->lock);
+  __atomic_store_n(&m->running, 0, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&m->space);
+  pthread_mutex_unlock(&m->lock);
+  for (i = 0; i < m->started; i++) {
+    pthread_join(m->tracks[i].thread, NULL);
+  }
+  for (; m->len > 0; m->len--, m->head = (m->head + 1) % TRACK_QUEUE_SIZE) {
+    if (m->queue[m->head].map) {
+      input_map_unref(&m->queue[m->head].map);
+    } else {
+      free(m->queue[m->head].c.data);
+    }
+  }
+  for (i = 0; i < m->n; i++) {
+    input_close(m->tracks[i].in);
+  }
+  close(m->pipe[0]);
+  close(m->pipe[1]);
+  pthread_cond_destroy(&m->space);
+  pthread_mutex_destroy(&m->lock);
+  free(m);
+}
+
+struct input_multi *input_multi_open(const char *fnames, const char * config)
+  /* opens every TRACK_SEPARATOR separated file with the same configuration */
+{
+  struct input_multi *m;
+  char *names, *name, *next;
+  int i, ok = 1;
+
+  m = malloc(sizeof(struct input_multi));
+  memset(m, 0, sizeof(struct input_multi));
+  names = strdup(fnames);
+  for (name = names; name && ok; name = next) {
+    next = strchr(name, TRACK_SEPARATOR);
+    if (next) {
+      *(next++) = 0;
+    }
+    if (m->n == MAX_TRACKS) {
+      fprintf(stderr, "Too many tracks, at most %d are supported\n", MAX_TRACKS);
+      ok = 0;
+    } else {
+      m->tracks[m->n].in = input_open(name, m->tracks[m->n].fds, FDSSIZE, config);
+      ok = m->tracks[m->n].in != NULL;
+      m->n += ok;
+    }
+  }
+  free(names);
+  if (ok && pipe(m->pipe) == 0) {
+    fcntl(m->pipe[0], F_SETFL, O_NONBLOCK);
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->space, NULL);
+    m->running = 1;
+    for (i = 0; i < m->n; i++) {
+      m->tracks[i].n = i;
+      m->tracks[i].m = m;
+      if (pthread_create(&m->tracks[i].thread, NULL, input_track_loop, &m->tracks[i])) {
+        fprintf(stderr, "Cannot start the thread of track %d\n", i);
+        input_multi_close(m);  // stops the tracks already started
+        return NULL;
+      }
+      m->started++;
+    }
+    fprintf(stderr, "Merging %d tracks\n", m->n);
+  } else {
+    for (i = 0; i < m->n; i++) {
+      input_close(m->tracks[i].in);
+    }
+    free(m);
+    m = NULL;
+  }
+  return m;
+}
+
+struct input_chunk *input_multi_chunk(struct input_desc *s)
+  /* the next merged chunk, with the next ID of the common ID space */
+{
+  struct input_multi *m = s->multi;
+  struct input_queued *q;
+  struct input_chunk *ic = NULL;
+  uint8_t b;
+
+  if (read(m->pipe[0], &b, 1) != 1) {
+    return NULL;
+  }
+  pthread_mutex_lock(&m->lock);
+  if (m->len > 0) {
+    q = &m->queue[m->head];
+    m->head = (m->head + 1) % TRACK_QUEUE_SIZE;
+    m->len--;
+    pthread_cond_signal(&m->space);
+
+    ic = malloc(sizeof(struct input_chunk));
+    ic->c = q->c;
+    ic->map = q->map;
+    ic->c.id = s->id++;
+    chunk_attributes_init(&ic->c);
+    chunk_attributes_set_track(&ic->c, q->track);
+  }
+  pthread_mutex_unlock(&m->lock);
+  return ic;
+}
+
 struct input_desc *input_open(const char *fname, int *fds, int fds_size, const char * config)
 {
   struct input_desc *res;
   struct timeval tv;
+  struct tag *tags;
+  int mmap_mode = 0, prechunked = 0, seek = 0;
   char *c;
 
   res = malloc(sizeof(struct input_desc));
@@ -59,8 +407,51 @@ struct input_desc *input_open(const char *fname, int *fds, int fds_size, const c
   if (c) {
     *(c++) = 0;
   }
-  res->s = input_stream_open(fname, &res->interframe, config);
-  if (res->s == NULL) {
+  if (strchr(fname, TRACK_SEPARATOR)) {
+    res->multi = input_multi_open(fname, config);
+    if (res->multi == NULL) {
+      free(res);
+      return NULL;
+    }
+    if (fds_size >= 2) {
+      fds[0] = res->multi->pipe[0];
+      fds[1] = -1;
+    }
+    res->id = INITIAL_ID;
+    return res;
+  }
+  tags = grapes_config_parse(config);
+  if (tags) {
+    grapes_config_value_int_default(tags, "input_mmap", &mmap_mode, 0);
+    grapes_config_value_int_default(tags, "input_chunk_size", &res->chunk_size, DEFAULT_MAP_CHUNK_SIZE);
+    grapes_config_value_int_default(tags, "input_chunk_interval", &res->interframe, DEFAULT_MAP_CHUNK_INTERVAL);
+    grapes_config_value_int_default(tags, "input_loop", &res->loop, 0);
+    grapes_config_value_int_default(tags, "input_prechunked", &prechunked, 0);
+    grapes_config_value_int_default(tags, "input_seek", &seek, 0);
+    free(tags);
+  }
+  if (prechunked) {
+    res->map = input_map_open(fname);
+    if (res->map) {
+      res->cf = chunk_file_open(res->map->base, res->map->len);
+    }
+    if (res->cf == NULL || chunk_file_seek(res->cf, chunk_file_first_timestamp(res->cf) + seek * 1000ULL) < 0) {
+      fprintf(stderr, "Invalid chunk container %s, or input_seek beyond its end\n", fname);
+      chunk_file_close(&res->cf);
+      input_map_unref(&res->map);
+    } else {
+      res->interframe = chunk_file_interval(res->cf) > 0 ? chunk_file_interval(res->cf) : DEFAULT_MAP_CHUNK_INTERVAL;
+    }
+  } else if (mmap_mode) {
+    if (res->chunk_size <= 0 || res->interframe <= 0) {
+      fprintf(stderr, "Invalid input_chunk_size or input_chunk_interval\n");
+    } else {
+      res->map = input_map_open(fname);
+    }
+  } else {
+    res->s = input_stream_open(fname, &res->interframe, config);
+  }
+  if (res->s == NULL && res->map == NULL) {
     free(res);
     res = NULL;
     return res;
@@ -79,18 +470,23 @@ struct input_desc *input_open(const char *fname, int *fds, int fds_size, const c
     if (fds_size >= 1) {
       fds[0] = -1; //This input module needs no fds to monitor
     }
-    gettimeofday(&tv, NULL);
+    mono_clock_precise(&tv);
     res->start_time = tv.tv_usec + tv.tv_sec * 1000000ULL;
     res->first_ts = 0;
     res->id = 0; //(res->start_time / res->interframe) % INT_MAX; //TODO: verify 32/64 bit
 
     if(INITIAL_ID == -1) {
-      res->id = (res->start_time / res->interframe) % INT_MAX; //TODO: verify 32/64 bit
+      gettimeofday(&tv, NULL);  // IDs keep growing across source restarts
+      res->id = ((tv.tv_usec + tv.tv_sec * 1000000ULL) / res->interframe) % INT_MAX; //TODO: verify 32/64 bit
     } else {
       res->id = INITIAL_ID;
     }
 
-    fprintf(stderr,"Initial Chunk Id %d\n", res->id);
+    if (res->cf) {
+      fprintf(stderr,"Serving %u pre-chunkised chunks\n", chunk_file_chunks(res->cf));
+    } else {
+      fprintf(stderr,"Initial Chunk Id %d\n", res->id);
+    }
   }
 
   return res;
@@ -98,31 +494,76 @@ struct input_desc *input_open(const char *fname, int *fds, int fds_size, const c
 
 void input_close(struct input_desc *s)
 {
-  input_stream_close(s->s);
+  if (s->multi) {
+    input_multi_close(s->multi);
+  }
+  if (s->s) {
+    input_stream_close(s->s);
+  }
+  chunk_file_close(&s->cf);
+  input_map_unref(&s->map);
   free(s);
 }
 
-int input_get(struct input_desc *s, struct chunk *c)
+int input_next(struct input_desc *s, struct chunk *c)
 {
-  struct timeval now;
-  int64_t delta;
   int res;
 
+  if (s->multi) {
+    fprintf(stderr, "Tracks are chunkised in their own threads, read them with input_chunk\n");
+    return -1;
+  }
   c->attributes_size = 0;
   c->attributes = NULL;
 
   c->id = s->id;
-  res = chunkise(s->s, c);
-  if (res < 0) {
-    return -1;
+  if (s->cf) {
+    res = input_file_chunkise(s, c);
+  } else if (s->map) {
+    res = input_map_chunkise(s, c);
+  } else {
+    res = chunkise(s->s, c);
   }
   if (res > 0) {
     s->id++;
   }
-  if (s->first_ts == 0) {
+  return res;
+}
+
+uint64_t input_deadline(const struct input_desc *s)
+{
+  return s->interframe && !s->multi ? s->deadline : 0;
+}
+
+void input_next_release(struct input_desc *s, struct chunk *c)
+{
+  if (s->map == NULL) {  // otherwise they are slices of the mapping
+    free(c->data);
+    free(c->attributes);
+  }
+  c->data = NULL;
+  c->attributes = NULL;
+}
+
+int input_get(struct input_desc *s, struct chunk *c)
+{
+  struct timeval now;
+  int64_t delta;
+  int res;
+
+  res = input_next(s, c);
+  if (res < -1 || (res < 0 && s->map == NULL)) {
+    return -1;
+  }
+  mono_clock_precise(&now);
+  if (res < 0) {  // end of the mapped file, the source idles
+    s->deadline = now.tv_sec * 1000000ULL + now.tv_usec + s->interframe;
+    return s->interframe;
+  }
+  if (!s->first_ts_set && res > 0) {
     s->first_ts = c->timestamp;
+    s->first_ts_set = 1;
   }
-  gettimeofday(&now, NULL);
   if (s->interframe) {
     delta = c->timestamp - s->first_ts + s->interframe;
 //		fprintf(stderr,"delta  (%llu) = c->timestamp (%llu) - s->first_ts  (%llu) + s->interframe (%llu) \n",delta,c->timestamp,s->first_ts,s->interframe);
@@ -130,15 +571,20 @@ int input_get(struct input_desc *s, struct chunk *c)
 //    fprintf(stderr,"delta  (%llu)= delta + s->start_time  (%llu)- now.tv_sec * 1000000ULL  (%lu)- now.tv_usec (%lu)\n",delta,s->start_time,now.tv_sec,now.tv_usec);
     dprintf("Delta: %ld\n", delta);
     dprintf("Generate Chunk[%d] (TS: %lu)\n", c->id, c->timestamp);
+    if (delta < -MAX_LATENESS) {  // after a stall, resynchronise instead of bursting
+      s->start_time -= delta;
+    }
     if (delta < 0) {
       delta = 0;
     }
+    s->deadline = now.tv_sec * 1000000ULL + now.tv_usec + delta;
   } else {
     delta = DEFAULT_DATA_INTERVAL;
   }
 //			if (c->data)
 //				fprintf(stderr,"chunk size: %d  ",c->size);
 
+  gettimeofday(&now, NULL);  // chunk timestamps are compared across peers
   c->timestamp = now.tv_sec * 1000000ULL + now.tv_usec;
 
   return delta;
@@ -146,14 +592,22 @@ int input_get(struct input_desc *s, struct chunk *c)
 
 struct chunk *input_chunk(struct input_desc * s, suseconds_t *delta)
 {
+  struct input_chunk *ic;
   struct chunk *c;
+  void *attr;
 
-  c = malloc(sizeof(struct chunk));
-  if (!c) {
+  if (s->multi) {
+    *delta = DEFAULT_DATA_INTERVAL;
+    ic = input_multi_chunk(s);
+    return ic ? &ic->c : NULL;
+  }
+  ic = malloc(sizeof(struct input_chunk));
+  if (!ic) {
     fprintf(stderr, "Memory allocation error!\n");
     return NULL;
   }
-  memset(c, 0, sizeof(struct chunk));
+  memset(ic, 0, sizeof(struct input_chunk));
+  c = &ic->c;
 
   *delta = (suseconds_t)input_get(s, c);
   if (*delta < 0) {
@@ -161,10 +615,36 @@ struct chunk *input_chunk(struct input_desc * s, suseconds_t *delta)
     exit(-1);
   }
   if (c->data == NULL) {
-    free(c);
+    free(ic);
     return NULL;
   }
+  if (s->map) {
+    ic->map = input_map_ref(s->map);
+  }
   dprintf("Generated chunk %d of %d bytes\n",c->id, c->size);
-  chunk_attributes_init(c);
+  if (c->attributes) {  // recorded in a pre-chunkised container, which is read-only
+    attr = malloc(c->attributes_size);
+    memcpy(attr, c->attributes, c->attributes_size);
+    c->attributes = attr;
+  } else {
+    chunk_attributes_init(c);
+  }
   return c;
 }
+
+void input_chunk_release(struct chunk **c)
+{
+  struct input_chunk *ic;
+
+  if (c && *c) {
+    ic = (struct input_chunk *)*c;  // c is the first member
+    chunk_attributes_deinit(*c);
+    if (ic->map) {
+      input_map_unref(&ic->map);
+    } else {
+      free((*c)->data);
+    }
+    free(ic);
+    *c = NULL;
+  }
+}
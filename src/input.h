@@ -40,12 +40,35 @@ struct input_context {
 struct input_desc *input_open(const char *fname, int *fds, int fds_size, const char * config);
 void input_close(struct input_desc *s);
 
+/*
+ * Reads the next chunk with its media timestamp, without any pacing.
+ * Returns: 1 if c has been filled, 0 if no chunk is available yet, -1 at the end of the input, <-1 on error
+ */
+int input_next(struct input_desc *s, struct chunk *c);
+
+/* releases the payload and attributes of a chunk filled by input_next */
+void input_next_release(struct input_desc *s, struct chunk *c);
+
 /*
  * c: chunk structure to be filled. If c->data = NULL after call, there is no new chunk
  * Returns: timeout requested till next call to the function, <0 in case of input error, INT_MAX if no timeout is requested
  */
 int input_get(struct input_desc *s, struct chunk *c);
 
+/*
+ * Returns a new chunk, to be released with input_chunk_release. With
+ * input_mmap=1 the payload is a slice of the file mapping, which stays
+ * valid until the chunk is released, even after input_close
+ */
 struct chunk *input_chunk(struct input_desc * s, suseconds_t *delta);
 
+/*
+ * Returns: the deadline of the next chunk of a paced input, in microseconds
+ * of the precise monotonic clock, following the media timestamps; 0 if it
+ * is due now or for fd driven inputs
+ */
+uint64_t input_deadline(const struct input_desc *s);
+
+void input_chunk_release(struct chunk **c);
+
 #endif	/* INPUT_H */
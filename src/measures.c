@@ -20,8 +20,12 @@
 
 #include<measures.h>
 #include<string.h>
+#include<histogram.h>
+#include<mono_clock.h>
+#include<chunk_attributes.h>
 
 #define DEFAULT_CHUNK_INTERVAL (1000000/25)
+#define NODE_DELAY_WEIGHT 0.125
 
 enum data_state {deinit, loading, ready};
 
@@ -33,11 +37,113 @@ struct chunk_interval_estimate {
 	enum data_state state;
 };
 
+/* per second totals of the last MEASURES_WINDOW seconds */
+struct window {
+	uint64_t slots[MEASURES_WINDOW];
+	uint64_t second;  // of the newest slot
+};
+
+/* per second delay histograms of the last MEASURES_WINDOW seconds */
+struct delay_window {
+	struct histogram slots[MEASURES_WINDOW];
+	uint64_t second;  // of the newest slot
+};
+
+struct node_measures {
+	struct nodeID * id;
+	uint64_t last_seen;
+	uint64_t chunks_received;
+	uint64_t chunks_sent;
+	uint64_t duplicates;
+	uint64_t accepted;
+	double delay;
+	struct window down;
+	struct window up;
+};
+
 struct measures {
 	char * filename;
 	struct chunk_interval_estimate cie;
+	uint64_t chunks;
+	uint64_t duplicates;
+	uint64_t lost;
+	int latest_id;
+	struct window expected;
+	struct window received;
+	struct window down;
+	struct window up;
+	struct window signalling;
+	struct delay_window delay;
+	uint64_t hops[MEASURES_MAX_HOPS];
+	struct node_measures nodes[MEASURES_MAX_NODES];
+	int nodes_len;
 };
 
+void window_advance(struct window * w, uint64_t second)
+{
+	uint64_t s;
+
+	for (s = w->second + 1; s <= second && s <= w->second + MEASURES_WINDOW; s++)
+		w->slots[s % MEASURES_WINDOW] = 0;
+	if (second > w->second)
+		w->second = second;
+}
+
+void window_add(struct window * w, uint64_t v, uint64_t second)
+{
+	window_advance(w, second);
+	w->slots[second % MEASURES_WINDOW] += v;
+}
+
+uint64_t window_sum(const struct window * w, uint64_t second)
+	/* the slots which are not older than the window */
+{
+	uint64_t sum = 0, s;
+
+	for (s = w->second; s + MEASURES_WINDOW > second && s + MEASURES_WINDOW > w->second; s--)
+	{
+		sum += w->slots[s % MEASURES_WINDOW];
+		if (s == 0)
+			break;
+	}
+	return sum;
+}
+
+double window_bitrate(const struct window * w, uint64_t second)
+{
+	return window_sum(w, second) * 8.0 / MEASURES_WINDOW;
+}
+
+void delay_window_add(struct delay_window * w, uint64_t v, uint64_t second)
+{
+	uint64_t s;
+
+	for (s = w->second + 1; s <= second && s <= w->second + MEASURES_WINDOW; s++)
+		histogram_reset(&w->slots[s % MEASURES_WINDOW]);
+	if (second > w->second)
+		w->second = second;
+	histogram_add(&w->slots[second % MEASURES_WINDOW], v);
+}
+
+void delay_window_merge(const struct delay_window * w, uint64_t second, struct histogram * h)
+	/* as window_sum */
+{
+	uint64_t s;
+
+	histogram_reset(h);
+	for (s = w->second; s + MEASURES_WINDOW > second && s + MEASURES_WINDOW > w->second; s--)
+	{
+		histogram_merge(h, &w->slots[s % MEASURES_WINDOW]);
+		if (s == 0)
+			break;
+	}
+}
+
+uint64_t measures_second(void)
+{
+	return mono_clock_us() / 1000000;
+}
+
 void chunk_interval_estimate_init(struct chunk_interval_estimate * cie)
 {
 	cie->state = deinit;
@@ -47,20 +153,71 @@ struct measures * measures_create(const char * filename)
 {
 	struct measures * m;
 	m = malloc(sizeof(struct measures));
+	memset(m, 0, sizeof(struct measures));
+	m->filename = filename ? strdup(filename) : NULL;
+	m->latest_id = -1;
 	chunk_interval_estimate_init(&(m->cie));
 	return m;
 }
 
 void measures_destroy(struct measures ** m)
 {
+	int i;
+
 	if (m && *m)
 	{
+		for (i = 0; i < (*m)->nodes_len; i++)
+			nodeid_free((*m)->nodes[i].id);
+		free((*m)->filename);
 		free((*m));
+		*m = NULL;
+	}
+}
+
+struct node_measures * measures_node(struct measures * m, const struct nodeID * id)
+	/* finds or adds the node, replacing the least recently seen one */
+{
+	struct node_measures * n = NULL;
+	int i;
+
+	for (i = 0; i < m->nodes_len && n == NULL; i++)
+		if (nodeid_equal(m->nodes[i].id, id))
+			n = &m->nodes[i];
+	if (n == NULL)
+	{
+		if (m->nodes_len < MEASURES_MAX_NODES)
+			n = &m->nodes[m->nodes_len++];
+		else {
+			n = &m->nodes[0];
+			for (i = 1; i < m->nodes_len; i++)
+				if (m->nodes[i].last_seen < n->last_seen)
+					n = &m->nodes[i];
+			nodeid_free(n->id);
+		}
+		memset(n, 0, sizeof(struct node_measures));
+		n->id = nodeid_dup(id);
+	}
+	n->last_seen = mono_clock_us();
+	return n;
+}
+
+int8_t measures_add_node(struct measures * m, struct nodeID * id)
+{
+	if (m && id)
+	{
+		measures_node(m, id);
+		return 0;
 	}
+	return -1;
 }
 
 int8_t reg_chunk_receive(struct measures * m, struct chunk *c) 
 { 
+	struct timeval now;
+	uint64_t second;
+	int64_t delay;
+	uint16_t hops;
+
 	if (m && c)  // chunk interval estimation
 	{
 		switch (m->cie.state) {
@@ -71,23 +228,182 @@ int8_t reg_chunk_receive(struct measures * m, struct chunk *c)
 				m->cie.state = loading;
 				break;
 			case loading:
-				break;
 			case ready:
-				if (c->id > (int64_t)m->cie.last_index)
+				if (c->id > (int64_t)m->cie.last_index && c->timestamp > m->cie.first_timestamp)
 				{
 					m->cie.chunk_interval = ((c->timestamp - m->cie.first_timestamp))/(c->id - m->cie.first_index);
 					m->cie.last_index = c->id;
+					m->cie.state = ready;
 				}
-				m->cie.state = ready;
 				break;
 		}
 	}
+	if (m && c)  // loss, delay and hop count
+	{
+		second = measures_second();
+		m->chunks++;
+		window_add(&m->received, 1, second);
+		if (c->id > m->latest_id)
+		{
+			if (m->latest_id >= 0)
+			{
+				m->lost += c->id - m->latest_id - 1;
+				window_add(&m->expected, c->id - m->latest_id, second);
+			} else
+				window_add(&m->expected, 1, second);
+			m->latest_id = c->id;
+		} else if (m->lost)
+			m->lost--;  // late, not lost
+
+		gettimeofday(&now, NULL);  // chunk timestamps are wall clock ones
+		delay = now.tv_sec * 1000000LL + now.tv_usec - (int64_t) c->timestamp;
+		delay_window_add(&m->delay, delay > 0 ? delay : 0, second);
+
+		hops = chunk_attributes_get_hopcount(c);
+		m->hops[hops < MEASURES_MAX_HOPS ? hops : MEASURES_MAX_HOPS - 1]++;
+	}
 	return 0;
 }
 
+int8_t reg_chunk_download(struct measures * m, const struct nodeID * from, const struct chunk * c, int8_t duplicate)
+{
+	struct node_measures * n;
+	struct timeval now;
+	uint64_t second;
+	int64_t delay;
+
+	if (m && from && c)
+	{
+		second = measures_second();
+		n = measures_node(m, from);
+		n->chunks_received++;
+		window_add(&n->down, c->size, second);
+		window_add(&m->down, c->size, second);
+		if (duplicate)
+		{
+			n->duplicates++;
+			m->duplicates++;
+		}
+		gettimeofday(&now, NULL);
+		delay = now.tv_sec * 1000000LL + now.tv_usec - (int64_t) c->timestamp;
+		n->delay += ((delay > 0 ? delay : 0) - n->delay) * (n->chunks_received > 1 ? NODE_DELAY_WEIGHT : 1);
+		return 0;
+	}
+	return -1;
+}
+
+int8_t reg_chunk_upload(struct measures * m, const struct nodeID * to, const struct chunk * c)
+{
+	struct node_measures * n;
+	uint64_t second;
+
+	if (m && to && c)
+	{
+		second = measures_second();
+		n = measures_node(m, to);
+		n->chunks_sent++;
+		window_add(&n->up, c->size, second);
+		window_add(&m->up, c->size, second);
+		return 0;
+	}
+	return -1;
+}
+
+int8_t reg_chunk_accept(struct measures * m, const struct nodeID * from, int chunks)
+{
+	if (m && from && chunks > 0)
+	{
+		measures_node(m, from)->accepted += chunks;
+		return 0;
+	}
+	return -1;
+}
+
+int8_t reg_signalling_receive(struct measures * m, int bytes)
+{
+	if (m && bytes > 0)
+	{
+		window_add(&m->signalling, bytes, measures_second());
+		return 0;
+	}
+	return -1;
+}
+
 suseconds_t chunk_interval_measure(const struct measures *m)
 {
-	if (m->cie.state == ready)
+	if (m && m->cie.state == ready && m->cie.chunk_interval > 0)
 		return m->cie.chunk_interval;
 	return DEFAULT_CHUNK_INTERVAL;
 }
+
+int8_t measures_summary(const struct measures * m, struct measures_summary * s)
+{
+	uint64_t second, expected, signalling, hops = 0, hop_sum = 0;
+	struct histogram delay;
+	int i;
+
+	if (m == NULL || s == NULL)
+		return -1;
+	second = measures_second();
+	memset(s, 0, sizeof(struct measures_summary));
+	s->chunks = m->chunks;
+	s->duplicates = m->duplicates;
+	s->lost = m->lost;
+	expected = window_sum(&m->expected, second);
+	if (expected)
+		s->loss = 1.0 - (double) window_sum(&m->received, second) / expected;
+	if (s->loss < 0)
+		s->loss = 0;
+	delay_window_merge(&m->delay, second, &delay);
+	s->delay_p50 = histogram_percentile(&delay, 50);
+	s->delay_p95 = histogram_percentile(&delay, 95);
+	s->delay_p99 = histogram_percentile(&delay, 99);
+	s->delay_max = delay.max;
+	for (i = 0; i < MEASURES_MAX_HOPS; i++)
+	{
+		hops += m->hops[i];
+		hop_sum += m->hops[i] * i;
+	}
+	s->hopcount_mean = hops ? (double) hop_sum / hops : 0;
+	s->download_bps = window_bitrate(&m->down, second);
+	s->upload_bps = window_bitrate(&m->up, second);
+	s->signalling_bps = window_bitrate(&m->signalling, second);
+	signalling = window_sum(&m->signalling, second);
+	if (signalling)
+		s->signalling_overhead = (double) signalling / (signalling + window_sum(&m->down, second));
+	return 0;
+}
+
+int measures_nodes(const struct measures * m, struct measures_node * nodes, int len)
+{
+	const struct node_measures * n;
+	uint64_t second;
+	int i;
+
+	if (m == NULL || nodes == NULL)
+		return 0;
+	second = measures_second();
+	for (i = 0; i < m->nodes_len && i < len; i++)
+	{
+		n = &m->nodes[i];
+		nodes[i].id = n->id;
+		nodes[i].chunks_received = n->chunks_received;
+		nodes[i].chunks_sent = n->chunks_sent;
+		nodes[i].duplicates = n->duplicates;
+		nodes[i].accepted = n->accepted;
+		nodes[i].loss = n->accepted > n->chunks_received ? 1.0 - (double) n->chunks_received / n->accepted : 0;
+		nodes[i].delay_mean = n->delay;
+		nodes[i].download_bps = window_bitrate(&n->down, second);
+		nodes[i].upload_bps = window_bitrate(&n->up, second);
+	}
+	return i;
+}
+
+int measures_hopcounts(const struct measures * m, uint64_t * counts, int len)
+{
+	int i;
+
+	for (i = 0; m && counts && i < len && i < MEASURES_MAX_HOPS; i++)
+		counts[i] = m->hops[i];
+	return i;
+}
@@ -28,17 +28,71 @@
 #include<psinstance.h>
 #include<chunk.h>
 
+#define MEASURES_WINDOW 10  // seconds covered by the sliding windows
+#define MEASURES_MAX_NODES 64  // least recently active neighbours are forgotten
+#define MEASURES_MAX_HOPS 32
+
 struct measures;
 
+/* global figures; rates, loss ratio and delays refer to the last MEASURES_WINDOW
+ * seconds, counters to the whole lifetime */
+struct measures_summary {
+	uint64_t chunks;  // unique chunks received
+	uint64_t duplicates;
+	uint64_t lost;  // chunk IDs skipped
+	double loss;
+	uint64_t delay_p50;  // end to end, microseconds
+	uint64_t delay_p95;
+	uint64_t delay_p99;
+	uint64_t delay_max;
+	double hopcount_mean;
+	double download_bps;  // chunk messages
+	double upload_bps;
+	double signalling_bps;  // every other received message
+	double signalling_overhead;  // fraction of the received bytes
+};
+
+struct measures_node {
+	const struct nodeID * id;  // valid until the node is forgotten
+	uint64_t chunks_received;
+	uint64_t chunks_sent;
+	uint64_t duplicates;
+	uint64_t accepted;
+	double loss;  // accepted chunks which never came
+	double delay_mean;  // end to end, microseconds, moving average
+	double download_bps;
+	double upload_bps;
+};
+
 struct measures * measures_create(const char * filename);
 int8_t measures_add_node(struct measures * m, struct nodeID * id);
 void measures_destroy(struct measures ** m);
 
 /*************Storing functions***************/
 
+/* a new chunk entered the trading buffer */
 int8_t reg_chunk_receive(struct measures * m, struct chunk *c);
 
+/* a chunk message arrived from a neighbour */
+int8_t reg_chunk_download(struct measures * m, const struct nodeID * from, const struct chunk * c, int8_t duplicate);
+
+int8_t reg_chunk_upload(struct measures * m, const struct nodeID * to, const struct chunk * c);
+
+/* chunks accepted from an offer of from */
+int8_t reg_chunk_accept(struct measures * m, const struct nodeID * from, int chunks);
+
+int8_t reg_signalling_receive(struct measures * m, int bytes);
+
 /*************Get functions***************/
 suseconds_t chunk_interval_measure(const struct measures * m);
 
+int8_t measures_summary(const struct measures * m, struct measures_summary * s);
+
+/* fills at most len nodes, returns their number */
+int measures_nodes(const struct measures * m, struct measures_node * nodes, int len);
+
+/* chunks received per hop count, the last entry counts the longer paths
+ * too; returns the filled entries */
+int measures_hopcounts(const struct measures * m, uint64_t * counts, int len);
+
 #endif
@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<stdlib.h>
+#include<stdio.h>
+#include<string.h>
+#include<stdarg.h>
+#include<unistd.h>
+#include<errno.h>
+#include<poll.h>
+#include<pthread.h>
+#include<sys/socket.h>
+#include<sys/stat.h>
+#include<sys/un.h>
+#include<metrics_server.h>
+
+#define METRICS_CLIENT_TIMEOUT 1  // seconds a slow client is waited for
+
+struct metrics_server {
+	char * path;
+	char * control_path;
+	int fd;
+	int control_fd;  // -1 without a command handler
+	int wake[2];  // pipe telling the thread to stop
+	metrics_command_f command;
+	void * command_arg;
+	pthread_mutex_t lock;  // snapshot and scrapes
+	char * snapshot;
+	size_t snapshot_len;
+	uint64_t scrapes;
+	pthread_t thread;
+};
+
+void metrics_server_send(int fd, const char * text, size_t len)
+{
+	size_t sent = 0;
+	ssize_t res;
+
+	while (sent < len)
+	{
+		res = send(fd, text + sent, len - sent, MSG_NOSIGNAL);
+		if (res > 0)
+			sent += res;
+		else if (res < 0 && errno == EINTR)
+			continue;
+		else
+			break;
+	}
+}
+
+void metrics_server_answer(struct metrics_server * ms, int fd)
+	/* plain scrapes are answered at once, nothing is read */
+{
+	char * text = NULL;
+	size_t len;
+
+	pthread_mutex_lock(&ms->lock);
+	len = ms->snapshot_len;
+	if (len)
+	{
+		text = malloc(len);
+		memcpy(text, ms->snapshot, len);
+	}
+	ms->scrapes++;
+	pthread_mutex_unlock(&ms->lock);
+
+	metrics_server_send(fd, text, len);
+	free(text);
+}
+
+void metrics_server_control(struct metrics_server * ms, int fd)
+	/* reads a command line and sends back the handler answer */
+{
+	char cmd[METRICS_COMMAND_SIZE], reply[METRICS_COMMAND_SIZE];
+	ssize_t n;
+	int len;
+
+	n = recv(fd, cmd, METRICS_COMMAND_SIZE - 1, 0);
+	if (n >= 0)
+	{
+		while (n > 0 && (cmd[n - 1] == '\n' || cmd[n - 1] == '\r'))
+			n--;
+		cmd[n] = '\0';
+		len = ms->command(ms->command_arg, cmd, reply, METRICS_COMMAND_SIZE);
+		if (len < 0)
+			len = 0;
+		if (len >= METRICS_COMMAND_SIZE)
+			len = METRICS_COMMAND_SIZE - 1;
+		metrics_server_send(fd, reply, len);
+	}
+}
+
+void metrics_server_serve(struct metrics_server * ms, int lfd)
+{
+	struct timeval timeout;
+	int fd;
+
+	timeout.tv_sec = METRICS_CLIENT_TIMEOUT;
+	timeout.tv_usec = 0;
+	while ((fd = accept(lfd, NULL, NULL)) >= 0)
+	{
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(struct timeval));
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(struct timeval));
+		if (lfd == ms->fd)
+			metrics_server_answer(ms, fd);
+		else
+			metrics_server_control(ms, fd);
+		close(fd);
+	}
+}
+
+void * metrics_server_loop(void * arg)
+{
+	struct metrics_server * ms = arg;
+	struct pollfd pfds[3];
+
+	pfds[0].fd = ms->wake[0];
+	pfds[0].events = POLLIN;
+	pfds[1].fd = ms->fd;
+	pfds[1].events = POLLIN;
+	pfds[2].fd = ms->control_fd;  // ignored by poll if negative
+	pfds[2].events = POLLIN;
+	while (poll(pfds, 3, -1) >= 0 || errno == EINTR)
+	{
+		if (pfds[0].revents)
+			break;
+		if (pfds[1].revents & POLLIN)
+			metrics_server_serve(ms, ms->fd);
+		if (pfds[2].revents & POLLIN)
+			metrics_server_serve(ms, ms->control_fd);
+	}
+	return NULL;
+}
+
+int metrics_server_listen(const char * path)
+	/* binds a socket file readable and writable by its owner only */
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	if (lstat(path, &st) == 0)
+	{
+		if (!S_ISSOCK(st.st_mode))
+		{
+			fprintf(stderr, "[ERROR] %s exists and is not a socket\n", path);
+			return -1;
+		}
+		unlink(path);  // stale socket of a previous run
+	}
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(struct sockaddr_un));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(struct sockaddr_un)))
+	{
+		fprintf(stderr, "[ERROR] cannot bind the metrics socket %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	/* permissions are set before listening, nobody can connect in between */
+	if (chmod(path, S_IRUSR | S_IWUSR) || listen(fd, 8))
+	{
+		fprintf(stderr, "[ERROR] cannot listen on the metrics socket %s: %s\n", path, strerror(errno));
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+	return fd;
+}
+
+void metrics_server_close(struct metrics_server * ms)
+	/* releases all but the thread */
+{
+	if (ms->wake[0] >= 0)
+	{
+		close(ms->wake[0]);
+		close(ms->wake[1]);
+	}
+	if (ms->fd >= 0)
+	{
+		close(ms->fd);
+		unlink(ms->path);
+	}
+	if (ms->control_fd >= 0)
+	{
+		close(ms->control_fd);
+		unlink(ms->control_path);
+	}
+	pthread_mutex_destroy(&ms->lock);
+	free(ms->snapshot);
+	free(ms->control_path);
+	free(ms->path);
+	free(ms);
+}
+
+struct metrics_server * metrics_server_create(const char * path, metrics_command_f command, void * arg)
+{
+	struct metrics_server * ms = NULL;
+
+	if (path == NULL)
+		return NULL;
+
+	ms = malloc(sizeof(struct metrics_server));
+	memset(ms, 0, sizeof(struct metrics_server));
+	ms->path = strdup(path);
+	ms->command = command;
+	ms->command_arg = arg;
+	pthread_mutex_init(&ms->lock, NULL);
+	ms->wake[0] = ms->wake[1] = -1;
+	ms->control_fd = -1;
+	ms->fd = metrics_server_listen(path);
+	if (ms->fd >= 0 && command)
+	{
+		ms->control_path = malloc(strlen(path) + strlen(METRICS_CONTROL_SUFFIX) + 1);
+		sprintf(ms->control_path, "%s%s", path, METRICS_CONTROL_SUFFIX);
+		ms->control_fd = metrics_server_listen(ms->control_path);
+	}
+	if (ms->fd < 0 || (command && ms->control_fd < 0))
+	{
+		metrics_server_close(ms);
+		return NULL;
+	}
+
+	if (pipe(ms->wake))
+		ms->wake[0] = ms->wake[1] = -1;
+	if (ms->wake[0] < 0 || pthread_create(&ms->thread, NULL, metrics_server_loop, ms))
+	{
+		fprintf(stderr, "[ERROR] cannot start the metrics server thread\n");
+		metrics_server_close(ms);
+		ms = NULL;
+	}
+	return ms;
+}
+
+void metrics_server_destroy(struct metrics_server ** ms)
+{
+	if (ms && *ms)
+	{
+		close((*ms)->wake[1]);  // the read end polls as hung up
+		(*ms)->wake[1] = -1;
+		pthread_join((*ms)->thread, NULL);
+		close((*ms)->wake[0]);
+		(*ms)->wake[0] = -1;
+		metrics_server_close(*ms);
+		*ms = NULL;
+	}
+}
+
+int8_t metrics_server_publish(struct metrics_server * ms, const struct metrics_text * text)
+{
+	char * snapshot;
+
+	if (ms == NULL || text == NULL)
+		return -1;
+	snapshot = malloc(text->len + 1);
+	memcpy(snapshot, text->buf, text->len);
+
+	pthread_mutex_lock(&ms->lock);
+	free(ms->snapshot);
+	ms->snapshot = snapshot;
+	ms->snapshot_len = text->len;
+	pthread_mutex_unlock(&ms->lock);
+	return 0;
+}
+
+uint64_t metrics_server_scrapes(const struct metrics_server * ms)
+{
+	uint64_t scrapes = 0;
+
+	if (ms)
+	{
+		pthread_mutex_lock((pthread_mutex_t *) &ms->lock);
+		scrapes = ms->scrapes;
+		pthread_mutex_unlock((pthread_mutex_t *) &ms->lock);
+	}
+	return scrapes;
+}
+
+void metrics_text_reset(struct metrics_text * t)
+{
+	t->len = 0;
+	if (t->buf)
+		t->buf[0] = '\0';
+}
+
+void metrics_text_deinit(struct metrics_text * t)
+{
+	free(t->buf);
+	memset(t, 0, sizeof(struct metrics_text));
+}
+
+void metrics_text_printf(struct metrics_text * t, const char * fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(t->buf ? t->buf + t->len : NULL, t->size - t->len, fmt, ap);
+	va_end(ap);
+	if (n >= 0 && t->len + n >= t->size)
+	{
+		t->size = (t->len + n + 1) * 2;
+		t->buf = realloc(t->buf, t->size);
+		va_start(ap, fmt);
+		n = vsnprintf(t->buf + t->len, t->size - t->len, fmt, ap);
+		va_end(ap);
+	}
+	if (n > 0)
+		t->len += n;
+}
+
+void metrics_text_family(struct metrics_text * t, const char * name, const char * type, const char * help)
+{
+	metrics_text_printf(t, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_text_sample(struct metrics_text * t, const char * name, const char * labels, double value)
+{
+	if (labels)
+		metrics_text_printf(t, "%s{%s} %.17g\n", name, labels, value);
+	else
+		metrics_text_printf(t, "%s %.17g\n", name, value);
+}
+
+void metrics_text_metric(struct metrics_text * t, const char * name, const char * type, const char * help, double value)
+{
+	metrics_text_family(t, name, type, help);
+	metrics_text_sample(t, name, NULL, value);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __METRICS_SERVER_H__
+#define __METRICS_SERVER_H__
+
+#include<stdint.h>
+#include<stddef.h>
+
+/* Serves the latest snapshot of the node metrics, in the Prometheus text
+ * exposition format, to whoever connects to a local Unix domain socket
+ * (e.g., `socat -u UNIX-CONNECT:<path> -`). Connections are accepted and
+ * answered by a dedicated thread: the streaming loop only builds a
+ * snapshot now and then and publishes it.
+ * With a command handler, a second socket at the same path plus
+ * METRICS_CONTROL_SUFFIX is the control channel: a client writes a command
+ * line and reads back the answer of the handler. Keeping the two apart
+ * lets plain scrapes be answered at once, without reading anything.
+ * Both socket files are accessible to their owner only. */
+
+#define DEFAULT_METRICS_PERIOD 1000  // milliseconds between two snapshots
+#define METRICS_COMMAND_SIZE 256
+#define METRICS_CONTROL_SUFFIX ".ctl"
+
+/* runs in the server thread, writes at most len bytes of answer in reply */
+typedef int (*metrics_command_f)(void * arg, const char * command, char * reply, int len);
+
+struct metrics_server;
+
+/* growing text buffer the snapshots are built in */
+struct metrics_text {
+	char * buf;
+	size_t len;
+	size_t size;
+};
+
+/* binds path, and the control socket if command is not NULL, replacing
+ * stale socket files but nothing else. NULL on error */
+struct metrics_server * metrics_server_create(const char * path, metrics_command_f command, void * arg);
+
+/* stops the thread and removes the socket files */
+void metrics_server_destroy(struct metrics_server ** ms);
+
+/* text is copied, the previous snapshot is served until then */
+int8_t metrics_server_publish(struct metrics_server * ms, const struct metrics_text * text);
+
+uint64_t metrics_server_scrapes(const struct metrics_server * ms);
+
+void metrics_text_reset(struct metrics_text * t);
+
+void metrics_text_deinit(struct metrics_text * t);
+
+void metrics_text_printf(struct metrics_text * t, const char * fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/* # HELP and # TYPE lines of a metric family */
+void metrics_text_family(struct metrics_text * t, const char * name, const char * type, const char * help);
+
+/* labels is the content of the braces, NULL for none */
+void metrics_text_sample(struct metrics_text * t, const char * name, const char * labels, double value);
+
+/* family with a single sample */
+void metrics_text_metric(struct metrics_text * t, const char * name, const char * type, const char * help, double value);
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<offer_controller.h>
+#include<grapes_config.h>
+#include<dbg.h>
+
+#define MIN_RATE 0.25
+#define MAX_RATE 4.0
+#define RATE_INCREASE 0.1
+#define RATE_DECREASE 0.5
+#define HIGH_ACCEPT_RATIO 0.8
+#define LOW_ACCEPT_RATIO 0.3
+
+struct offer_controller {
+	double rate;
+	int chunks_per_offer;
+	int min_chunks_per_offer;
+	int max_chunks_per_offer;
+	size_t outqueue_threshold;
+
+	uint32_t offers;
+	uint32_t accepts;
+	uint32_t accepted_chunks;
+	uint32_t timeouts;
+};
+
+struct offer_controller * offer_controller_create(int chunks_per_offer, const char * config)
+{
+	struct offer_controller * oc;
+	struct tag * tags;
+	int threshold;
+
+	oc = malloc(sizeof(struct offer_controller));
+	oc->rate = 1;
+	oc->min_chunks_per_offer = chunks_per_offer > 0 ? chunks_per_offer : 1;
+	oc->chunks_per_offer = oc->min_chunks_per_offer;
+	oc->offers = 0;
+	oc->accepts = 0;
+	oc->accepted_chunks = 0;
+	oc->timeouts = 0;
+
+	tags = grapes_config_parse(config);
+	grapes_config_value_int_default(tags, "max_chunks_per_peer_offer", &(oc->max_chunks_per_offer), 4 * oc->min_chunks_per_offer);
+	grapes_config_value_int_default(tags, "outqueue_threshold", &threshold, DEFAULT_OUTQUEUE_THRESHOLD);
+	free(tags);
+
+	if (oc->max_chunks_per_offer < oc->min_chunks_per_offer)
+		oc->max_chunks_per_offer = oc->min_chunks_per_offer;
+	oc->outqueue_threshold = threshold > 0 ? threshold : DEFAULT_OUTQUEUE_THRESHOLD;
+	return oc;
+}
+
+void offer_controller_destroy(struct offer_controller ** oc)
+{
+	if (oc && *oc)
+	{
+		free(*oc);
+		*oc = NULL;
+	}
+}
+
+void offer_controller_reg_offer(struct offer_controller * oc)
+{
+	if (oc)
+		oc->offers++;
+}
+
+void offer_controller_reg_accept(struct offer_controller * oc, int accepted_chunks)
+{
+	if (oc && accepted_chunks > 0)
+	{
+		oc->accepts++;
+		oc->accepted_chunks += accepted_chunks;
+	}
+}
+
+void offer_controller_reg_timeouts(struct offer_controller * oc, uint16_t timeouts)
+{
+	if (oc)
+		oc->timeouts += timeouts;
+}
+
+void offer_controller_decrease(struct offer_controller * oc)
+{
+	oc->rate *= RATE_DECREASE;
+	if (oc->rate < MIN_RATE)
+		oc->rate = MIN_RATE;
+	if (oc->chunks_per_offer > oc->min_chunks_per_offer)
+		oc->chunks_per_offer--;
+}
+
+void offer_controller_increase(struct offer_controller * oc)
+{
+	oc->rate += RATE_INCREASE;
+	if (oc->rate > MAX_RATE)
+		oc->rate = MAX_RATE;
+	// peers take everything we offer, so we can offer them more at once
+	if (oc->accepted_chunks >= oc->accepts * oc->chunks_per_offer && oc->chunks_per_offer < oc->max_chunks_per_offer)
+		oc->chunks_per_offer++;
+}
+
+int8_t offer_controller_update(struct offer_controller * oc, size_t outqueue_len)
+{
+	double accept_ratio;
+
+	if (oc == NULL || oc->offers < OFFER_CONTROL_WINDOW)
+		return 0;
+
+	accept_ratio = ((double)oc->accepts) / oc->offers;
+	if (oc->timeouts > 0 || outqueue_len > oc->outqueue_threshold)
+		offer_controller_decrease(oc);  // we are saturated, back off
+	else if (accept_ratio >= HIGH_ACCEPT_RATIO && outqueue_len < oc->outqueue_threshold / 2)
+		offer_controller_increase(oc);
+	else if (accept_ratio < LOW_ACCEPT_RATIO && oc->rate > 1)
+		oc->rate = oc->rate - RATE_INCREASE < 1 ? 1 : oc->rate - RATE_INCREASE;  // offering more is useless
+
+	dprintf("[DEBUG] offer control: accept ratio %f, timeouts %u, outqueue %zu -> rate %f, chunks %d\n",
+			accept_ratio, oc->timeouts, outqueue_len, oc->rate, oc->chunks_per_offer);
+	oc->offers = 0;
+	oc->accepts = 0;
+	oc->accepted_chunks = 0;
+	oc->timeouts = 0;
+	return 1;
+}
+
+double offer_controller_rate(const struct offer_controller * oc)
+{
+	if (oc)
+		return oc->rate;
+	return 1;
+}
+
+int offer_controller_chunks_per_offer(const struct offer_controller * oc)
+{
+	if (oc)
+		return oc->chunks_per_offer;
+	return 1;
+}
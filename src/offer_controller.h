@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __OFFER_CONTROLLER_H__
+#define __OFFER_CONTROLLER_H__
+
+#include<stdint.h>
+#include<stdlib.h>
+
+/* Closed-loop (AIMD) controller of the offer rate and of the number of
+ * chunks offered per peer. Every OFFER_CONTROL_WINDOW offers it looks at
+ * the accept ratio, the expired transactions and the local outgoing queue:
+ * spare upload gives an additive increase, congestion a multiplicative
+ * decrease. */
+
+#define OFFER_CONTROL_WINDOW 10
+#define DEFAULT_OUTQUEUE_THRESHOLD 500  // fragments
+
+struct offer_controller;
+
+struct offer_controller * offer_controller_create(int chunks_per_offer, const char * config);
+
+void offer_controller_destroy(struct offer_controller ** oc);
+
+void offer_controller_reg_offer(struct offer_controller * oc);
+
+void offer_controller_reg_accept(struct offer_controller * oc, int accepted_chunks);
+
+void offer_controller_reg_timeouts(struct offer_controller * oc, uint16_t timeouts);
+
+/* re-evaluates rate and chunks per offer once a window of offers is complete
+ * returns 1 if the control variables have been updated, 0 otherwise */
+int8_t offer_controller_update(struct offer_controller * oc, size_t outqueue_len);
+
+double offer_controller_rate(const struct offer_controller * oc);
+
+int offer_controller_chunks_per_offer(const struct offer_controller * oc);
+
+#endif
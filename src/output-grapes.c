@@ -23,6 +23,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
 
 #include <chunk.h>
 #include <chunkiser.h>
@@ -30,46 +33,142 @@
 #include <measures.h>
 #include<grapes_config.h>
 
+#include<mono_clock.h>
+
 #include "output.h"
 #include "dbg.h"
 
+#define PLAYOUT_JITTER_FACTOR 4
+#define PLAYOUT_RESYNC 10000000  // microseconds
+#define PLAYOUT_TICK 5000  // microseconds
+#define OUTPUT_IOV_BATCH 64  // chunks per writev
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
 
 struct chunk_output {
-	struct chunk *buff;
+	struct shared_chunk **buff;  // references, payloads are shared with the trading buffer
+	struct shared_chunk **batch_refs;  // chunks being written together
+	const struct chunk **batch;
 	struct output_stream *out;
+	int raw_fd;  // raw payload sink, bypassing the GRAPES dechunkiser
+	struct output_writer *writer;  // NULL for synchronous writes
 	struct measures * measure;
 
 	uint16_t buff_length;
 	uint16_t head;
 	uint8_t  reorder;
 	int next_out;
+
+	/* jitter buffer, chunks are released at timestamp + base + delay */
+	suseconds_t playout_min;  // 0 disables the jitter buffer
+	suseconds_t playout_max;
+	int8_t adaptive_playout;
+	int8_t synced;
+	int64_t base;  // local time minus chunk timestamp, the lowest seen
+	int64_t last_transit;
+	struct output_playout_stats playout;
 };
 
-void chunk_clone(struct chunk * dst, const struct chunk* src)
+int output_slot_id(const struct chunk_output * outg, int pos)
+{
+	return outg->buff[pos] ? shared_chunk_get(outg->buff[pos])->id : -1;
+}
+
+void output_raw_write(int fd, const struct chunk ** chunks, int n)
+	/* writes the payloads back to back with as few system calls as possible */
+{
+	struct iovec iov[OUTPUT_IOV_BATCH];
+	struct iovec * v;
+	ssize_t w;
+	int i, m, k;
+
+	for (i = 0; i < n; i += m)
+	{
+		m = MIN(n - i, OUTPUT_IOV_BATCH);
+		for (k = 0; k < m; k++)
+		{
+			iov[k].iov_base = chunks[i + k]->data;
+			iov[k].iov_len = chunks[i + k]->size;
+		}
+		v = iov;
+		k = m;
+		while (k > 0)
+		{
+			w = writev(fd, v, k);
+			if (w < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				fprintf(stderr, "[ERROR] cannot write the output: %s\n", strerror(errno));
+				return;
+			}
+			while (k > 0 && (size_t) w >= v->iov_len)  // partial writes resume where they stopped
+			{
+				w -= v->iov_len;
+				v++;
+				k--;
+			}
+			if (k > 0)
+			{
+				v->iov_base = (uint8_t *) v->iov_base + w;
+				v->iov_len -= w;
+			}
+		}
+	}
+}
+
+void output_sink_write(void * arg, const struct chunk ** chunks, int n)
+{
+	struct chunk_output * outg = arg;
+	int i;
+
+	if (outg->raw_fd >= 0)
+		output_raw_write(outg->raw_fd, chunks, n);
+	else
+		for (i = 0; i < n; i++)
+			chunk_write(outg->out, chunks[i]);
+}
+
+void output_write_batch(struct chunk_output * outg, int n)
+	/* writes the first n batch chunks and releases their references */
 {
-	dst->id = src->id;
-	dst->size = src->size;
-	dst->data = malloc(dst->size);
-	memmove(dst->data, src->data, dst->size);
+	int i;
+
+	if (outg->writer)
+		for (i = 0; i < n; i++)
+			output_writer_push(outg->writer, outg->batch_refs[i] ? outg->batch_refs[i] : shared_chunk_create(NULL, outg->batch[i]));
+	else {
+		if (n)
+			output_sink_write(outg, outg->batch, n);
+		for (i = 0; i < n; i++)
+			shared_chunk_unref(&(outg->batch_refs[i]));
+	}
 }
 
-void chunk_deinit(struct chunk * c)
+void output_write(struct chunk_output * outg, const struct chunk * c, struct shared_chunk * sc)
+	/* sc, if not NULL, is a reference the function takes over */
 {
-	if (c->id >= 0)
-		free(c->data);
-	c->id = -1;
+	outg->batch[0] = c;
+	outg->batch_refs[0] = sc;
+	output_write_batch(outg, 1);
 }
 
 struct chunk_output * output_create(struct measures * ms, const char *config)
 {
 	struct chunk_output * outg = NULL;
 	struct tag * tags;
-	int i, len;
+	const char * overflow, * raw;
+	int i, len, thread, queue_size;
 
 	outg = malloc(sizeof(struct chunk_output));
 	outg->measure = ms;
 	outg->buff = NULL;
 	outg->out = NULL;
+	outg->raw_fd = -1;
+	outg->writer = NULL;
 	outg->next_out = -1;
 	outg->head = 0;
 
@@ -78,15 +177,40 @@ struct chunk_output * output_create(struct measures * ms, const char *config)
 	outg->buff_length = len > 0 ? len : 75;
 	grapes_config_value_int_default(tags, "outbuff_reorder", &len, 1);
 	outg->reorder = len ? 1 : 0;
-	free(tags);
+	grapes_config_value_int_default(tags, "output_thread", &thread, 0);
+	grapes_config_value_int_default(tags, "output_queue", &queue_size, DEFAULT_OUTPUT_QUEUE_SIZE);
+	overflow = grapes_config_value_str_default(tags, "output_overflow", "drop");
+	grapes_config_value_int_default(tags, "playout_delay", &len, 0);
+	outg->playout_min = len > 0 ? len * 1000 : 0;
+	grapes_config_value_int_default(tags, "playout_delay_max", &len, 4 * outg->playout_min / 1000);
+	outg->playout_max = len * 1000 > outg->playout_min ? len * 1000 : outg->playout_min;
+	grapes_config_value_int_default(tags, "adaptive_playout", &len, 1);
+	outg->adaptive_playout = len ? 1 : 0;
+	outg->synced = 0;
+	memset(&(outg->playout), 0, sizeof(struct output_playout_stats));
+	outg->playout.delay = outg->playout_min;
 
 
-	outg->buff = (struct chunk *) malloc(outg->buff_length * sizeof(struct chunk));
+	outg->buff = malloc(outg->buff_length * sizeof(struct shared_chunk *));
 	for (i=0; i<outg->buff_length; i++)
-		(outg->buff)[i].id = -1;
-	outg->out = out_stream_init("/dev/stdout", config);
+		(outg->buff)[i] = NULL;
+	outg->batch = malloc((outg->buff_length + 1) * sizeof(struct chunk *));
+	outg->batch_refs = malloc((outg->buff_length + 1) * sizeof(struct shared_chunk *));
+
+	raw = grapes_config_value_str_default(tags, "output_raw", NULL);
+	if (raw)
+	{
+		outg->raw_fd = open(raw, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (outg->raw_fd < 0)
+			fprintf(stderr, "[ERROR] cannot open %s: %s\n", raw, strerror(errno));
+	} else
+		outg->out = out_stream_init("/dev/stdout", config);
+	if ((outg->out || outg->raw_fd >= 0) && thread)
+		outg->writer = output_writer_create(queue_size > 0 ? queue_size : DEFAULT_OUTPUT_QUEUE_SIZE,
+				strcmp(overflow, "block") == 0 ? OUTPUT_BLOCK : OUTPUT_DROP_OLDEST, output_sink_write, outg);
+	free(tags);
 
-	if (outg->out == NULL)
+	if ((outg->out == NULL && outg->raw_fd < 0) || (thread && outg->writer == NULL))
 		output_destroy(&outg);
 
 	return outg;
@@ -98,7 +222,7 @@ void output_buffer_print(struct chunk_output * co)
 
 	fprintf(stderr, "[");
 	for(i=0; i<co->buff_length; i++)
-		fprintf(stderr, "| %d |", co->buff[i].id);
+		fprintf(stderr, "| %d |", output_slot_id(co, i));
 	fprintf(stderr, "]\n");
 }
 
@@ -111,11 +235,17 @@ void output_destroy(struct chunk_output ** outg)
 		if((*outg)->buff)
 		{
 			for (i=0; i<(*outg)->buff_length; i++)
-				chunk_deinit(&(((*outg)->buff)[i]));
+				shared_chunk_unref(&((*outg)->buff[i]));
 			free((*outg)->buff);
 		}
+		if((*outg)->writer)
+			output_writer_destroy(&(*outg)->writer);
 		if((*outg)->out)
 			out_stream_close((*outg)->out);
+		if((*outg)->raw_fd >= 0)
+			close((*outg)->raw_fd);
+		free((*outg)->batch);
+		free((*outg)->batch_refs);
 		free(*outg);
 		*outg = NULL;
 	}
@@ -124,33 +254,199 @@ void output_destroy(struct chunk_output ** outg)
 int output_send_next(struct chunk_output * outg)
 {
 	int res = 0;
-	if ((outg->buff)[outg->head].id >= 0)
+	if ((outg->buff)[outg->head])
 	{
-		chunk_write(outg->out, &((outg->buff)[outg->head]));
+		output_write(outg, shared_chunk_get((outg->buff)[outg->head]), (outg->buff)[outg->head]);
 		res = 1;
-		chunk_deinit(&((outg->buff)[outg->head]));
+		(outg->buff)[outg->head] = NULL;
 	}
 	outg->next_out++;
 	outg->head = (outg->head + 1) % outg->buff_length;
 	return res;
 }
 
+int output_flush_ready(struct chunk_output * outg, const struct chunk * lead, struct shared_chunk * lead_sc)
+	/* writes lead, if not NULL, and the consecutive buffered chunks from
+	 * head as a single batch; lead_sc is a reference the function takes over */
+{
+	int n = 0;
+
+	if (lead)
+	{
+		outg->batch[n] = lead;
+		outg->batch_refs[n++] = lead_sc;
+		shared_chunk_unref(&(outg->buff[outg->head]));
+		outg->next_out++;
+		outg->head = (outg->head + 1) % outg->buff_length;
+	}
+	while (outg->buff[outg->head])
+	{
+		outg->batch[n] = shared_chunk_get(outg->buff[outg->head]);
+		outg->batch_refs[n++] = outg->buff[outg->head];
+		outg->buff[outg->head] = NULL;
+		outg->next_out++;
+		outg->head = (outg->head + 1) % outg->buff_length;
+	}
+	output_write_batch(outg, n);
+	return n;
+}
+
 int output_buff_flush(struct chunk_output * outg, int len)
+	/* moves past the next len slots, writing the buffered ones as a batch */
 {
-	int i, res = 0;
+	int i, n = 0;
 
 	for(i=0; i<len; i++)
-		res += output_send_next(outg);
+	{
+		if (outg->buff[outg->head])
+		{
+			outg->batch[n] = shared_chunk_get(outg->buff[outg->head]);
+			outg->batch_refs[n++] = outg->buff[outg->head];
+			outg->buff[outg->head] = NULL;
+		}
+		outg->next_out++;
+		outg->head = (outg->head + 1) % outg->buff_length;
+	}
+	output_write_batch(outg, n);
+	return n;
+}
+
+/** jitter buffer **/
+void output_playout_arrival(struct chunk_output * outg, const struct chunk *c, int64_t now)
+	/* updates the clock mapping, the arrival jitter (RFC 3550) and the delay */
+{
+	int64_t transit, d;
+
+	transit = now - (int64_t) c->timestamp;
+	if (!outg->synced || transit < outg->base || transit - outg->base > PLAYOUT_RESYNC)
+	{
+		if (outg->synced && transit - outg->base > PLAYOUT_RESYNC)
+			outg->playout.jitter = 0;  // source restarted, timestamps are meaningless
+		outg->base = transit;
+		outg->last_transit = transit;
+		outg->synced = 1;
+	}
+	d = transit - outg->last_transit;
+	outg->last_transit = transit;
+	outg->playout.jitter += ((d < 0 ? -d : d) - outg->playout.jitter) / 16;
 
+	if (outg->adaptive_playout)
+	{
+		outg->playout.delay = PLAYOUT_JITTER_FACTOR * outg->playout.jitter;
+		if (outg->playout.delay < outg->playout_min)
+			outg->playout.delay = outg->playout_min;
+		if (outg->playout.delay > outg->playout_max)
+			outg->playout.delay = outg->playout_max;
+	}
+}
+
+int64_t output_playout_deadline(const struct chunk_output * outg, const struct shared_chunk * sc)
+{
+	return (int64_t) shared_chunk_get(sc)->timestamp + outg->base + outg->playout.delay;
+}
+
+int output_playout_skip(struct chunk_output * outg)
+	/* moves past the next chunk, played or missing */
+{
+	int res;
+
+	res = output_send_next(outg);
+	if (res)
+		outg->playout.released++;
+	else
+		outg->playout.skipped++;
 	return res;
 }
 
-int output_deliver(struct chunk_output* outg, const struct chunk *c)
+int output_playout_release(struct chunk_output * outg, int64_t now, int64_t * next)
+	/* writes the chunks whose deadline has passed, skipping the holes before
+	 * them; next, if not NULL, gets the earliest pending deadline (or -1) */
+{
+	int i, pos, res = 0;
+	int64_t deadline;
+
+	if (next)
+		*next = -1;
+	for (i = 0; i < outg->buff_length; i++)
+	{
+		pos = (outg->head + i) % outg->buff_length;
+		if (outg->buff[pos])
+		{
+			deadline = output_playout_deadline(outg, outg->buff[pos]);
+			if (deadline > now)
+			{
+				if (next)
+					*next = deadline;
+				break;
+			}
+			while (i-- >= 0)
+				res += output_playout_skip(outg);
+			i = -1;  // we restart from the new head
+		}
+	}
+	return res;
+}
+
+int output_playout_deliver(struct chunk_output * outg, const struct chunk *c, struct shared_chunk *sc)
+{
+	int64_t now;
+	int res = 0;
+	int new_pos;
+
+	now = mono_clock_us();
+	output_playout_arrival(outg, c, now);
+	if (outg->next_out < 0)
+		outg->next_out = c->id;
+	if (c->id < outg->next_out)
+	{
+		outg->playout.late++;
+		return 0;
+	}
+
+	if (c->id >= outg->next_out + outg->buff_length)  // no room left, we give up the oldest
+		while (c->id >= outg->next_out + outg->buff_length)
+			res += output_playout_skip(outg);
+
+	new_pos = (outg->head + c->id - outg->next_out) % outg->buff_length;
+	if (outg->buff[new_pos] == NULL)  // we do not want duplicates
+		outg->buff[new_pos] = sc ? shared_chunk_ref(sc) : shared_chunk_create(NULL, c);
+
+	return res + output_playout_release(outg, now, NULL);
+}
+
+suseconds_t output_periodic(struct chunk_output * outg)
+{
+	int64_t now, next;
+
+	if (outg == NULL || outg->playout_min == 0)
+		return -1;
+
+	now = mono_clock_us();
+	output_playout_release(outg, now, &next);
+	if (next < 0 || next - now > PLAYOUT_TICK)
+		return PLAYOUT_TICK;
+	return next - now;
+}
+
+int8_t output_playout_stats(const struct chunk_output * outg, struct output_playout_stats * stats)
+{
+	if (outg && outg->playout_min && stats)
+	{
+		*stats = outg->playout;
+		return 0;
+	}
+	return -1;
+}
+
+int output_deliver_chunk(struct chunk_output* outg, const struct chunk *c, struct shared_chunk *sc)
 /* returns the number of of chunks sent out or -1 if chunks was too late or corrupted */
 {
 	int res = -1;
 	int new_pos;
 
+	if (outg && c && outg->playout_min)
+		return output_playout_deliver(outg, c, sc);
+
 	if (outg && c)
 	{
 		res = 0;
@@ -161,6 +457,9 @@ int output_deliver(struct chunk_output* outg, const struct chunk *c)
 				if (outg->next_out < 0)	// case we have not initialized yet
 					outg->next_out = c->id;
 
+				if (c->id == outg->next_out)  // in order, no need to buffer it
+					return res + output_flush_ready(outg, c, shared_chunk_ref(sc));
+
 				// we make sure packet fits
 				new_pos = (outg->head + c->id - outg->next_out) % outg->buff_length;
 				if (c->id >= outg->next_out + outg->buff_length) // we need to free space
@@ -171,21 +470,43 @@ int output_deliver(struct chunk_output* outg, const struct chunk *c)
 
 
 				// we place the packet
-				if (c->id != (outg->buff[new_pos]).id)  // we do not want duplicates
-					chunk_clone(&(outg->buff[new_pos]), c);
+				if (c->id != output_slot_id(outg, new_pos))  // we do not want duplicates
+				{
+					shared_chunk_unref(&(outg->buff[new_pos]));
+					outg->buff[new_pos] = sc ? shared_chunk_ref(sc) : shared_chunk_create(NULL, c);
+				}
 
 				// we flush everygthing possible
-				while(outg->buff[outg->head].id >= 0)
-					res += output_send_next(outg);
+				res += output_flush_ready(outg, NULL, NULL);
 
 				// output_buffer_print(outg);
 			}
 			
 		} else {
-			chunk_write(outg->out, c);
+			output_write(outg, c, shared_chunk_ref(sc));
 			res++;
 		}
 	}
 
 	return res;
 }
+
+int output_deliver(struct chunk_output* outg, const struct chunk *c)
+{
+	return output_deliver_chunk(outg, c, NULL);
+}
+
+int output_deliver_shared(struct chunk_output* outg, struct shared_chunk *sc)
+{
+	return output_deliver_chunk(outg, shared_chunk_get(sc), sc);
+}
+
+int8_t output_stats(struct chunk_output * outg, struct output_writer_stats * stats)
+{
+	if (outg && outg->writer && stats)
+	{
+		output_writer_stats(outg->writer, stats);
+		return 0;
+	}
+	return -1;
+}
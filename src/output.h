@@ -25,13 +25,35 @@
 #include<psinstance_internal.h>
 #include<chunk.h>
 #include<measures.h>
+#include<shared_chunk.h>
+#include<output_writer.h>
 
 struct chunk_output;
 
+struct output_playout_stats {
+	uint32_t released;
+	uint32_t skipped;  // missing when their playout deadline passed
+	uint32_t late;  // arrived after their playout deadline
+	suseconds_t delay;  // current playout delay (microseconds)
+	suseconds_t jitter;  // arrival jitter estimate (microseconds)
+};
+
 struct chunk_output * output_create(struct measures * ms, const char *config);
 
 int output_deliver(struct chunk_output* outg, const struct chunk *c);
 
+/* as output_deliver, but out of order chunks are buffered by reference */
+int output_deliver_shared(struct chunk_output* outg, struct shared_chunk *sc);
+
 void output_destroy(struct chunk_output** outg);
 
+/* with playout_delay set, releases the chunks due by now; returns the
+ * microseconds before it needs to be called again, -1 if not needed */
+suseconds_t output_periodic(struct chunk_output * outg);
+
+int8_t output_playout_stats(const struct chunk_output * outg, struct output_playout_stats * stats);
+
+/* writer thread counters, -1 if chunks are written synchronously */
+int8_t output_stats(struct chunk_output * outg, struct output_writer_stats * stats);
+
 #endif	/* OUTPUT_H */
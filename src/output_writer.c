@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<malloc.h>
+#include<string.h>
+#include<unistd.h>
+#include<pthread.h>
+#include<semaphore.h>
+#include<output_writer.h>
+
+#define OUTPUT_BLOCK_WAIT 200  // microseconds
+
+#define ATOMIC_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+struct output_writer {
+	/* queue ring: the producer advances head, both sides claim entries by
+	 * moving tail (the writer to write them, the producer to drop them) */
+	struct shared_chunk ** queue;
+	uint64_t head;
+	uint64_t tail;
+	/* done ring, from the writer back to the producer */
+	struct shared_chunk ** done;
+	uint64_t done_head;
+	uint64_t done_tail;
+	uint64_t size;
+
+	enum output_overflow policy;
+	output_write_f write;
+	void * arg;
+
+	uint64_t written;  // writer side
+	uint64_t queued;  // producer side
+	uint64_t dropped;
+	uint32_t max_lag;
+
+	sem_t pending;
+	pthread_t thread;
+	int8_t running;
+	int8_t finished;  // the writer has handed everything back
+};
+
+static void output_writer_reclaim(struct output_writer * w)
+	/* producer side: releases the chunks handed back by the writer */
+{
+	uint64_t t, h;
+
+	h = ATOMIC_LOAD(w->done_head);
+	for (t = w->done_tail; t < h; t++)
+		shared_chunk_unref(&(w->done[t % (2 * w->size)]));
+	ATOMIC_STORE(w->done_tail, h);
+}
+
+static struct shared_chunk * output_writer_claim(struct output_writer * w)
+	/* takes the oldest queued chunk, NULL if the queue is empty */
+{
+	struct shared_chunk * sc;
+	uint64_t t;
+
+	t = ATOMIC_LOAD(w->tail);
+	while (t < ATOMIC_LOAD(w->head))
+	{
+		sc = w->queue[t % w->size];
+		if (__atomic_compare_exchange_n(&(w->tail), &t, t + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return sc;
+	}
+	return NULL;
+}
+
+static void * output_writer_loop(void * arg)
+{
+	struct output_writer * w = arg;
+	struct shared_chunk * batch[OUTPUT_WRITER_BATCH];
+	const struct chunk * chunks[OUTPUT_WRITER_BATCH];
+	uint64_t h;
+	int i, n;
+
+	while (ATOMIC_LOAD(w->running) || ATOMIC_LOAD(w->tail) < ATOMIC_LOAD(w->head))
+	{
+		for (n = 0; n < OUTPUT_WRITER_BATCH && n < (int) w->size && (batch[n] = output_writer_claim(w)); n++)
+			chunks[n] = shared_chunk_get(batch[n]);
+		if (n)
+		{
+			w->write(w->arg, chunks, n);
+			ATOMIC_STORE(w->written, w->written + n);
+			for (i = 0; i < n; i++)
+			{
+				h = w->done_head;
+				while (h - ATOMIC_LOAD(w->done_tail) >= 2 * w->size)  // the producer is late in reclaiming
+					usleep(OUTPUT_BLOCK_WAIT);
+				w->done[h % (2 * w->size)] = batch[i];
+				ATOMIC_STORE(w->done_head, h + 1);
+			}
+		} else if (ATOMIC_LOAD(w->running))
+			sem_wait(&(w->pending));
+	}
+	ATOMIC_STORE(w->finished, 1);
+	return NULL;
+}
+
+struct output_writer * output_writer_create(int size, enum output_overflow policy, output_write_f write, void * arg)
+{
+	struct output_writer * w = NULL;
+
+	if (size > 0 && write)
+	{
+		w = malloc(sizeof(struct output_writer));
+		memset(w, 0, sizeof(struct output_writer));
+		w->size = size;
+		w->queue = malloc(sizeof(struct shared_chunk *) * size);
+		w->done = malloc(sizeof(struct shared_chunk *) * 2 * size);  // queued plus in between reclaims
+		w->policy = policy;
+		w->write = write;
+		w->arg = arg;
+		w->running = 1;
+		sem_init(&(w->pending), 0, 0);
+		if (pthread_create(&(w->thread), NULL, output_writer_loop, w))
+		{
+			fprintf(stderr, "[ERROR] cannot start the output writer thread\n");
+			w->running = 0;
+			output_writer_destroy(&w);
+		}
+	}
+	return w;
+}
+
+void output_writer_destroy(struct output_writer ** w)
+{
+	struct shared_chunk * sc;
+
+	if (w && *w)
+	{
+		if ((*w)->running)
+		{
+			ATOMIC_STORE((*w)->running, 0);
+			sem_post(&((*w)->pending));
+			while (!ATOMIC_LOAD((*w)->finished))  // the writer may wait for done ring room
+			{
+				output_writer_reclaim(*w);
+				usleep(OUTPUT_BLOCK_WAIT);
+			}
+			pthread_join((*w)->thread, NULL);
+		}
+		output_writer_reclaim(*w);
+		while ((sc = output_writer_claim(*w)))
+			shared_chunk_unref(&sc);
+		sem_destroy(&((*w)->pending));
+		free((*w)->queue);
+		free((*w)->done);
+		free(*w);
+		*w = NULL;
+	}
+}
+
+int8_t output_writer_push(struct output_writer * w, struct shared_chunk * sc)
+{
+	struct shared_chunk * old;
+	int8_t res = 0;
+	uint32_t lag;
+
+	if (w == NULL || sc == NULL)
+		return -1;
+
+	output_writer_reclaim(w);
+	while (w->head - ATOMIC_LOAD(w->tail) >= w->size)
+	{
+		if (w->policy == OUTPUT_DROP_OLDEST)
+		{
+			old = output_writer_claim(w);
+			if (old)
+			{
+				shared_chunk_unref(&old);
+				w->dropped++;
+				res = 1;
+			}
+		} else {
+			usleep(OUTPUT_BLOCK_WAIT);
+			output_writer_reclaim(w);
+		}
+	}
+
+	w->queue[w->head % w->size] = sc;
+	ATOMIC_STORE(w->head, w->head + 1);
+	w->queued++;
+	lag = w->head - ATOMIC_LOAD(w->written) - w->dropped;
+	if (lag > w->max_lag)
+		w->max_lag = lag;
+	sem_post(&(w->pending));
+	return res;
+}
+
+void output_writer_stats(struct output_writer * w, struct output_writer_stats * stats)
+{
+	if (w && stats)
+	{
+		output_writer_reclaim(w);
+		stats->queued = w->queued;
+		stats->written = ATOMIC_LOAD(w->written);
+		stats->dropped = w->dropped;
+		stats->lag = stats->queued - stats->written - stats->dropped;
+		stats->max_lag = w->max_lag;
+	}
+}
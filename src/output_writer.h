@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __OUTPUT_WRITER_H__
+#define __OUTPUT_WRITER_H__
+
+#include<stdint.h>
+#include<chunk.h>
+#include<shared_chunk.h>
+
+/* Writer thread for the output stage: the streaming loop pushes in-order
+ * chunks in a lock-free single producer ring and the writer thread writes
+ * them out, as many as are queued in a single call, so that a slow sink
+ * does not stall the streaming loop.
+ * The writer hands the written chunks back through a second ring: every
+ * shared chunk reference is taken and released by the producer thread
+ * only. When the ring is full the producer either drops the oldest queued
+ * chunk or waits for the writer. */
+
+#define DEFAULT_OUTPUT_QUEUE_SIZE 256  // chunks
+
+enum output_overflow {OUTPUT_DROP_OLDEST, OUTPUT_BLOCK};
+
+#define OUTPUT_WRITER_BATCH 64  // chunks written per callback at most, capped to the queue size
+
+/* writes n consecutive chunks */
+typedef void (*output_write_f)(void * arg, const struct chunk ** chunks, int n);
+
+struct output_writer_stats {
+	uint64_t queued;
+	uint64_t written;
+	uint64_t dropped;
+	uint32_t lag;  // chunks queued and not yet written
+	uint32_t max_lag;
+};
+
+struct output_writer;
+
+struct output_writer * output_writer_create(int size, enum output_overflow policy, output_write_f write, void * arg);
+
+/* waits for the queued chunks to be written, then stops the thread */
+void output_writer_destroy(struct output_writer ** w);
+
+/* queues sc, taking over the caller reference; returns 0, 1 if a queued
+ * chunk was dropped to make room or -1 on error */
+int8_t output_writer_push(struct output_writer * w, struct shared_chunk * sc);
+
+void output_writer_stats(struct output_writer * w, struct output_writer_stats * stats);
+
+#endif
@@ -69,6 +69,9 @@ void peer_data_init(struct peer *p)
 		ud = malloc(sizeof(struct user_data));
 		ud->bmap = chunkID_set_init("type=bitmap");
 		timerclear(&ud->bmap_timestamp);
+		ud->rtt = -1;
+		ud->capacity = -1;
+		ud->seed_credit = 0;
 		p->user_data = ud;
 	}
 }
@@ -118,9 +121,63 @@ struct timeval * peer_bmap_timestamp(struct peer *p)
 	return time;
 }
 
+double * peer_seed_credit(struct peer *p)
+{
+	if (p && p->user_data)
+		return &(((struct user_data *)p->user_data)->seed_credit);
+	return NULL;
+}
+
 struct timeval * peer_creation_timestamp(struct peer *p)
 {
 	if (p)
 		return &(p->creation_timestamp);
 	return NULL;
 }
+
+static double estimate_update(double estimate, double sample)
+{
+	if (estimate < 0)
+		return sample;
+	return PEER_ESTIMATE_MEMORY * estimate + (1 - PEER_ESTIMATE_MEMORY) * sample;
+}
+
+int8_t peer_update_rtt(struct peer *p, double rtt)
+{
+	struct user_data * ud;
+
+	if (p && p->user_data && rtt >= 0)
+	{
+		ud = (struct user_data *)p->user_data;
+		ud->rtt = estimate_update(ud->rtt, rtt);
+		return 0;
+	}
+	return -1;
+}
+
+int8_t peer_update_capacity(struct peer *p, double byterate)
+{
+	struct user_data * ud;
+
+	if (p && p->user_data && byterate > 0)
+	{
+		ud = (struct user_data *)p->user_data;
+		ud->capacity = estimate_update(ud->capacity, byterate);
+		return 0;
+	}
+	return -1;
+}
+
+double peer_rtt(const struct peer *p)
+{
+	if (p && p->user_data)
+		return ((struct user_data *)p->user_data)->rtt;
+	return -1;
+}
+
+double peer_capacity(const struct peer *p)
+{
+	if (p && p->user_data)
+		return ((struct user_data *)p->user_data)->capacity;
+	return -1;
+}
@@ -28,6 +28,8 @@
 
 #define DEFAULT_PEER_CBSIZE 50
 #define DEFAULT_PEER_NEIGH_SIZE 30
+#define DEFAULT_PEER_CAPACITY 1000000  // bytes per second
+#define PEER_ESTIMATE_MEMORY 0.8  // weight of the past in rtt/capacity estimations
 
 struct metadata {
   uint16_t cb_size;
@@ -35,8 +37,11 @@ struct metadata {
 } __attribute__((packed));
 
 struct user_data {
-	struct timeval bmap_timestamp;
+	struct timeval bmap_timestamp;  // monotonic clock
 	struct chunkID_set * bmap;
+	double rtt;  // seconds, negative if not measured yet
+	double capacity;  // bytes per second, negative if not measured yet
+	double seed_credit;  // source seeding scheduler state
 };
 
 int8_t metadata_update(struct metadata *m, uint16_t cb_size, uint8_t neigh_size);
@@ -57,4 +62,14 @@ struct timeval * peer_bmap_timestamp(struct peer *p);
 
 struct timeval * peer_creation_timestamp(struct peer *p);
 
+double * peer_seed_credit(struct peer *p);
+
+int8_t peer_update_rtt(struct peer *p, double rtt);
+
+int8_t peer_update_capacity(struct peer *p, double byterate);
+
+double peer_rtt(const struct peer *p);
+
+double peer_capacity(const struct peer *p);
+
 #endif
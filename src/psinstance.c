@@ -30,10 +30,21 @@
 #include<chunk_trader.h>
 #include<measures.h>
 #include<topology.h>
+#include<peerset.h>
 #include<grapes_msg_types.h>
 #include<dbg.h>
 #include<streaming_timers.h>
+#include<source_pacer.h>
+#include<metrics_server.h>
+#include<tracer.h>
+#include<stage_timers.h>
 #include<pstreamer_event.h>
+#include<mono_clock.h>
+#include<poll.h>
+
+#define PEER_SAMPLER_PERIOD 20000  // microseconds
+#define EXPIRY_PERIOD 20000  // microseconds
+#define MAX_TIMERS_SLEEP 1000000  // microseconds
 
 struct psinstance {
 	struct nodeID * my_sock;
@@ -43,19 +54,45 @@ struct psinstance {
 	struct chunk_trader * trader;
 	struct input_context inc;
 	struct input_desc * input;
+	struct source_pacer * pacer;  // injection deadlines of paced inputs
+	struct metrics_server * metrics;
+	struct tracer * tracer;  // chunk and signalling event log
+	struct log_rates log;
+	struct stage_timers stages;  // filled with STAGE_TIMERS only
+	struct metrics_text metrics_text;
+	char * metrics_socket;
+	suseconds_t metrics_period;  // microseconds
 	struct streaming_timers timers;
+	uint8_t * rx_buff;  // MSG_BUFFSIZE bytes, received messages are parsed in place
 	char * iface;
 	int port;
 	suseconds_t chunk_time_interval; // microseconds
 	suseconds_t chunk_offer_interval; // microseconds
 	int source_multiplicity;
+	int poll_budget;
+	suseconds_t topology_period;  // microseconds
+	int net_fd;
+	struct timeval net_resume;  // the shaper holds the outqueue back until then
 	enum L3PROTOCOL l3;
 };
 
+int8_t clock_mode_parse(const char * str, enum mono_clock_mode * mode)
+{
+	if (strcmp(str, "precise") == 0)
+		*mode = MONO_CLOCK_PRECISE;
+	else if (strcmp(str, "coarse") == 0)
+		*mode = MONO_CLOCK_COARSE;
+	else
+		return -1;
+	return 0;
+}
+
 int config_parse(struct psinstance * ps,const char * config)
 {
 	struct tag * tags;
 	const char *tmp_str;
+	enum mono_clock_mode clock;
+	int tmp_int;
 
 	tags = grapes_config_parse(config);
 
@@ -63,9 +100,22 @@ int config_parse(struct psinstance * ps,const char * config)
 	ps->iface = tmp_str ? strdup(tmp_str) : NULL;
 	grapes_config_value_int_default(tags, "port", &(ps->port), 0);
 	grapes_config_value_int_default(tags, "source_multiplicity", &(ps->source_multiplicity), 3);
+	grapes_config_value_int_default(tags, "poll_budget", &(ps->poll_budget), DEFAULT_POLL_BUDGET);
+	grapes_config_value_int_default(tags, "topology_period", &tmp_int, DEFAULT_TOPOLOGY_PERIOD);
+	ps->topology_period = (tmp_int > 0 ? tmp_int : DEFAULT_TOPOLOGY_PERIOD) * 1000;
+	if (ps->poll_budget < 1)
+		ps->poll_budget = 1;
+	tmp_str = grapes_config_value_str_default(tags, "metrics_socket", NULL);
+	ps->metrics_socket = tmp_str ? strdup(tmp_str) : NULL;
+	grapes_config_value_int_default(tags, "metrics_period", &tmp_int, DEFAULT_METRICS_PERIOD);
+	ps->metrics_period = (tmp_int > 0 ? tmp_int : DEFAULT_METRICS_PERIOD) * 1000;
 
 	tmp_str = grapes_config_value_str_default(tags, "filename", NULL);
 	strcpy((ps->inc).filename, tmp_str ? tmp_str : "");
+	tmp_str = grapes_config_value_str_default(tags, "clock", NULL);
+	if (tmp_str && (clock_mode_parse(tmp_str, &clock) || clock != mono_clock_mode()))
+		fprintf(stderr, "[WARNING] ignoring clock=%s, the clock is process-wide and set by psinstance_set_clock\n", tmp_str);
+
 	tmp_str = grapes_config_value_str_default(tags, "AF", NULL);
 	ps->l3 = tmp_str && (strcmp(tmp_str, "INET6") == 0) ? IP6 : IP4;
 
@@ -73,6 +123,169 @@ int config_parse(struct psinstance * ps,const char * config)
 	return 0;
 }
 
+suseconds_t psinstance_topology_task(void * arg)
+{
+	struct psinstance * ps = arg;
+
+	STAGE_TIMED(&ps->stages, STAGE_TOPOLOGY, topology_update(ps->topology));
+	return ps->topology_period;
+}
+
+suseconds_t psinstance_sampler_task(void * arg)
+{
+	struct psinstance * ps = arg;
+
+	topology_sampler_periodic(ps->topology);
+	return PEER_SAMPLER_PERIOD;
+}
+
+suseconds_t psinstance_expiry_task(void * arg)
+{
+	struct psinstance * ps = arg;
+
+	chunk_trader_expire(ps->trader);
+	return EXPIRY_PERIOD;
+}
+
+suseconds_t psinstance_playout_task(void * arg)
+{
+	struct psinstance * ps = arg;
+
+	return output_periodic(ps->chunk_out);  // unregistered without a jitter buffer
+}
+
+void psinstance_metrics_snapshot(struct psinstance * ps, struct metrics_text * t)
+{
+	struct measures_summary sum;
+	struct measures_node nodes[MEASURES_MAX_NODES];
+	struct chunk_trader_stats cts;
+	struct output_playout_stats ops;
+	struct output_writer_stats ows;
+	struct source_pacer_stats sps;
+	struct stage_summary sts;
+	struct timeval now, hold;
+	char labels[MEASURES_MAX_NODES][NODE_STR_LENGTH + 8], addr[NODE_STR_LENGTH];
+	int i, n;
+
+	metrics_text_reset(t);
+	measures_summary(ps->measure, &sum);
+	metrics_text_metric(t, "pstreamer_chunks_received_total", "counter", "Unique chunks received", sum.chunks);
+	metrics_text_metric(t, "pstreamer_chunks_duplicate_total", "counter", "Chunks received more than once", sum.duplicates);
+	metrics_text_metric(t, "pstreamer_chunks_lost_total", "counter", "Chunk IDs never received", sum.lost);
+	metrics_text_metric(t, "pstreamer_loss_ratio", "gauge", "Chunk loss over the last measurement window", sum.loss);
+	metrics_text_family(t, "pstreamer_delay_seconds", "summary", "End to end chunk delay");
+	metrics_text_sample(t, "pstreamer_delay_seconds", "quantile=\"0.5\"", sum.delay_p50 / 1e6);
+	metrics_text_sample(t, "pstreamer_delay_seconds", "quantile=\"0.95\"", sum.delay_p95 / 1e6);
+	metrics_text_sample(t, "pstreamer_delay_seconds", "quantile=\"0.99\"", sum.delay_p99 / 1e6);
+	metrics_text_sample(t, "pstreamer_delay_seconds", "quantile=\"1\"", sum.delay_max / 1e6);
+	metrics_text_metric(t, "pstreamer_hopcount_mean", "gauge", "Mean hop count of the received chunks", sum.hopcount_mean);
+	metrics_text_metric(t, "pstreamer_download_bits_per_second", "gauge", "Chunk download rate", sum.download_bps);
+	metrics_text_metric(t, "pstreamer_upload_bits_per_second", "gauge", "Chunk upload rate", sum.upload_bps);
+	metrics_text_metric(t, "pstreamer_signalling_bits_per_second", "gauge", "Received signalling and topology rate", sum.signalling_bps);
+	metrics_text_metric(t, "pstreamer_signalling_overhead_ratio", "gauge", "Share of signalling in the received bytes", sum.signalling_overhead);
+	metrics_text_metric(t, "pstreamer_chunk_interval_seconds", "gauge", "Estimated chunk interval", chunk_interval_measure(ps->measure) / 1e6);
+
+	n = measures_nodes(ps->measure, nodes, MEASURES_MAX_NODES);
+	metrics_text_metric(t, "pstreamer_neighbours", "gauge", "Neighbourhood size", peerset_size(topology_get_neighbours(ps->topology)));
+	for (i = 0; i < n; i++)
+	{
+		node_addr(nodes[i].id, addr, NODE_STR_LENGTH);
+		snprintf(labels[i], sizeof(labels[i]), "peer=\"%s\"", addr);
+	}
+	metrics_text_family(t, "pstreamer_peer_chunks_received_total", "counter", "Chunks received from a peer");
+	for (i = 0; i < n; i++)
+		metrics_text_sample(t, "pstreamer_peer_chunks_received_total", labels[i], nodes[i].chunks_received);
+	metrics_text_family(t, "pstreamer_peer_chunks_sent_total", "counter", "Chunks sent to a peer");
+	for (i = 0; i < n; i++)
+		metrics_text_sample(t, "pstreamer_peer_chunks_sent_total", labels[i], nodes[i].chunks_sent);
+	metrics_text_family(t, "pstreamer_peer_loss_ratio", "gauge", "Accepted or requested chunks a peer did not deliver");
+	for (i = 0; i < n; i++)
+		metrics_text_sample(t, "pstreamer_peer_loss_ratio", labels[i], nodes[i].loss);
+	metrics_text_family(t, "pstreamer_peer_delay_seconds", "gauge", "Moving average of the delay of the chunks from a peer");
+	for (i = 0; i < n; i++)
+		metrics_text_sample(t, "pstreamer_peer_delay_seconds", labels[i], nodes[i].delay_mean / 1e6);
+
+	metrics_text_metric(t, "pstreamer_net_outqueue_messages", "gauge", "Messages queued for sending", net_helper_outqueue_length(ps->my_sock));
+	metrics_text_metric(t, "pstreamer_net_endpoints", "gauge", "Remote nodes with network state", net_helper_endpoints(ps->my_sock));
+	mono_clock_now(&now);
+	timerclear(&hold);
+	if (timercmp(&now, &(ps->net_resume), <))
+		timersub(&(ps->net_resume), &now, &hold);
+	metrics_text_metric(t, "pstreamer_net_shaper_hold_seconds", "gauge", "Time left before the shaper lets the outqueue go", hold.tv_sec + hold.tv_usec / 1e6);
+
+	if (chunk_trader_stats(ps->trader, &cts) == 0)
+	{
+		metrics_text_metric(t, "pstreamer_trader_buffered_chunks", "gauge", "Chunks in the trading buffer", cts.buffered);
+		metrics_text_metric(t, "pstreamer_trader_archived_chunks", "gauge", "Chunks in the on disk archive", cts.archived);
+		metrics_text_metric(t, "pstreamer_trader_chunk_locks", "gauge", "Chunks accepted or requested and not yet received", cts.locks);
+		metrics_text_metric(t, "pstreamer_trader_transactions", "gauge", "Offers waiting for their accept", cts.transactions);
+		metrics_text_metric(t, "pstreamer_trader_chunks_per_offer", "gauge", "Chunks per offer", cts.chunks_per_offer);
+	}
+	if (output_playout_stats(ps->chunk_out, &ops) == 0)
+	{
+		metrics_text_metric(t, "pstreamer_playout_released_total", "counter", "Chunks released by the jitter buffer", ops.released);
+		metrics_text_metric(t, "pstreamer_playout_skipped_total", "counter", "Chunks missing at their playout deadline", ops.skipped);
+		metrics_text_metric(t, "pstreamer_playout_late_total", "counter", "Chunks arrived after their playout deadline", ops.late);
+		metrics_text_metric(t, "pstreamer_playout_delay_seconds", "gauge", "Playout delay", ops.delay / 1e6);
+	}
+	if (output_stats(ps->chunk_out, &ows) == 0)
+	{
+		metrics_text_metric(t, "pstreamer_output_queue_chunks", "gauge", "Chunks queued for the output thread", ows.lag);
+		metrics_text_metric(t, "pstreamer_output_dropped_total", "counter", "Chunks dropped by a full output queue", ows.dropped);
+	}
+	if (STAGE_TIMERS_ENABLED)
+	{
+		metrics_text_family(t, "pstreamer_stage_seconds", "summary", "Time spent in the streaming loop stages");
+		for (i = 0; i < STAGES; i++)
+		{
+			stage_timers_summary(&ps->stages, i, &sts);
+			snprintf(labels[0], sizeof(labels[0]), "stage=\"%s\",quantile=\"0.5\"", stage_name(i));
+			metrics_text_sample(t, "pstreamer_stage_seconds", labels[0], sts.p50 / 1e9);
+			snprintf(labels[0], sizeof(labels[0]), "stage=\"%s\",quantile=\"0.99\"", stage_name(i));
+			metrics_text_sample(t, "pstreamer_stage_seconds", labels[0], sts.p99 / 1e9);
+			snprintf(labels[0], sizeof(labels[0]), "stage=\"%s\",quantile=\"1\"", stage_name(i));
+			metrics_text_sample(t, "pstreamer_stage_seconds", labels[0], sts.max / 1e9);
+			snprintf(labels[0], sizeof(labels[0]), "stage=\"%s\"", stage_name(i));
+			metrics_text_sample(t, "pstreamer_stage_seconds_sum", labels[0], sts.sum / 1e9);
+			metrics_text_sample(t, "pstreamer_stage_seconds_count", labels[0], sts.count);
+		}
+	}
+	if (ps->pacer)
+	{
+		source_pacer_stats(ps->pacer, &sps);
+		metrics_text_metric(t, "pstreamer_source_lateness_seconds", "gauge", "Lateness of the last injection", sps.lateness / 1e6);
+		metrics_text_metric(t, "pstreamer_source_jitter_seconds", "gauge", "Injection jitter", sps.jitter / 1e6);
+	}
+}
+
+int psinstance_command(void * arg, const char * command, char * reply, int len)
+	/* control channel: a config string setting the log rates, answered
+	 * with the current ones */
+{
+	struct psinstance * ps = arg;
+	int n;
+
+	log_configure(&ps->log, command);
+	n = log_config_str(&ps->log, reply, len - 1);
+	reply[n++] = '\n';
+	return n;
+}
+
+suseconds_t psinstance_metrics_task(void * arg)
+{
+	struct psinstance * ps = arg;
+
+	psinstance_metrics_snapshot(ps, &ps->metrics_text);
+	metrics_server_publish(ps->metrics, &ps->metrics_text);
+	return ps->metrics_period;
+}
+
+void psinstance_store_fd(void * handler, int fd, char mode)
+{
+	if (mode == 'r')
+		*((int *) handler) = fd;
+}
+
 int node_init(struct psinstance * ps, const char * config)
 {
 	char * my_addr;
@@ -90,11 +303,25 @@ int node_init(struct psinstance * ps, const char * config)
 	free(my_addr);
 
 	if (ps->my_sock)
+	{
+		register_network_fds(ps->my_sock, psinstance_store_fd, &(ps->net_fd));
 		return 0;
+	}
 	else
 		return -2;
 }
 
+int8_t psinstance_timerfd_pacing(const char * config)
+{
+	struct tag * tags;
+	int8_t res;
+
+	tags = grapes_config_parse(config);
+	res = strcmp(grapes_config_value_str_default(tags, "source_pacing", "timerfd"), "select") != 0;
+	free(tags);
+	return res;
+}
+
 struct psinstance * psinstance_create(const char * srv_ip, const int srv_port, const char * config)
 {
 	struct psinstance * ps = NULL;
@@ -106,16 +333,31 @@ struct psinstance * psinstance_create(const char * srv_ip, const int srv_port, c
 		ps = malloc(sizeof(struct psinstance));
 		memset(ps, 0, sizeof(struct psinstance));
 
+		ps->net_fd = -1;
+		ps->rx_buff = malloc(MSG_BUFFSIZE);
 		ps->chunk_time_interval = 0;
 		ps->chunk_offer_interval = 1000000/25;  // microseconds divided by frame (chunks) per second
 		config_parse(ps, config);
+		stage_timers_init(&ps->stages);
 		res = node_init(ps, config);
 		if (res == 0)
 		{
 			ps->measure = measures_create(nodeid_static_str(ps->my_sock));
+			ps->tracer = tracer_create(config);
+			log_rates_init(&ps->log);
+			if (ps->tracer)
+				log_configure(&ps->log, "log_chunk=1,log_signal=1");  // unless limited by config
+			log_configure(&ps->log, config);
 			ps->topology = topology_create(ps, config);
 			ps->trader = chunk_trader_create(ps, config);
 			streaming_timers_init(&(ps->timers), ps->chunk_offer_interval);
+			streaming_timers_add_task(&(ps->timers), psinstance_topology_task, ps, ps->topology_period);
+			streaming_timers_add_task(&(ps->timers), psinstance_sampler_task, ps, PEER_SAMPLER_PERIOD);
+			streaming_timers_add_task(&(ps->timers), psinstance_expiry_task, ps, EXPIRY_PERIOD);
+			if (ps->metrics_socket)
+				ps->metrics = metrics_server_create(ps->metrics_socket, psinstance_command, ps);
+			if (ps->metrics)
+				streaming_timers_add_task(&(ps->timers), psinstance_metrics_task, ps, 0);
 			ps->chunk_out = NULL;  // To be used as a flag if current role is source or peer role
 			if (srv_port)
 			{  // creating a normal peer
@@ -126,12 +368,23 @@ struct psinstance * psinstance_create(const char * srv_ip, const int srv_port, c
 					ps->input = NULL;
 					topology_node_insert(ps->topology, srv);
 					ps->chunk_out = output_create(ps->measure, config);
+					streaming_timers_add_task(&(ps->timers), psinstance_playout_task, ps, 0);
 					nodeid_free(srv);
 				} else
 					psinstance_destroy(&ps);
 			} else {  // creating a source peer
+				(ps->inc).fds_size = FDSSIZE;
 				ps->input = input_open((ps->inc).filename, (ps->inc).fds, (ps->inc).fds_size, config);
-				(ps->inc).fds[(ps->inc).fds_size] = -1;
+				if (ps->input == NULL)
+					(ps->inc).fds[0] = -1;
+				else if ((ps->inc).fds[0] == -1 && psinstance_timerfd_pacing(config))
+					ps->pacer = source_pacer_create();
+				if (ps->pacer)
+				{
+					(ps->inc).fds[0] = source_pacer_fd(ps->pacer);
+					(ps->inc).fds[1] = -1;
+					source_pacer_arm(ps->pacer, input_deadline(ps->input));
+				}
 			}
 		}
 		else
@@ -155,10 +408,22 @@ void psinstance_destroy(struct psinstance ** ps)
 			chunk_trader_destroy(&(*ps)->trader);
 		if ((*ps)->iface)
 			free((*ps)->iface);
+		if ((*ps)->rx_buff)
+			free((*ps)->rx_buff);
 		if ((*ps)->my_sock)
 			net_helper_deinit((*ps)->my_sock);
 		if ((*ps)->input)
 			input_close((*ps)->input);
+		if ((*ps)->pacer)
+			source_pacer_destroy(&(*ps)->pacer);
+		if ((*ps)->metrics)
+			metrics_server_destroy(&(*ps)->metrics);
+		if ((*ps)->tracer)
+			tracer_destroy(&(*ps)->tracer);
+		if ((*ps)->metrics_socket)
+			free((*ps)->metrics_socket);
+		metrics_text_deinit(&(*ps)->metrics_text);
+		streaming_timers_deinit(&(*ps)->timers);
 		free(*ps);
 		*ps = NULL;
 	}
@@ -194,9 +459,27 @@ const struct chunk_trader * psinstance_trader(const struct psinstance * ps)
 	return ps->trader;
 }
 
+struct tracer * psinstance_tracer(const struct psinstance * ps)
+{
+	return ps->tracer;
+}
+
+struct log_rates * psinstance_log_rates(const struct psinstance * ps)
+{
+	return (struct log_rates *) &ps->log;
+}
+
+int8_t psinstance_timed_injection(const struct psinstance * ps)
+	/* sources inject on the chunk timer, unless paced by their timerfd */
+{
+	return psinstance_is_source(ps) && ps->pacer == NULL;
+}
+
 int8_t psinstance_send_offer(struct psinstance * ps)
 {
-	chunk_trader_send_offer(ps->trader);
+	chunk_trader_advertise_bmap(ps->trader);
+	STAGE_TIMED(&ps->stages, STAGE_OFFER, chunk_trader_send_offer(ps->trader));
+	chunk_trader_send_requests(ps->trader);
 	return 0;
 }
 
@@ -207,16 +490,16 @@ int8_t psinstance_inject_chunk(struct psinstance * ps)
 
 	if (ps && psinstance_is_source(ps))
 	{
+		if (ps->pacer && source_pacer_expired(ps->pacer) <= 0)
+			return 0;  // woken up by another timer, too early for the next chunk
 		new_chunk = input_chunk(ps->input, &(ps->chunk_time_interval));
+		if (ps->pacer)
+			source_pacer_arm(ps->pacer, input_deadline(ps->input));
 		if(new_chunk) 
 		{
 			if(!chunk_trader_add_chunk(ps->trader, new_chunk))
-			{
 				chunk_trader_push_chunk(ps->trader, new_chunk, ps->source_multiplicity);
-				free(new_chunk);
-			}
-			else
-				chunk_destroy(&new_chunk);
+			input_chunk_release(&new_chunk);
 		}
 		else
 			res = -1;
@@ -226,15 +509,17 @@ int8_t psinstance_inject_chunk(struct psinstance * ps)
 }
 
 int8_t psinstance_handle_msg(struct psinstance * ps)
-	/* WARNING: this is a blocking function on the network socket */
+	/* receives one message; it would block on an idle socket, so callers
+	 * invoke it only once the socket polled readable (psinstance_poll_all,
+	 * psinstance_on_readable), which keeps the event loop non-blocking */
 {
-	uint8_t buff[MSG_BUFFSIZE];
+	uint8_t * buff = ps->rx_buff;
 	struct nodeID *remote = NULL;
-	struct chunk * c;
+	struct chunk c;
 	int len;
-	int8_t res = 0;
+	int8_t res = 0, duplicate, parsed;
 
-	len = recv_from_peer(ps->my_sock, &remote, buff, MSG_BUFFSIZE);
+	STAGE_TIMED(&ps->stages, STAGE_RECV, len = recv_from_peer(ps->my_sock, &remote, buff, MSG_BUFFSIZE));
 	if (len < 0) {
 		fprintf(stderr,"[ERROR] Error receiving message. Maybe larger than %d bytes\n", MSG_BUFFSIZE);
 		res = -1;
@@ -245,6 +530,7 @@ int8_t psinstance_handle_msg(struct psinstance * ps)
 			case MSG_TYPE_NEIGHBOURHOOD:
 			case MSG_TYPE_TOPOLOGY:
 				dtprintf("Topo message received:\n");
+				reg_signalling_receive(ps->measure, len);
 				topology_message_parse(ps->topology, remote, buff, len);
 				res = 1;
 				break;
@@ -254,22 +540,23 @@ int8_t psinstance_handle_msg(struct psinstance * ps)
 					dtprintf("\tDiscarded as playing source role\n");
 				else
 				{
-					c = chunk_trader_parse_chunk(ps->trader, remote, buff, len);
-					if (c)
+					STAGE_TIMED(&ps->stages, STAGE_PARSE_CHUNK, parsed = chunk_trader_parse_chunk(ps->trader, remote, buff, len, &c));
+					if (!parsed)
 					{
-						if (!chunk_trader_add_chunk(ps->trader, c))
+						duplicate = chunk_trader_shared_chunk(ps->trader, c.id) != NULL;
+						reg_chunk_download(ps->measure, remote, &c, duplicate);
+						if (!chunk_trader_add_chunk(ps->trader, &c))
 						{
-							reg_chunk_receive(ps->measure, c);
-							output_deliver(ps->chunk_out, c);
-							free(c);
-						} else
-							chunk_destroy(&c);
+							reg_chunk_receive(ps->measure, &c);
+							STAGE_TIMED(&ps->stages, STAGE_OUTPUT, output_deliver_shared(ps->chunk_out, chunk_trader_shared_chunk(ps->trader, c.id)));
+						}
 					}
 				}
 				res = 2;
 				break;
 			case MSG_TYPE_SIGNALLING:
 				dtprintf("Sign message received:\n");
+				reg_signalling_receive(ps->measure, len);
 				chunk_trader_msg_parse(ps->trader, remote, buff, len);
 				res = 3;
 				break;
@@ -283,6 +570,64 @@ int8_t psinstance_handle_msg(struct psinstance * ps)
 	return res;
 }
 
+void psinstance_handle_action(struct psinstance *ps, enum streaming_action action)
+{
+	switch (action) {
+		case OFFER_ACTION:
+			dtprintf("Offer time!\n");
+			psinstance_send_offer(ps);
+			dtprintf("interval: %lu\n", ps->chunk_offer_interval);
+			ps->chunk_offer_interval = chunk_trader_offer_interval(ps->trader);
+			streaming_timers_update_offer_time(&ps->timers, ps->chunk_offer_interval);
+			break;
+		case INJECT_ACTION:
+			dtprintf("Chunk seeding time!\n");
+			psinstance_inject_chunk(ps);
+			streaming_timers_update_chunk_time(&ps->timers, ps->chunk_time_interval);
+			break;
+		case PARSE_MSG_ACTION:
+			dtprintf("Got a message from the world!!\n");
+			psinstance_handle_msg(ps);
+			break;
+		case NO_ACTION:
+			dtprintf("Nothing happens...\n");
+		default:
+			break;
+	}
+}
+
+int8_t psinstance_fd_readable(int fd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+int8_t psinstance_input_readable(const struct psinstance * ps)
+{
+	int i;
+
+	for (i = 0; psinstance_is_source(ps) && i < FDSSIZE && ps->inc.fds[i] >= 0; i++)
+		if (psinstance_fd_readable(ps->inc.fds[i]))
+			return 1;
+	return 0;
+}
+
+int psinstance_wait4data(const struct nodeID * s, struct timeval * tout, const int * fds)
+	/* wait4data marks the user fds which are not ready with -2, so it
+	 * gets a copy: the input fds are polled again at the next call */
+{
+	int user_fds[FDSSIZE];
+	int i;
+
+	for (i = 0; fds && i < FDSSIZE - 1 && fds[i] >= 0; i++)
+		user_fds[i] = fds[i];
+	user_fds[i] = -1;
+	return wait4data(s, tout, i ? user_fds : NULL);
+}
+
 int psinstance_poll(struct psinstance *ps, suseconds_t delta)
 {
 	enum streaming_action required_action;
@@ -290,39 +635,94 @@ int psinstance_poll(struct psinstance *ps, suseconds_t delta)
 
 	if (ps)
 	{
+		mono_clock_update();
 		streaming_timers_set_timeout(&ps->timers, delta, psinstance_is_source(ps) && ps->inc.fds[0] == -1);
 		dtprintf("[DEBUG] timer: %lu %lu\n", ps->timers.sleep_timer.tv_sec, ps->timers.sleep_timer.tv_usec); 
-		data_state = wait4data(ps->my_sock, &(ps->timers.sleep_timer), ps->inc.fds);
-
-		required_action = streaming_timers_state_handler(&ps->timers, data_state, psinstance_is_source(ps));
-		switch (required_action) {
-			case OFFER_ACTION:
-				dtprintf("Offer time!\n");
-				psinstance_send_offer(ps);
-				dtprintf("interval: %lu\n", ps->chunk_offer_interval);
-				ps->chunk_offer_interval = chunk_trader_offer_interval(ps->trader);
-				streaming_timers_update_offer_time(&ps->timers, ps->chunk_offer_interval);
-				break;
-			case INJECT_ACTION:
-				dtprintf("Chunk seeding time!\n");
-				psinstance_inject_chunk(ps);
-				streaming_timers_update_chunk_time(&ps->timers, ps->chunk_time_interval);
-				break;
-			case PARSE_MSG_ACTION:
-				dtprintf("Got a message from the world!!\n");
-				psinstance_handle_msg(ps);
-				break;
-			case NO_ACTION:
-				dtprintf("Nothing happens...\n");
-			default:
-				break;
-		}
-		if (streaming_timers_update_flag(&ps->timers))
-				topology_update(ps->topology);
+		STAGE_TIMED(&ps->stages, STAGE_WAIT, data_state = psinstance_wait4data(ps->my_sock, &(ps->timers.sleep_timer), ps->inc.fds));
+		mono_clock_update();
+
+		required_action = streaming_timers_state_handler(&ps->timers, data_state, psinstance_timed_injection(ps));
+		psinstance_handle_action(ps, required_action);
+		streaming_timers_run_tasks(&ps->timers);
+		mono_clock_release();
 	}
 	return data_state;
 }
 
+int psinstance_poll_all(struct psinstance *ps, suseconds_t delta, struct psinstance_poll_summary * summary)
+{
+	struct psinstance_poll_summary sum;
+	enum streaming_action actions[2];
+	struct timeval no_wait;
+	int8_t net_ready;
+	int i, n;
+
+	memset(&sum, 0, sizeof(struct psinstance_poll_summary));
+	if (ps == NULL)
+		return -1;
+
+	mono_clock_update();
+	streaming_timers_set_timeout(&ps->timers, delta, psinstance_is_source(ps) && ps->inc.fds[0] == -1);
+	STAGE_TIMED(&ps->stages, STAGE_WAIT, sum.data_state = psinstance_wait4data(ps->my_sock, &(ps->timers.sleep_timer), ps->inc.fds));
+	mono_clock_update();
+
+	/* wait4data reports one ready source, the network first: the other
+	 * one is checked too, so that neither starves the other */
+	net_ready = sum.data_state == 1 || (sum.data_state == 2 && psinstance_fd_readable(ps->net_fd));
+	if (sum.data_state == 2 || (sum.data_state == 1 && psinstance_input_readable(ps)))
+	{
+		psinstance_handle_action(ps, INJECT_ACTION);
+		sum.injections++;
+	}
+	if (net_ready)
+		do {
+			psinstance_handle_action(ps, PARSE_MSG_ACTION);
+			sum.messages++;
+			timerclear(&no_wait);
+			mono_clock_update();
+		} while (sum.messages < ps->poll_budget && wait4data(ps->my_sock, &no_wait, NULL) == 1);
+	sum.budget_exhausted = sum.messages >= ps->poll_budget;
+
+	n = streaming_timers_expired(&ps->timers, psinstance_timed_injection(ps), actions);
+	for (i = 0; i < n; i++)
+	{
+		psinstance_handle_action(ps, actions[i]);
+		if (actions[i] == OFFER_ACTION)
+			sum.offers++;
+		else
+			sum.injections++;
+	}
+	sum.offer_first = n == 2 && actions[0] == OFFER_ACTION;
+
+	sum.tasks = streaming_timers_run_tasks(&ps->timers);
+
+	mono_clock_release();
+	if (summary)
+		*summary = sum;
+	return sum.messages + sum.offers + sum.injections + sum.tasks;
+}
+
+int psinstance_run_timers(struct psinstance * ps, suseconds_t * next)
+{
+	enum streaming_action actions[2];
+	int i, n;
+
+	if (ps == NULL)
+		return -1;
+
+	n = streaming_timers_expired(&ps->timers, psinstance_timed_injection(ps), actions);
+	for (i = 0; i < n; i++)
+		psinstance_handle_action(ps, actions[i]);
+	n += streaming_timers_run_tasks(&ps->timers);
+
+	if (next)
+	{
+		streaming_timers_set_timeout(&ps->timers, MAX_TIMERS_SLEEP, psinstance_is_source(ps) && ps->inc.fds[0] == -1);
+		*next = ps->timers.sleep_timer.tv_sec * 1000000 + ps->timers.sleep_timer.tv_usec;
+	}
+	return n;
+}
+
 int8_t psinstance_topology_update(const struct psinstance * ps)
 {
 	if (ps && ps->topology)
@@ -369,3 +769,175 @@ int psinstance_port(const struct psinstance *ps)
 		return node_port(ps->my_sock);
 	return res;
 }
+
+int8_t psinstance_set_clock(const char * config)
+{
+	struct tag * tags;
+	const char * tmp_str;
+	enum mono_clock_mode clock;
+	int8_t res = 0;
+
+	tags = grapes_config_parse(config);
+	tmp_str = grapes_config_value_str_default(tags, "clock", NULL);
+	if (tmp_str)
+	{
+		res = clock_mode_parse(tmp_str, &clock);
+		if (res == 0)
+			mono_clock_set_mode(clock);
+	}
+	free(tags);
+	return res;
+}
+
+int8_t psinstance_set_log(struct psinstance * ps, const char * config)
+{
+	return ps ? log_configure(&ps->log, config) : -1;
+}
+
+int psinstance_metrics(struct psinstance * ps, char * buff, int len)
+{
+	struct metrics_text t;
+	int res = -1;
+
+	if (ps)
+	{
+		memset(&t, 0, sizeof(struct metrics_text));
+		psinstance_metrics_snapshot(ps, &t);
+		res = t.len;
+		if (buff && len > 0)
+			snprintf(buff, len, "%s", t.buf ? t.buf : "");
+		metrics_text_deinit(&t);
+	}
+	return res;
+}
+
+int8_t psinstance_net_held(const struct psinstance * ps)
+{
+	struct timeval now;
+
+	mono_clock_now(&now);
+	return timercmp(&now, &(ps->net_resume), <);
+}
+
+int psinstance_net_flush(struct psinstance * ps)
+	/* sends queued messages until the shaper holds them back */
+{
+	struct timeval interval, now;
+	size_t len;
+	int n = 0;
+
+	while (n < ps->poll_budget && (len = net_helper_outqueue_length(ps->my_sock)) > 0)
+	{
+		timerclear(&interval);
+		net_helper_periodic(ps->my_sock, &interval);
+		if (net_helper_outqueue_length(ps->my_sock) < len)
+			n++;
+		if (timerisset(&interval))
+		{
+			mono_clock_now(&now);
+			timeradd(&now, &interval, &(ps->net_resume));
+			break;
+		}
+	}
+	return n;
+}
+
+int psinstance_fds(const struct psinstance * ps, struct psinstance_fd * fds, int len)
+{
+	int i, n = 0;
+
+	if (ps == NULL || fds == NULL)
+		return -1;
+
+	if (ps->net_fd >= 0 && n < len)
+	{
+		fds[n].fd = ps->net_fd;
+		fds[n].events = POLLIN;
+		if (net_helper_outqueue_length(ps->my_sock) > 0 && !psinstance_net_held(ps))
+			fds[n].events |= POLLOUT;
+		n++;
+	}
+	for (i = 0; psinstance_is_source(ps) && i < FDSSIZE && ps->inc.fds[i] >= 0 && n < len; i++)
+	{
+		fds[n].fd = ps->inc.fds[i];
+		fds[n].events = POLLIN;
+		n++;
+	}
+	return n;
+}
+
+suseconds_t psinstance_next_deadline(struct psinstance * ps)
+{
+	struct timeval now, delta;
+	suseconds_t next;
+
+	if (ps == NULL)
+		return -1;
+
+	streaming_timers_set_timeout(&ps->timers, MAX_TIMERS_SLEEP, psinstance_is_source(ps) && ps->inc.fds[0] == -1);
+	next = ps->timers.sleep_timer.tv_sec * 1000000 + ps->timers.sleep_timer.tv_usec;
+	if (net_helper_outqueue_length(ps->my_sock) > 0)
+	{
+		mono_clock_now(&now);
+		if (timercmp(&now, &(ps->net_resume), <))
+		{
+			timersub(&(ps->net_resume), &now, &delta);
+			if (delta.tv_sec * 1000000 + delta.tv_usec < next)
+				next = delta.tv_sec * 1000000 + delta.tv_usec;
+		} else
+			next = 0;
+	}
+	return next;
+}
+
+int psinstance_on_readable(struct psinstance * ps, int fd)
+{
+	int n = 0;
+
+	if (ps == NULL || fd < 0)
+		return -1;
+
+	mono_clock_update();
+	if (fd == ps->net_fd)
+		while (n < ps->poll_budget && psinstance_fd_readable(fd))
+		{
+			psinstance_handle_action(ps, PARSE_MSG_ACTION);
+			mono_clock_update();
+			n++;
+		}
+	else if (psinstance_is_source(ps) && psinstance_fd_readable(fd))
+	{
+		psinstance_handle_action(ps, INJECT_ACTION);
+		n++;
+	}
+	mono_clock_release();
+	return n;
+}
+
+int psinstance_on_writable(struct psinstance * ps)
+{
+	int n;
+
+	if (ps == NULL)
+		return -1;
+
+	mono_clock_update();
+	n = psinstance_net_held(ps) ? 0 : psinstance_net_flush(ps);
+	mono_clock_release();
+	return n;
+}
+
+int psinstance_on_timer(struct psinstance * ps)
+{
+	int n;
+
+	if (ps == NULL)
+		return -1;
+
+	mono_clock_update();
+	n = psinstance_run_timers(ps, NULL);
+	if (!psinstance_net_held(ps))
+		n += psinstance_net_flush(ps);
+	mono_clock_release();
+	return n;
+}
@@ -38,5 +38,14 @@ struct chunk_output * psinstance_output(const struct psinstance * ps);
 
 const struct chunk_trader * psinstance_trader(const struct psinstance * ps);
 
+/* NULL if tracing is not configured */
+struct tracer * psinstance_tracer(const struct psinstance * ps);
+
+/* chunk and signalling log rates of the instance */
+struct log_rates * psinstance_log_rates(const struct psinstance * ps);
+
+/* wait4data on s and on the -1 terminated fds, which are left untouched */
+int psinstance_wait4data(const struct nodeID * s, struct timeval * tout, const int * fds);
+
 
 #endif
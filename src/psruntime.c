@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<psruntime.h>
+#include<streaming_timers.h>
+#include<grapes_config.h>
+#include<mono_clock.h>
+#include<dbg.h>
+#include<malloc.h>
+#include<string.h>
+#include<unistd.h>
+#include<pthread.h>
+#include<sys/epoll.h>
+#include<sys/eventfd.h>
+
+#define MAX_EPOLL_EVENTS 64
+#define MAX_REACTOR_FDS (FDSSIZE + 1)
+
+struct runtime_entry;
+
+struct runtime_fd {
+	int fd;
+	struct runtime_entry * entry;
+};
+
+struct runtime_entry {
+	struct psinstance * ps;
+	struct reactor * r;
+	uint32_t task_id;
+	struct runtime_fd fds[MAX_REACTOR_FDS];
+	int fds_len;
+	int8_t removed;  // freed by the reactor once no event can refer to it
+	struct runtime_entry * next;
+};
+
+struct reactor {
+	int epfd;
+	int wakefd;
+	struct streaming_timers timers;  // only the task heap is used
+	struct runtime_entry * entries;
+	int entries_len;
+	pthread_mutex_t lock;
+	pthread_t thread;
+	volatile int8_t running;
+	suseconds_t max_wait;  // threaded mode only
+};
+
+struct psruntime {
+	struct reactor * reactors;
+	int reactors_len;
+	int8_t threaded;
+	int8_t started;
+};
+
+/** instance servicing **/
+suseconds_t runtime_entry_task(void * arg)
+{
+	struct runtime_entry * e = arg;
+
+	psinstance_on_timer(e->ps);
+	return psinstance_next_deadline(e->ps);
+}
+
+void runtime_entry_reschedule(struct runtime_entry * e)
+{
+	streaming_timers_remove_task(&(e->r->timers), e->task_id);
+	e->task_id = streaming_timers_add_task(&(e->r->timers), runtime_entry_task, e, psinstance_next_deadline(e->ps));
+}
+
+int runtime_fd_handle(struct runtime_fd * rfd)
+{
+	int n;
+
+	n = psinstance_on_readable(rfd->entry->ps, rfd->fd);
+	runtime_entry_reschedule(rfd->entry);
+	return n > 0 ? n : 0;
+}
+
+/** reactor **/
+int8_t reactor_init(struct reactor * r, suseconds_t max_wait)
+{
+	struct epoll_event ev;
+
+	memset(r, 0, sizeof(struct reactor));
+	r->max_wait = max_wait;
+	streaming_timers_init(&(r->timers), 0);
+	pthread_mutex_init(&(r->lock), NULL);
+	r->epfd = epoll_create1(0);
+	r->wakefd = eventfd(0, EFD_NONBLOCK);
+	if (r->epfd < 0 || r->wakefd < 0)
+		return -1;  // reactor_deinit releases whatever was acquired
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;  // wake up event
+	if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->wakefd, &ev))
+		return -1;
+	return 0;
+}
+
+void reactor_deinit(struct reactor * r)
+{
+	struct runtime_entry * e;
+
+	while (r->entries)
+	{
+		e = r->entries;
+		r->entries = e->next;
+		free(e);
+	}
+	streaming_timers_deinit(&(r->timers));
+	if (r->epfd >= 0)
+		close(r->epfd);
+	if (r->wakefd >= 0)
+		close(r->wakefd);
+	pthread_mutex_destroy(&(r->lock));
+}
+
+void reactor_reap(struct reactor * r)
+{
+	struct runtime_entry ** e, * tmp;
+
+	e = &(r->entries);
+	while (*e)
+		if ((*e)->removed)
+		{
+			tmp = *e;
+			*e = tmp->next;
+			free(tmp);
+		} else
+			e = &((*e)->next);
+}
+
+void reactor_wake(struct reactor * r)
+{
+	uint64_t one = 1;
+
+	if (write(r->wakefd, &one, sizeof(uint64_t)) < 0)
+		dtprintf("[DEBUG] cannot wake the reactor up\n");
+}
+
+int8_t runtime_entry_watch(struct runtime_entry * e, int fd)
+{
+	struct epoll_event ev;
+
+	if (e->fds_len >= MAX_REACTOR_FDS)
+		return -1;
+	e->fds[e->fds_len].fd = fd;
+	e->fds[e->fds_len].entry = e;
+	ev.events = EPOLLIN;  // writes are paced by the instance deadline
+	ev.data.ptr = &(e->fds[e->fds_len]);
+	if (epoll_ctl(e->r->epfd, EPOLL_CTL_ADD, fd, &ev))
+		return -1;
+	e->fds_len++;
+	return 0;
+}
+
+int reactor_run_once(struct reactor * r, suseconds_t max_wait)
+{
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	struct timeval now, delta;
+	struct runtime_fd * rfd;
+	uint64_t wakes;
+	int i, n, res = 0;
+	int timeout;
+
+	pthread_mutex_lock(&(r->lock));
+	timeout = (max_wait + 999) / 1000;  // a sub-millisecond wait must not become a busy poll
+	if (r->timers.tasks_len)
+	{
+		mono_clock_now(&now);
+		if (timercmp(&(r->timers.tasks[0].deadline), &now, >))
+		{
+			timersub(&(r->timers.tasks[0].deadline), &now, &delta);
+			if (delta.tv_sec * 1000 + (delta.tv_usec + 999) / 1000 < timeout)
+				timeout = delta.tv_sec * 1000 + (delta.tv_usec + 999) / 1000;  // we round up not to spin
+		} else
+			timeout = 0;
+	}
+	pthread_mutex_unlock(&(r->lock));
+
+	n = epoll_wait(r->epfd, events, MAX_EPOLL_EVENTS, timeout);
+
+	pthread_mutex_lock(&(r->lock));
+	for (i = 0; i < n; i++)
+	{
+		rfd = events[i].data.ptr;
+		if (rfd)
+		{
+			if (!rfd->entry->removed)
+				res += runtime_fd_handle(rfd);
+		} else
+			while (read(r->wakefd, &wakes, sizeof(uint64_t)) > 0);
+	}
+	res += streaming_timers_run_tasks(&(r->timers));
+	reactor_reap(r);
+	pthread_mutex_unlock(&(r->lock));
+
+	return n < 0 ? -1 : res;
+}
+
+void * reactor_thread(void * arg)
+{
+	struct reactor * r = arg;
+
+	while (r->running)
+		reactor_run_once(r, r->max_wait);
+	return NULL;
+}
+
+/** runtime **/
+struct psruntime * psruntime_create(const char * config)
+{
+	struct psruntime * rt;
+	struct tag * tags;
+	int threads, max_wait, i;
+
+	tags = grapes_config_parse(config);
+	grapes_config_value_int_default(tags, "threads", &threads, 0);
+	grapes_config_value_int_default(tags, "max_wait", &max_wait, DEFAULT_RUNTIME_MAX_WAIT);
+	free(tags);
+	if (psinstance_set_clock(config))
+		fprintf(stderr, "[WARNING] invalid runtime clock, keeping the current one\n");
+
+	rt = malloc(sizeof(struct psruntime));
+	rt->threaded = threads > 0;
+	rt->started = 0;
+	rt->reactors_len = threads > 0 ? threads : 1;
+	rt->reactors = malloc(sizeof(struct reactor) * rt->reactors_len);
+	for (i = 0; i < rt->reactors_len; i++)
+		if (reactor_init(rt->reactors + i, max_wait > 0 ? max_wait : DEFAULT_RUNTIME_MAX_WAIT) < 0)
+		{
+			fprintf(stderr, "[ERROR] cannot create the runtime reactors\n");
+			rt->reactors_len = i + 1;
+			psruntime_destroy(&rt);
+			break;
+		}
+	return rt;
+}
+
+void psruntime_destroy(struct psruntime ** rt)
+{
+	int i;
+
+	if (rt && *rt)
+	{
+		psruntime_stop(*rt);
+		for (i = 0; i < (*rt)->reactors_len; i++)
+			reactor_deinit((*rt)->reactors + i);
+		free((*rt)->reactors);
+		free(*rt);
+		*rt = NULL;
+	}
+}
+
+struct reactor * psruntime_least_loaded(struct psruntime * rt)
+{
+	int i;
+	struct reactor * r;
+
+	r = rt->reactors;
+	for (i = 1; i < rt->reactors_len; i++)
+		if (rt->reactors[i].entries_len < r->entries_len)
+			r = rt->reactors + i;
+	return r;
+}
+
+int8_t psruntime_add(struct psruntime * rt, struct psinstance * ps)
+{
+	struct runtime_entry * e;
+	struct reactor * r;
+	struct psinstance_fd fds[MAX_REACTOR_FDS];
+	int i, n;
+
+	if (rt == NULL || ps == NULL)
+		return -1;
+
+	r = psruntime_least_loaded(rt);
+	e = malloc(sizeof(struct runtime_entry));
+	memset(e, 0, sizeof(struct runtime_entry));
+	e->ps = ps;
+	e->r = r;
+
+	pthread_mutex_lock(&(r->lock));
+	n = psinstance_fds(ps, fds, MAX_REACTOR_FDS);
+	for (i = 0; i < n; i++)
+		runtime_entry_watch(e, fds[i].fd);
+	e->next = r->entries;
+	r->entries = e;
+	r->entries_len++;
+	e->task_id = streaming_timers_add_task(&(r->timers), runtime_entry_task, e, 0);
+	pthread_mutex_unlock(&(r->lock));
+
+	reactor_wake(r);
+	return 0;
+}
+
+int8_t psruntime_remove(struct psruntime * rt, struct psinstance * ps)
+{
+	struct runtime_entry * e;
+	struct reactor * r;
+	int i, j;
+
+	if (rt && ps)
+		for (i = 0; i < rt->reactors_len; i++)
+		{
+			r = rt->reactors + i;
+			pthread_mutex_lock(&(r->lock));
+			for (e = r->entries; e; e = e->next)
+				if (e->ps == ps && !e->removed)
+				{
+					/* the reactor may be sitting in epoll_wait with events
+					 * pointing to this entry; it frees it after dispatching them */
+					e->removed = 1;
+					r->entries_len--;
+					for (j = 0; j < e->fds_len; j++)
+						epoll_ctl(r->epfd, EPOLL_CTL_DEL, e->fds[j].fd, NULL);
+					streaming_timers_remove_task(&(r->timers), e->task_id);
+					pthread_mutex_unlock(&(r->lock));
+					return 0;
+				}
+			pthread_mutex_unlock(&(r->lock));
+		}
+	return -1;
+}
+
+int psruntime_instances(const struct psruntime * rt)
+{
+	int i, n = 0;
+
+	if (rt)
+		for (i = 0; i < rt->reactors_len; i++)
+			n += rt->reactors[i].entries_len;
+	return n;
+}
+
+int psruntime_run_once(struct psruntime * rt, suseconds_t max_wait)
+{
+	if (rt == NULL || rt->threaded)
+		return -1;
+	return reactor_run_once(rt->reactors, max_wait);
+}
+
+int8_t psruntime_start(struct psruntime * rt)
+{
+	int i;
+
+	if (rt == NULL || !rt->threaded || rt->started)
+		return -1;
+
+	for (i = 0; i < rt->reactors_len; i++)
+	{
+		rt->reactors[i].running = 1;
+		if (pthread_create(&(rt->reactors[i].thread), NULL, reactor_thread, rt->reactors + i))
+		{
+			rt->reactors[i].running = 0;
+			psruntime_stop(rt);
+			return -1;
+		}
+	}
+	rt->started = 1;
+	return 0;
+}
+
+void psruntime_stop(struct psruntime * rt)
+{
+	int i;
+
+	if (rt)
+		for (i = 0; i < rt->reactors_len; i++)
+			if (rt->reactors[i].running)
+			{
+				rt->reactors[i].running = 0;
+				reactor_wake(rt->reactors + i);
+				pthread_join(rt->reactors[i].thread, NULL);
+			}
+	if (rt)
+		rt->started = 0;
+}
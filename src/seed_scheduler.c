@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<string.h>
+#include<seed_scheduler.h>
+#include<grapes_config.h>
+#include<net_helper.h>
+#include<chunkidset.h>
+#include<peer_metadata.h>
+#include<dbg.h>
+
+struct seed_scheduler {
+	struct PeerChunk * pairs;
+	int8_t * excluded;
+	size_t size;
+
+	struct nodeID ** prev_seeds;
+	size_t prev_len;
+
+	int adaptive;
+	int multiplicity;
+	int max_multiplicity;
+	uint32_t chunk_counter;
+};
+
+struct seed_scheduler * seed_scheduler_create(const char * config)
+{
+	struct seed_scheduler * ss;
+	struct tag * tags;
+
+	ss = malloc(sizeof(struct seed_scheduler));
+	ss->pairs = NULL;
+	ss->excluded = NULL;
+	ss->prev_seeds = NULL;
+	ss->size = 0;
+	ss->prev_len = 0;
+	ss->chunk_counter = 0;
+
+	tags = grapes_config_parse(config);
+	grapes_config_value_int_default(tags, "adaptive_multiplicity", &(ss->adaptive), 0);
+	grapes_config_value_int_default(tags, "source_multiplicity", &(ss->multiplicity), 3);
+	grapes_config_value_int_default(tags, "max_source_multiplicity", &(ss->max_multiplicity), 2 * ss->multiplicity);
+	free(tags);
+
+	if (ss->multiplicity < 1)
+		ss->multiplicity = 1;
+	if (ss->max_multiplicity < ss->multiplicity)
+		ss->max_multiplicity = ss->multiplicity;
+	return ss;
+}
+
+void seed_scheduler_clear_prev(struct seed_scheduler * ss)
+{
+	size_t i;
+
+	for (i = 0; i < ss->prev_len; i++)
+		nodeid_free(ss->prev_seeds[i]);
+	ss->prev_len = 0;
+}
+
+void seed_scheduler_destroy(struct seed_scheduler ** ss)
+{
+	if (ss && *ss)
+	{
+		seed_scheduler_clear_prev(*ss);
+		if ((*ss)->pairs)
+			free((*ss)->pairs);
+		if ((*ss)->excluded)
+			free((*ss)->excluded);
+		if ((*ss)->prev_seeds)
+			free((*ss)->prev_seeds);
+		free(*ss);
+		*ss = NULL;
+	}
+}
+
+void seed_scheduler_reserve(struct seed_scheduler * ss, size_t n)
+{
+	if (n > ss->size)
+	{
+		ss->size = n;
+		ss->pairs = realloc(ss->pairs, sizeof(struct PeerChunk) * n);
+		ss->excluded = realloc(ss->excluded, sizeof(int8_t) * n);
+		ss->prev_seeds = realloc(ss->prev_seeds, sizeof(struct nodeID *) * n);
+	}
+}
+
+int8_t seed_scheduler_was_seed(const struct seed_scheduler * ss, const struct nodeID * id)
+{
+	size_t i;
+
+	for (i = 0; i < ss->prev_len; i++)
+		if (nodeid_equal(ss->prev_seeds[i], id))
+			return 1;
+	return 0;
+}
+
+struct PeerChunk * seed_scheduler_select(struct seed_scheduler * ss, struct peer ** peers, int n_peers, int cid, int multiplicity, peerEvaluateFunction weight, size_t * n_pairs)
+{
+	int i, best, available;
+	size_t k, m;
+	double total = 0, w;
+	double * credit;
+
+	*n_pairs = 0;
+	if (ss == NULL || peers == NULL || n_peers <= 0)
+		return NULL;
+
+	m = seed_scheduler_multiplicity(ss, multiplicity);
+	m = m < (size_t)n_peers ? m : (size_t)n_peers;
+	seed_scheduler_reserve(ss, n_peers);
+
+	available = n_peers;
+	for (i = 0; i < n_peers; i++)
+	{
+		ss->excluded[i] = seed_scheduler_was_seed(ss, peers[i]->id);
+		available -= ss->excluded[i];
+	}
+	if ((size_t)available < m)  // neighbourhood too small to avoid repetitions
+		memset(ss->excluded, 0, sizeof(int8_t) * n_peers);
+
+	for (k = 0; k < m; k++)
+	{
+		best = -1;
+		total = 0;
+		for (i = 0; i < n_peers; i++)
+			if ((credit = peer_seed_credit(peers[i])))
+			{
+				w = weight ? weight(&(peers[i])) : 1;
+				*credit += w;
+				total += w;
+				if (!ss->excluded[i] && (best < 0 || *credit > *peer_seed_credit(peers[best])))
+					best = i;
+			}
+		if (best < 0)
+			break;
+		*peer_seed_credit(peers[best]) -= total;
+		ss->excluded[best] = 1;
+		ss->pairs[k].peer = peers[best];
+		ss->pairs[k].chunk = cid;
+	}
+	*n_pairs = k;
+
+	seed_scheduler_clear_prev(ss);
+	for (k = 0; k < *n_pairs; k++)
+		ss->prev_seeds[ss->prev_len++] = nodeid_dup(ss->pairs[k].peer->id);
+
+	return ss->pairs;
+}
+
+int8_t seed_scheduler_adapt(struct seed_scheduler * ss, struct peer ** peers, int n_peers, int latest_cid)
+{
+	int i, cid, informed = 0, delivered = 0;
+	struct chunkID_set * bmap;
+	double ratio;
+
+	if (ss == NULL || !ss->adaptive || ++(ss->chunk_counter) < SEED_ADAPT_WINDOW)
+		return 0;
+	ss->chunk_counter = 0;
+
+	cid = latest_cid - SEED_DELIVERY_AGE;
+	for (i = 0; i < n_peers && cid >= 0; i++)
+	{
+		bmap = peer_bmap(peers[i]);
+		if (bmap && chunkID_set_size(bmap) > 0 && (int)chunkID_set_get_latest(bmap) >= cid)
+		{  // we only count peers whose buffermap is recent enough
+			informed++;
+			if (chunkID_set_check(bmap, cid) >= 0)
+				delivered++;
+		}
+	}
+	if (informed == 0)
+		return 0;
+
+	ratio = ((double)delivered) / informed;
+	if (ratio < SEED_DELIVERY_LOW && ss->multiplicity < ss->max_multiplicity)
+		ss->multiplicity++;
+	else if (ratio > SEED_DELIVERY_HIGH && ss->multiplicity > 1)
+		ss->multiplicity--;
+	dprintf("[DEBUG] seeding: delivery ratio %f on chunk %d -> multiplicity %d\n", ratio, cid, ss->multiplicity);
+	return 1;
+}
+
+int seed_scheduler_multiplicity(const struct seed_scheduler * ss, int base)
+{
+	if (ss && ss->adaptive)
+		return ss->multiplicity;
+	return base;
+}
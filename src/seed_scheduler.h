@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SEED_SCHEDULER_H__
+#define __SEED_SCHEDULER_H__
+
+#include<stdint.h>
+#include<stdlib.h>
+#include<peer.h>
+#include<scheduler_common.h>
+
+/* Source seeding scheduler. Seeds are rotated across the neighbourhood with
+ * a smooth weighted round robin (weights given by the peer evaluation
+ * function, e.g., capacity), so the seeding load is spread proportionally
+ * and the seeds of a chunk are never the ones of the previous chunk, as long
+ * as the neighbourhood is large enough. Optionally, the multiplicity follows
+ * the delivery ratio observed in the neighbour buffermaps. */
+
+#define SEED_ADAPT_WINDOW 10  // chunks between two multiplicity updates
+#define SEED_DELIVERY_AGE 10  // chunks, age of the chunk the delivery ratio is measured on
+#define SEED_DELIVERY_LOW 0.9
+#define SEED_DELIVERY_HIGH 0.98
+
+struct seed_scheduler;
+
+struct seed_scheduler * seed_scheduler_create(const char * config);
+
+void seed_scheduler_destroy(struct seed_scheduler ** ss);
+
+/* selects the seeds of chunk cid; the returned array is owned by the
+ * scheduler and it is valid until the next call */
+struct PeerChunk * seed_scheduler_select(struct seed_scheduler * ss, struct peer ** peers, int n_peers, int cid, int multiplicity, peerEvaluateFunction weight, size_t * n_pairs);
+
+/* updates the multiplicity once every SEED_ADAPT_WINDOW chunks
+ * returns 1 if the multiplicity has been re-evaluated, 0 otherwise */
+int8_t seed_scheduler_adapt(struct seed_scheduler * ss, struct peer ** peers, int n_peers, int latest_cid);
+
+/* current multiplicity, base if not adaptive or not initialized yet */
+int seed_scheduler_multiplicity(const struct seed_scheduler * ss, int base);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<string.h>
+#include<shared_chunk.h>
+#include<net_helpers.h>
+#include<int_coding.h>
+#include<grapes_msg_types.h>
+
+#define CHUNK_WIRE_HEADER_SIZE 23  // message type, transaction ID and chunk header
+
+struct shared_chunk {
+	struct chunk c;  // payload and attributes point into wire
+	uint32_t refs;
+	struct shared_chunk_pool * pool;
+	size_t capacity;  // wire bytes
+	size_t wire_len;
+	uint8_t wire[];
+};
+
+struct shared_chunk_pool {
+	struct shared_chunk ** free_blocks;
+	int free_len;
+	int max_free;
+	size_t block_size;
+	uint32_t refs;  // the owner and every block it handed out
+	int8_t orphan;  // the owner is gone
+};
+
+void shared_chunk_pool_release(struct shared_chunk_pool ** p)
+{
+	int i;
+
+	if (p && *p && --((*p)->refs) == 0)
+	{
+		for (i = 0; i < (*p)->free_len; i++)
+			free((*p)->free_blocks[i]);
+		free((*p)->free_blocks);
+		free(*p);
+	}
+	if (p)
+		*p = NULL;
+}
+
+struct shared_chunk_pool * shared_chunk_pool_create(size_t block_size, int max_free)
+{
+	struct shared_chunk_pool * p = NULL;
+
+	if (max_free >= 0)
+	{
+		p = malloc(sizeof(struct shared_chunk_pool));
+		p->block_size = block_size + CHUNK_WIRE_HEADER_SIZE;
+		p->max_free = max_free;
+		p->free_len = 0;
+		p->free_blocks = max_free ? malloc(sizeof(struct shared_chunk *) * max_free) : NULL;
+		p->refs = 1;
+		p->orphan = 0;
+	}
+	return p;
+}
+
+void shared_chunk_pool_destroy(struct shared_chunk_pool ** p)
+{
+	if (p && *p)
+		(*p)->orphan = 1;
+	shared_chunk_pool_release(p);
+}
+
+struct shared_chunk * shared_chunk_alloc(struct shared_chunk_pool * pool, size_t wire_len)
+{
+	struct shared_chunk * sc;
+
+	if (pool && wire_len <= pool->block_size)
+	{
+		if (pool->free_len)
+			sc = pool->free_blocks[--(pool->free_len)];
+		else
+		{
+			sc = malloc(sizeof(struct shared_chunk) + pool->block_size);
+			sc->capacity = pool->block_size;
+		}
+		sc->pool = pool;
+		pool->refs++;
+	} else {
+		sc = malloc(sizeof(struct shared_chunk) + wire_len);
+		sc->capacity = wire_len;
+		sc->pool = NULL;
+	}
+	return sc;
+}
+
+struct shared_chunk * shared_chunk_create(struct shared_chunk_pool * pool, const struct chunk * c)
+{
+	struct shared_chunk * sc = NULL;
+	uint8_t * ptr;
+	int attr_size;
+
+	if (c && c->size >= 0)
+	{
+		attr_size = c->attributes ? c->attributes_size : 0;
+		sc = shared_chunk_alloc(pool, CHUNK_WIRE_HEADER_SIZE + c->size + attr_size);
+		sc->refs = 1;
+		sc->wire_len = CHUNK_WIRE_HEADER_SIZE + c->size + attr_size;
+		sc->c = *c;
+		sc->c.attributes_size = attr_size;
+
+		ptr = sc->wire;
+		ptr[0] = MSG_TYPE_CHUNK;
+		int16_cpy(ptr + 1, 0);  // transaction ID, set in a copy upon sending
+		ptr += 3;
+		int_cpy(ptr, c->id);
+		int_cpy(ptr + 4, c->timestamp >> 32);
+		int_cpy(ptr + 8, c->timestamp & 0xffffffff);
+		int_cpy(ptr + 12, c->size);
+		int_cpy(ptr + 16, attr_size);
+
+		sc->c.data = sc->wire + CHUNK_WIRE_HEADER_SIZE;
+		if (c->size && c->data)
+			memcpy(sc->c.data, c->data, c->size);
+		sc->c.attributes = attr_size ? sc->c.data + c->size : NULL;
+		if (attr_size)
+			memcpy(sc->c.attributes, c->attributes, attr_size);
+	}
+	return sc;
+}
+
+struct shared_chunk * shared_chunk_ref(struct shared_chunk * sc)
+{
+	if (sc)
+		sc->refs++;
+	return sc;
+}
+
+void shared_chunk_unref(struct shared_chunk ** sc)
+{
+	struct shared_chunk_pool * pool;
+
+	if (sc && *sc)
+	{
+		if (--((*sc)->refs) == 0)
+		{
+			pool = (*sc)->pool;
+			if (pool && !pool->orphan && pool->free_len < pool->max_free)
+				pool->free_blocks[pool->free_len++] = *sc;
+			else
+				free(*sc);
+			shared_chunk_pool_release(&pool);
+		}
+		*sc = NULL;
+	}
+}
+
+uint32_t shared_chunk_refs(const struct shared_chunk * sc)
+{
+	return sc ? sc->refs : 0;
+}
+
+const struct chunk * shared_chunk_get(const struct shared_chunk * sc)
+{
+	return sc ? &(sc->c) : NULL;
+}
+
+int shared_chunk_send(const struct shared_chunk * sc, struct nodeID * from, const struct nodeID * to, uint16_t transid)
+{
+	uint8_t header[CHUNK_WIRE_HEADER_SIZE];
+	struct iovec iov[2];
+
+	if (sc == NULL)
+		return -1;
+	memcpy(header, sc->wire, CHUNK_WIRE_HEADER_SIZE);  // the block is never written
+	int16_cpy(header + 1, transid);
+	iov[0].iov_base = header;
+	iov[0].iov_len = CHUNK_WIRE_HEADER_SIZE;
+	iov[1].iov_base = (void *) (sc->wire + CHUNK_WIRE_HEADER_SIZE);
+	iov[1].iov_len = sc->wire_len - CHUNK_WIRE_HEADER_SIZE;
+	return send_to_peerv(from, to, iov, 2);
+}
+
+size_t shared_chunk_footprint(const struct shared_chunk * sc)
+{
+	return sc ? sizeof(struct shared_chunk) + sc->capacity : 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SHARED_CHUNK_H__
+#define __SHARED_CHUNK_H__
+
+#include<stdint.h>
+#include<stdlib.h>
+#include<chunk.h>
+#include<net_helper.h>
+
+/* Reference counted, immutable chunk. A single allocation holds the chunk
+ * in its GRAPES wire format (message type, transaction ID, chunk header,
+ * payload and attributes), so that the trading buffer, the output reorder
+ * buffer and the forwarding to every neighbour share it with no further
+ * copies. Blocks can be recycled through a pool, which lives until its
+ * owner destroys it and the last of its blocks is released. */
+
+struct shared_chunk;
+
+struct shared_chunk_pool;
+
+/* keeps at most max_free released blocks of block_size bytes of chunk
+ * payload and attributes; larger chunks are allocated on demand */
+struct shared_chunk_pool * shared_chunk_pool_create(size_t block_size, int max_free);
+
+void shared_chunk_pool_destroy(struct shared_chunk_pool ** p);
+
+/* copies c into a new shared chunk with one reference; pool may be NULL */
+struct shared_chunk * shared_chunk_create(struct shared_chunk_pool * pool, const struct chunk * c);
+
+struct shared_chunk * shared_chunk_ref(struct shared_chunk * sc);
+
+void shared_chunk_unref(struct shared_chunk ** sc);
+
+uint32_t shared_chunk_refs(const struct shared_chunk * sc);
+
+/* the returned chunk, payload and attributes must not be modified */
+const struct chunk * shared_chunk_get(const struct shared_chunk * sc);
+
+/* sends the chunk message straight from the shared block, equivalent to
+ * GRAPES sendChunk; the transaction ID goes in a per-send copy of the
+ * header */
+int shared_chunk_send(const struct shared_chunk * sc, struct nodeID * from, const struct nodeID * to, uint16_t transid);
+
+/* bytes held by the block, headers included */
+size_t shared_chunk_footprint(const struct shared_chunk * sc);
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include<errno.h>
+#include<sys/timerfd.h>
+#include<source_pacer.h>
+#include<mono_clock.h>
+
+struct source_pacer {
+	int fd;
+	uint64_t deadline;
+	int8_t armed;
+	struct source_pacer_stats stats;
+};
+
+struct source_pacer * source_pacer_create(void)
+{
+	struct source_pacer * sp = NULL;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd >= 0)
+	{
+		sp = malloc(sizeof(struct source_pacer));
+		memset(sp, 0, sizeof(struct source_pacer));
+		sp->fd = fd;
+	}
+	return sp;
+}
+
+void source_pacer_destroy(struct source_pacer ** sp)
+{
+	if (sp && *sp)
+	{
+		close((*sp)->fd);
+		free(*sp);
+		*sp = NULL;
+	}
+}
+
+int source_pacer_fd(const struct source_pacer * sp)
+{
+	return sp ? sp->fd : -1;
+}
+
+int8_t source_pacer_arm(struct source_pacer * sp, uint64_t deadline)
+{
+	struct itimerspec its;
+	struct timeval now;
+	uint64_t now_us;
+
+	if (sp == NULL)
+		return -1;
+	memset(&its, 0, sizeof(struct itimerspec));
+	its.it_value.tv_sec = deadline / 1000000;
+	its.it_value.tv_nsec = (deadline % 1000000) * 1000;
+	if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+		its.it_value.tv_nsec = 1;  // a zero value would disarm the timer
+	if (timerfd_settime(sp->fd, TFD_TIMER_ABSTIME, &its, NULL))
+		return -1;
+	mono_clock_precise(&now);
+	now_us = now.tv_sec * 1000000ULL + now.tv_usec;
+	sp->deadline = deadline > now_us ? deadline : now_us;  // lateness of the wake-up only
+	sp->armed = 1;
+	return 0;
+}
+
+int8_t source_pacer_expired(struct source_pacer * sp)
+{
+	struct timeval now;
+	uint64_t expirations;
+	int64_t lateness, d;
+
+	if (sp == NULL)
+		return -1;
+	if (read(sp->fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t))
+		return errno == EAGAIN && sp->armed ? 0 : -1;
+
+	sp->armed = 0;
+	mono_clock_precise(&now);
+	lateness = (int64_t) (now.tv_sec * 1000000ULL + now.tv_usec) - (int64_t) sp->deadline;
+	if (lateness < 0)
+		lateness = 0;  // expired deadlines are in the past by definition
+	if (sp->stats.ticks++)
+	{
+		d = lateness - sp->stats.lateness;
+		sp->stats.jitter += ((d < 0 ? -d : d) - sp->stats.jitter) / 16;
+	}
+	sp->stats.lateness = lateness;
+	if (lateness > sp->stats.max_lateness)
+		sp->stats.max_lateness = lateness;
+	return 1;
+}
+
+void source_pacer_stats(const struct source_pacer * sp, struct source_pacer_stats * stats)
+{
+	if (sp && stats)
+		*stats = sp->stats;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SOURCE_PACER_H__
+#define __SOURCE_PACER_H__
+
+#include<stdint.h>
+
+/* Absolute deadline, high resolution wake-up for the source chunk
+ * injections, based on a CLOCK_MONOTONIC timerfd. Deadlines are the ones
+ * of the mono_clock precise clock, so they are computed from the media
+ * timestamps and do not accumulate the event loop delays. */
+
+struct source_pacer;
+
+struct source_pacer_stats {
+	uint64_t ticks;
+	int64_t lateness;  // of the last wake-up, microseconds
+	int64_t max_lateness;
+	int64_t jitter;  // mean deviation of the lateness (RFC 3550)
+};
+
+/* returns NULL if timerfds are not available */
+struct source_pacer * source_pacer_create(void);
+
+void source_pacer_destroy(struct source_pacer ** sp);
+
+/* becomes readable at the deadline */
+int source_pacer_fd(const struct source_pacer * sp);
+
+/* deadline is in microseconds of the monotonic clock, past deadlines
+ * expire immediately */
+int8_t source_pacer_arm(struct source_pacer * sp, uint64_t deadline);
+
+/* returns 1 and updates the statistics if the deadline has passed, 0 if
+ * not, -1 on error */
+int8_t source_pacer_expired(struct source_pacer * sp);
+
+void source_pacer_stats(const struct source_pacer * sp, struct source_pacer_stats * stats);
+
+#endif
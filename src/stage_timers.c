@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<string.h>
+#include<stage_timers.h>
+
+static const char * stage_names[STAGES] = {"wait", "recv", "parse_chunk", "output", "offer", "topology"};
+
+uint64_t stage_timers_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void stage_timers_init(struct stage_timers * st)
+{
+	int i;
+
+	for (i = 0; i < STAGES; i++)
+		histogram_reset(&st->h[i]);
+	st->ns0 = stage_timers_ns();
+	st->ticks0 = stage_clock();
+}
+
+void stage_timers_add(struct stage_timers * st, enum stage s, uint64_t ticks)
+{
+	if (st && s < STAGES)
+		histogram_add(&st->h[s], ticks);
+}
+
+double stage_timers_tick_ns(const struct stage_timers * st)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint64_t ns, ticks;
+
+	ns = stage_timers_ns() - st->ns0;
+	ticks = stage_clock() - st->ticks0;
+	return ns && ticks ? (double) ns / ticks : 0;
+#else
+	return 1;
+#endif
+}
+
+int8_t stage_timers_summary(const struct stage_timers * st, enum stage s, struct stage_summary * sum)
+{
+	double tick_ns;
+
+	if (st == NULL || s >= STAGES || sum == NULL)
+		return -1;
+	tick_ns = stage_timers_tick_ns(st);
+	sum->count = st->h[s].count;
+	sum->sum = st->h[s].sum * tick_ns;
+	sum->p50 = histogram_percentile(&st->h[s], 50) * tick_ns;
+	sum->p99 = histogram_percentile(&st->h[s], 99) * tick_ns;
+	sum->max = st->h[s].max * tick_ns;
+	return 0;
+}
+
+const char * stage_name(enum stage s)
+{
+	return s < STAGES ? stage_names[s] : "unknown";
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __STAGE_TIMERS_H__
+#define __STAGE_TIMERS_H__
+
+#include<stdint.h>
+#include<time.h>
+#include<histogram.h>
+
+/* Per-stage latency histograms of the streaming loop. The timed stages
+ * are compiled in with STAGE_TIMERS only (make STAGE_TIMERS=1), otherwise
+ * STAGE_TIMED runs the statement and nothing else. Durations are taken in
+ * TSC cycles where available (x86-64), in nanoseconds otherwise, and are
+ * converted to nanoseconds when read, with a cycle rate calibrated on the
+ * monotonic clock since stage_timers_init. */
+
+enum stage {STAGE_WAIT, STAGE_RECV, STAGE_PARSE_CHUNK, STAGE_OUTPUT, STAGE_OFFER, STAGE_TOPOLOGY, STAGES};
+
+struct stage_timers {
+	struct histogram h[STAGES];  // clock ticks
+	uint64_t ticks0;  // calibration start
+	uint64_t ns0;
+};
+
+struct stage_summary {
+	uint64_t count;
+	double sum;  // nanoseconds
+	double p50;
+	double p99;
+	double max;
+};
+
+static inline uint64_t stage_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#ifdef STAGE_TIMERS
+#define STAGE_TIMERS_ENABLED 1
+#define STAGE_TIMED(st, s, stmt) do { uint64_t __stage_start = stage_clock(); stmt; stage_timers_add((st), (s), stage_clock() - __stage_start); } while (0)
+#else
+#define STAGE_TIMERS_ENABLED 0
+#define STAGE_TIMED(st, s, stmt) do { stmt; } while (0)
+#endif
+
+void stage_timers_init(struct stage_timers * st);
+
+void stage_timers_add(struct stage_timers * st, enum stage s, uint64_t ticks);
+
+/* nanoseconds per clock tick */
+double stage_timers_tick_ns(const struct stage_timers * st);
+
+int8_t stage_timers_summary(const struct stage_timers * st, enum stage s, struct stage_summary * sum);
+
+const char * stage_name(enum stage s);
+
+#endif
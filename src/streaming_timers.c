@@ -21,6 +21,7 @@
 #include<streaming_timers.h>
 #include<malloc.h>
 #include<dbg.h>
+#include<mono_clock.h>
 
 void usec2timeval(struct timeval *t, suseconds_t usec)
 {	
@@ -39,23 +40,40 @@ void timeradd_interval(struct timeval * dst, const suseconds_t interval)
 
 int streaming_timers_init(struct streaming_timers * psl, suseconds_t offer_interval)
 {
-	gettimeofday(&(psl->awake_epoch), NULL);
+	mono_clock_now(&(psl->awake_epoch));
 	psl->offer_epoch = psl->awake_epoch;
 	timeradd_interval(&(psl->offer_epoch), offer_interval);
 	psl->chunk_epoch = psl->awake_epoch;
+	psl->tasks = NULL;
+	psl->tasks_len = 0;
+	psl->tasks_size = 0;
+	psl->last_task_id = 0;
 	return 0;
 }
 
+void streaming_timers_deinit(struct streaming_timers * psl)
+{
+	if (psl && psl->tasks)
+	{
+		free(psl->tasks);
+		psl->tasks = NULL;
+		psl->tasks_len = 0;
+		psl->tasks_size = 0;
+	}
+}
+
 void streaming_timers_set_timeout(struct streaming_timers * psl, suseconds_t interval, int8_t userfds)
 {
 	struct timeval tnow;
 	struct timeval delta;
 
 	psl->awake_epoch = psl->offer_epoch;
-	if (userfds && timercmp(&(psl->chunk_epoch), &(psl->offer_epoch), <))
+	if (userfds && timercmp(&(psl->chunk_epoch), &(psl->awake_epoch), <))
 		psl->awake_epoch = psl->chunk_epoch;
+	if (psl->tasks_len && timercmp(&(psl->tasks[0].deadline), &(psl->awake_epoch), <))
+		psl->awake_epoch = psl->tasks[0].deadline;
 
-	gettimeofday(&tnow, NULL);
+	mono_clock_now(&tnow);
 	if (timercmp(&tnow, &(psl->awake_epoch), >))
 	{
 		psl->sleep_timer.tv_sec = 0;
@@ -79,7 +97,7 @@ enum streaming_action streaming_timers_state_handler(struct streaming_timers * p
 			dtprintf("Invalid data state!\n");
 			break;
 		case 0: // timeout, no socket has data to pick
-			gettimeofday(&current_epoch, NULL);
+			mono_clock_now(&current_epoch);
 			if (source_role && timercmp(&(psl->chunk_epoch), &current_epoch, <)) // chunk seeding time! 
 				action = INJECT_ACTION;
 			else 
@@ -94,27 +112,154 @@ enum streaming_action streaming_timers_state_handler(struct streaming_timers * p
 			break;
 	}
 
-	psl->loop_counter++;
 	return action;
 }
 
-int8_t streaming_timers_update_flag(struct streaming_timers * psl)
+void streaming_timers_update_chunk_time(struct streaming_timers * psl, suseconds_t interval)
+{
+	timeradd_interval(&(psl->chunk_epoch), interval);
+}
+
+void streaming_timers_update_offer_time(struct streaming_timers * psl, suseconds_t interval)
+{
+	timeradd_interval(&(psl->offer_epoch), interval);
+}
+
+int streaming_timers_expired(struct streaming_timers * psl, int8_t source_role, enum streaming_action * actions)
 {
-	if (psl->loop_counter >= UPDATE_EPOCH)
+	struct timeval current_epoch;
+	int n = 0;
+
+	mono_clock_now(&current_epoch);
+	if (source_role && timercmp(&(psl->chunk_epoch), &current_epoch, <))
+		actions[n++] = INJECT_ACTION;
+	if (timercmp(&(psl->offer_epoch), &current_epoch, <))
 	{
-		psl->loop_counter = 0;
-		return 1;
+		if (n && timercmp(&(psl->offer_epoch), &(psl->chunk_epoch), <))
+		{
+			actions[1] = actions[0];
+			actions[0] = OFFER_ACTION;
+		} else
+			actions[n] = OFFER_ACTION;
+		n++;
 	}
-	return 0;
+	return n;
 }
 
-void streaming_timers_update_chunk_time(struct streaming_timers * psl, suseconds_t interval)
+void tasks_swap(struct streaming_task * tasks, size_t i, size_t j)
 {
-	timeradd_interval(&(psl->chunk_epoch), interval);
+	struct streaming_task tmp;
+
+	tmp = tasks[i];
+	tasks[i] = tasks[j];
+	tasks[j] = tmp;
 }
 
-void streaming_timers_update_offer_time(struct streaming_timers * psl, suseconds_t interval)
+void tasks_sift_up(struct streaming_task * tasks, size_t i)
 {
-	timeradd_interval(&(psl->offer_epoch), interval);
+	while (i > 0 && timercmp(&(tasks[i].deadline), &(tasks[(i-1)/2].deadline), <))
+	{
+		tasks_swap(tasks, i, (i-1)/2);
+		i = (i-1)/2;
+	}
 }
 
+void tasks_sift_down(struct streaming_task * tasks, size_t len, size_t i)
+{
+	size_t min;
+
+	while (2*i + 1 < len)
+	{
+		min = 2*i + 1;
+		if (min + 1 < len && timercmp(&(tasks[min+1].deadline), &(tasks[min].deadline), <))
+			min++;
+		if (!timercmp(&(tasks[min].deadline), &(tasks[i].deadline), <))
+			break;
+		tasks_swap(tasks, i, min);
+		i = min;
+	}
+}
+
+void tasks_push(struct streaming_timers * psl, const struct streaming_task * t)
+{
+	if (psl->tasks_len == psl->tasks_size)
+	{
+		psl->tasks_size = psl->tasks_size ? psl->tasks_size * 2 : 8;
+		psl->tasks = realloc(psl->tasks, sizeof(struct streaming_task) * psl->tasks_size);
+	}
+	psl->tasks[psl->tasks_len] = *t;
+	tasks_sift_up(psl->tasks, psl->tasks_len++);
+}
+
+void tasks_remove_at(struct streaming_timers * psl, size_t i)
+{
+	psl->tasks[i] = psl->tasks[--(psl->tasks_len)];
+	if (i < psl->tasks_len)
+	{
+		tasks_sift_down(psl->tasks, psl->tasks_len, i);
+		tasks_sift_up(psl->tasks, i);
+	}
+}
+
+uint32_t streaming_timers_add_task(struct streaming_timers * psl, streaming_task_f task, void * arg, suseconds_t delay)
+{
+	struct streaming_task t;
+
+	if (psl == NULL || task == NULL || delay < 0)
+		return 0;
+
+	mono_clock_now(&(t.deadline));
+	timeradd_interval(&(t.deadline), delay);
+	t.task = task;
+	t.arg = arg;
+	t.id = ++(psl->last_task_id) ? psl->last_task_id : ++(psl->last_task_id);
+	tasks_push(psl, &t);
+	return t.id;
+}
+
+int8_t streaming_timers_remove_task(struct streaming_timers * psl, uint32_t id)
+{
+	size_t i;
+
+	if (psl && id)
+		for (i = 0; i < psl->tasks_len; i++)
+			if (psl->tasks[i].id == id)
+			{
+				tasks_remove_at(psl, i);
+				return 0;
+			}
+	return -1;
+}
+
+int streaming_timers_run_tasks(struct streaming_timers * psl)
+{
+	struct streaming_task t;
+	struct timeval now;
+	suseconds_t interval;
+	size_t budget;
+	int n = 0;
+
+	if (psl == NULL)
+		return 0;
+
+	mono_clock_now(&now);
+	budget = psl->tasks_len;  // each task runs at most once per call
+	while (budget-- && psl->tasks_len && !timercmp(&now, &(psl->tasks[0].deadline), <))
+	{
+		t = psl->tasks[0];
+		tasks_remove_at(psl, 0);
+		interval = t.task(t.arg);
+		n++;
+		if (interval >= 0)
+		{
+			timeradd_interval(&(t.deadline), interval);
+			if (timercmp(&(t.deadline), &now, <))  // we are late, we skip the missed runs
+			{
+				t.deadline = now;
+				timeradd_interval(&(t.deadline), interval);
+			}
+			tasks_push(psl, &t);
+		}
+	}
+	return n;
+}
@@ -23,29 +23,55 @@
 
 #include<sys/time.h>
 #include<stdint.h>
-
-#define UPDATE_EPOCH 10
+#include<stddef.h>
 
 enum streaming_action {OFFER_ACTION, INJECT_ACTION, PARSE_MSG_ACTION, NO_ACTION};
 
+/* periodic task callback, returns the delay before the next run in
+ * microseconds (negative to unregister the task) */
+typedef suseconds_t (*streaming_task_f)(void * arg);
+
+struct streaming_task {
+	struct timeval deadline;
+	streaming_task_f task;
+	void * arg;
+	uint32_t id;
+};
+
 struct streaming_timers {
 	struct timeval sleep_timer;
 	struct timeval awake_epoch;
 	struct timeval offer_epoch;
 	struct timeval chunk_epoch;
-	uint32_t loop_counter;
+	struct streaming_task * tasks;  // min-heap on deadline
+	size_t tasks_len;
+	size_t tasks_size;
+	uint32_t last_task_id;
 };
 
 int streaming_timers_init(struct streaming_timers * psl, suseconds_t offer_interval);
 
+void streaming_timers_deinit(struct streaming_timers * psl);
+
 void streaming_timers_set_timeout(struct streaming_timers * psl, suseconds_t interval, int8_t userfds);
 
 enum streaming_action streaming_timers_state_handler(struct streaming_timers * psl, int data_state, int8_t source_role);
 
-int8_t streaming_timers_update_flag(struct streaming_timers * psl);
-
 void streaming_timers_update_chunk_time(struct streaming_timers * psl, suseconds_t interval);
 
 void streaming_timers_update_offer_time(struct streaming_timers * psl, suseconds_t interval);
 
+/* fills actions with the expired timer actions (at most 2), ordered by
+ * deadline; returns their number */
+int streaming_timers_expired(struct streaming_timers * psl, int8_t source_role, enum streaming_action * actions);
+
+/* schedules task to run after delay microseconds; returns the task id,
+ * 0 on error */
+uint32_t streaming_timers_add_task(struct streaming_timers * psl, streaming_task_f task, void * arg, suseconds_t delay);
+
+int8_t streaming_timers_remove_task(struct streaming_timers * psl, uint32_t id);
+
+/* runs the expired tasks in deadline order; returns their number */
+int streaming_timers_run_tasks(struct streaming_timers * psl);
+
 #endif
@@ -41,6 +41,7 @@
 #include "measures.h"
 #include "chunk_trader.h"
 #include "peer_metadata.h"
+#include "mono_clock.h"
 
 extern peer_deinit_f peer_deinit;
 extern peer_init_f peer_init;
@@ -271,14 +272,16 @@ void topology_blacklist_add(struct topology * t, struct nodeID * id)
 
 void neighbourhood_drop_unactives(struct topology * t, struct timeval * bmap_timeout)
 {
-  struct timeval tnow, told;
+  struct timeval tnow, told, told_wall;
 	struct peer *const *peers;
 	int i;
-  gettimeofday(&tnow, NULL);
+  gettimeofday(&tnow, NULL);  // peer creation timestamps come from the wall clock
+  timersub(&tnow, bmap_timeout, &told_wall);
+  mono_clock_now(&tnow);
   timersub(&tnow, bmap_timeout, &told);
   peers = peerset_get_peers(t->neighbourhood);
   for (i = 0; i < peerset_size(t->neighbourhood); i++) {
-    if ((!timerisset(peer_bmap_timestamp(peers[i])) && timercmp(peer_creation_timestamp(peers[i]), &told, <) ) ||
+    if ((!timerisset(peer_bmap_timestamp(peers[i])) && timercmp(peer_creation_timestamp(peers[i]), &told_wall, <) ) ||
          ( timerisset(peer_bmap_timestamp(peers[i])) && timercmp(peer_bmap_timestamp(peers[i]), &told, <)     )   ) {
       dprintf("Topo: dropping inactive %s (peersset_size: %d)\n", nodeid_static_str(peers[i]->id), peerset_size(t->neighbourhood));
 //      if (peerset_size(t->neighbourhood) > 1) {	// avoid dropping our last link to the world
@@ -304,11 +307,21 @@ void array_shuffle(void *base, int nmemb, int size) {
 }
 
 double get_rtt_of(struct topology *t, const struct nodeID* n){
-  return NAN;
+  struct peer * p;
+  double rtt;
+
+  p = topology_get_peer(t, n);
+  rtt = peer_rtt(p);
+  return rtt < 0 ? NAN : rtt;
 }
 
 double get_capacity_of(struct topology *t, const struct nodeID* n){
-  return NAN;
+  struct peer * p;
+  double capacity;
+
+  p = topology_get_peer(t, n);
+  capacity = peer_capacity(p);
+  return capacity < 0 ? NAN : capacity;
 }
 
 int neighbourhood_send_msg(struct topology *t, const struct peer * p,uint8_t type)
@@ -453,13 +466,18 @@ void topology_update_random(struct topology * t)
 }
 
 
+void topology_sampler_periodic(struct topology * t)
+{
+	psample_parse_data(t->tc,NULL,0); // needed in order to trigger timed sending of TOPO messages
+}
+
 void topology_update(struct topology * t)
 {
 	struct peerset * old_neighs;
 	const struct peer * p;
 	int i;
 
-	psample_parse_data(t->tc,NULL,0); // needed in order to trigger timed sending of TOPO messages
+	topology_sampler_periodic(t);
 
 	update_metadata(t);
 	topology_sample_peers(t);
@@ -36,8 +36,11 @@ void topology_destroy(struct topology **t);
 int topology_node_insert(struct topology *t, struct nodeID *neighbour);
 struct peerset *topology_get_neighbours(struct topology *t);
 void topology_update(struct topology *t);
+void topology_sampler_periodic(struct topology *t);
 struct peer *nodeid_to_peer(struct topology *t, struct nodeID* id, int reg);
 void topology_message_parse(struct topology *t, struct nodeID *from, const uint8_t *buff, size_t len);
 void peerset_print(const struct peerset * pset,const char * name);
+double get_rtt_of(struct topology *t, const struct nodeID* n);
+double get_capacity_of(struct topology *t, const struct nodeID* n);
 
 #endif	/* TOPOLOGY_H */
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include<fcntl.h>
+#include<errno.h>
+#include<inttypes.h>
+#include<pthread.h>
+#include<sys/time.h>
+#include<grapes_config.h>
+#include<net_helpers.h>
+#include<chunk_attributes.h>
+#include<tracer.h>
+
+#define TRACE_MAGIC 0x52545350  // "PSTR"
+#define TRACE_VERSION 1
+#define TRACE_FLUSH_WAIT 10000  // microseconds the flusher sleeps on an empty ring
+#define TRACE_NAME_LENGTH ((NODE_STR_LENGTH + TRACE_NAME_PIECE - 1) / TRACE_NAME_PIECE * TRACE_NAME_PIECE)
+
+#define ATOMIC_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+typedef char trace_record_size_check[sizeof(struct trace_record) == 40 ? 1 : -1];
+
+struct trace_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t record_size;
+	uint64_t reserved;
+};
+
+struct tracer {
+	int fd;
+	struct trace_record * ring;
+	uint64_t size;
+	uint64_t head;  // producer side
+	uint64_t tail;  // flusher side
+	uint64_t dropped;
+	struct nodeID ** peers;
+	uint16_t peers_len;
+	pthread_t thread;
+	int8_t running;
+};
+
+static const char * trace_notes[] = {"SENT", "RECEIVED", "TOO_OLD", "DUPLICATED", "CANNOT_PARSE", "CACHE_MISS", "ERROR"};
+
+static const char * trace_signals[] = {"OFFER_SIG", "ACCEPT_SIG", "REQUEST_SIG", "DELIVER_SIG", "SEND_BMAP_SIG", "REQUEST_BMAP_SIG", "CHUNK_ACK_SIG"};
+
+int8_t tracer_write(int fd, const void * buff, size_t len)
+{
+	ssize_t res;
+
+	while (len > 0)
+	{
+		res = write(fd, buff, len);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return -1;
+		buff = (const uint8_t *) buff + res;
+		len -= res;
+	}
+	return 0;
+}
+
+void * tracer_loop(void * arg)
+{
+	struct tracer * t = arg;
+	uint64_t h, n;
+
+	while (ATOMIC_LOAD(t->running) || t->tail < ATOMIC_LOAD(t->head))
+	{
+		h = ATOMIC_LOAD(t->head);
+		if (t->tail < h)
+		{
+			n = h - t->tail;
+			if (n > t->size - t->tail % t->size)
+				n = t->size - t->tail % t->size;  // up to the end of the ring
+			if (tracer_write(t->fd, t->ring + t->tail % t->size, n * sizeof(struct trace_record)))
+				fprintf(stderr, "[ERROR] cannot write the trace: %s\n", strerror(errno));
+			ATOMIC_STORE(t->tail, t->tail + n);
+		} else
+			usleep(TRACE_FLUSH_WAIT);
+	}
+	return NULL;
+}
+
+struct tracer * tracer_create(const char * config)
+{
+	struct tracer * t = NULL;
+	struct trace_header hdr;
+	struct tag * tags;
+	const char * path;
+	int records, fd;
+
+	tags = grapes_config_parse(config);
+	path = grapes_config_value_str_default(tags, "trace_file", NULL);
+	grapes_config_value_int_default(tags, "trace_records", &records, DEFAULT_TRACE_RECORDS);
+	if (path && records > 0)
+	{
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		memset(&hdr, 0, sizeof(struct trace_header));
+		hdr.magic = TRACE_MAGIC;
+		hdr.version = TRACE_VERSION;
+		hdr.record_size = sizeof(struct trace_record);
+		if (fd >= 0 && tracer_write(fd, &hdr, sizeof(struct trace_header)) == 0)
+		{
+			t = malloc(sizeof(struct tracer));
+			memset(t, 0, sizeof(struct tracer));
+			t->fd = fd;
+			t->size = records;
+			t->ring = malloc(sizeof(struct trace_record) * records);
+			t->peers = malloc(sizeof(struct nodeID *) * TRACE_MAX_PEERS);
+			t->running = 1;
+			if (pthread_create(&t->thread, NULL, tracer_loop, t))
+			{
+				fprintf(stderr, "[ERROR] cannot start the tracer thread\n");
+				t->running = 0;
+				tracer_destroy(&t);
+			}
+		} else {
+			fprintf(stderr, "[ERROR] cannot open the trace file %s\n", path);
+			if (fd >= 0)
+				close(fd);
+		}
+	}
+	free(tags);
+	return t;
+}
+
+void tracer_destroy(struct tracer ** t)
+{
+	uint16_t i;
+
+	if (t && *t)
+	{
+		if ((*t)->running)
+		{
+			ATOMIC_STORE((*t)->running, 0);
+			pthread_join((*t)->thread, NULL);
+		}
+		if ((*t)->dropped)
+			fprintf(stderr, "[WARNING] %"PRIu64" trace records dropped, consider a larger trace_records\n", (*t)->dropped);
+		close((*t)->fd);
+		for (i = 0; i < (*t)->peers_len; i++)
+			nodeid_free((*t)->peers[i]);
+		free((*t)->peers);
+		free((*t)->ring);
+		free(*t);
+		*t = NULL;
+	}
+}
+
+struct trace_record * tracer_claim(struct tracer * t, uint64_t n)
+	/* the first of n free consecutive slots, NULL if the ring is full */
+{
+	if (t->head + n - ATOMIC_LOAD(t->tail) > t->size)
+		return NULL;
+	return t->ring + t->head % t->size;
+}
+
+void tracer_commit(struct tracer * t)
+{
+	ATOMIC_STORE(t->head, t->head + 1);
+}
+
+uint64_t tracer_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+uint16_t tracer_peer(struct tracer * t, const struct nodeID * id, uint64_t now)
+	/* index of id, its address is recorded on the first appearance */
+{
+	struct trace_record * r;
+	char addr[NODE_STR_LENGTH];
+	uint16_t i;
+	int len, pieces, p;
+
+	if (id == NULL)
+		return TRACE_NO_PEER;
+	for (i = 0; i < t->peers_len; i++)
+		if (t->peers[i] == id || nodeid_equal(t->peers[i], id))
+			return i;
+	if (t->peers_len >= TRACE_MAX_PEERS)
+		return TRACE_NO_PEER;
+
+	node_addr(id, addr, NODE_STR_LENGTH);
+	len = strlen(addr) + 1;
+	pieces = (len + TRACE_NAME_PIECE - 1) / TRACE_NAME_PIECE;
+	if (tracer_claim(t, pieces + 1) == NULL)  // room for the event too
+		return TRACE_NO_PEER;
+	for (p = 0; p < pieces; p++)
+	{
+		r = tracer_claim(t, 1);
+		memset(r, 0, sizeof(struct trace_record));
+		r->time = now;
+		r->event = TRACE_PEER;
+		r->note = p;
+		r->from = t->peers_len;
+		memcpy(r->u.name, addr + p * TRACE_NAME_PIECE, len - p * TRACE_NAME_PIECE < TRACE_NAME_PIECE ? len - p * TRACE_NAME_PIECE : TRACE_NAME_PIECE);
+		tracer_commit(t);
+	}
+	t->peers[t->peers_len] = nodeid_dup(id);
+	return t->peers_len++;
+}
+
+int8_t tracer_chunk(struct tracer * t, const struct nodeID * from, const struct nodeID * to, const struct chunk * c, enum trace_note note)
+{
+	struct trace_record * r;
+	uint64_t now;
+	uint16_t f, d;
+
+	if (t == NULL)
+		return -1;
+	now = tracer_now();
+	f = tracer_peer(t, from, now);
+	d = tracer_peer(t, to, now);
+	r = tracer_claim(t, 1);
+	if (r == NULL)
+	{
+		t->dropped++;
+		return -1;
+	}
+	r->time = now;
+	r->event = TRACE_CHUNK;
+	r->note = note;
+	r->from = f;
+	r->to = d;
+	r->trans_id = 0;
+	memset(&r->u, 0, sizeof(r->u));
+	r->u.chunk.id = c ? c->id : -1;
+	r->u.chunk.size = c ? c->size : -1;
+	r->u.chunk.timestamp = c ? c->timestamp : 0;
+	r->u.chunk.hopcount = c ? chunk_attributes_get_hopcount(c) : 0;
+	tracer_commit(t);
+	return 0;
+}
+
+int8_t tracer_signal(struct tracer * t, const struct nodeID * from, const struct nodeID * to, int cidset_size, uint16_t trans_id, enum signaling_type type, enum trace_note note)
+{
+	struct trace_record * r;
+	uint64_t now;
+	uint16_t f, d;
+
+	if (t == NULL)
+		return -1;
+	now = tracer_now();
+	f = tracer_peer(t, from, now);
+	d = tracer_peer(t, to, now);
+	r = tracer_claim(t, 1);
+	if (r == NULL)
+	{
+		t->dropped++;
+		return -1;
+	}
+	r->time = now;
+	r->event = TRACE_SIGNAL;
+	r->note = note;
+	r->from = f;
+	r->to = d;
+	r->trans_id = trans_id;
+	memset(&r->u, 0, sizeof(r->u));
+	r->u.signal.cidset_size = cidset_size;
+	r->u.signal.type = type;
+	tracer_commit(t);
+	return 0;
+}
+
+uint64_t tracer_dropped(const struct tracer * t)
+{
+	return t ? t->dropped : 0;
+}
+
+void tracer_print_record(FILE * out, const struct trace_record * r, const char * from, const char * to)
+{
+	const char * note;
+
+	note = r->note < sizeof(trace_notes) / sizeof(char *) ? trace_notes[r->note] : "ERROR";
+	if (r->event == TRACE_CHUNK)
+	{
+		// semantic: [CHUNK_LOG],log_date,sender,receiver,id,size(bytes),chunk_timestamp,hopcount,notes
+		fprintf(out, "[CHUNK_LOG],%"PRIu64",%s,%s,%d,%d,%"PRIu64",%i,%s\n", r->time, from, to, r->u.chunk.id,
+				r->u.chunk.size, r->u.chunk.timestamp, r->u.chunk.hopcount, note);
+	}
+	if (r->event == TRACE_SIGNAL)
+		fprintf(out, "[SIGNAL_LOG],%"PRIu64",%s,%s,%d,%s,%s\n", r->time, from, to, r->trans_id,
+				r->u.signal.type < sizeof(trace_signals) / sizeof(char *) ? trace_signals[r->u.signal.type] : "UNKNOWN_SIG", note);
+}
+
+int64_t tracer_decode(FILE * in, FILE * out)
+{
+	struct trace_header hdr;
+	struct trace_record r;
+	char (* names)[TRACE_NAME_LENGTH];
+	int64_t events = 0;
+
+	if (fread(&hdr, sizeof(struct trace_header), 1, in) != 1 || hdr.magic != TRACE_MAGIC ||
+			hdr.version != TRACE_VERSION || hdr.record_size != sizeof(struct trace_record))
+		return -1;
+
+	names = calloc(TRACE_MAX_PEERS, TRACE_NAME_LENGTH);
+	while (fread(&r, sizeof(struct trace_record), 1, in) == 1)
+	{
+		if (r.event == TRACE_PEER)
+		{
+			if (r.from < TRACE_MAX_PEERS && (r.note + 1) * TRACE_NAME_PIECE <= TRACE_NAME_LENGTH)
+			{
+				memcpy(names[r.from] + r.note * TRACE_NAME_PIECE, r.u.name, TRACE_NAME_PIECE);
+				names[r.from][TRACE_NAME_LENGTH - 1] = '\0';
+			}
+		} else {
+			tracer_print_record(out, &r, r.from < TRACE_MAX_PEERS ? names[r.from] : "ND", r.to < TRACE_MAX_PEERS ? names[r.to] : "ND");
+			events++;
+		}
+	}
+	free(names);
+	return events;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2018 Luca Baldesi
+ *
+ * This file is part of PeerStreamer.
+ *
+ * PeerStreamer is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * PeerStreamer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with PeerStreamer.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TRACER_H__
+#define __TRACER_H__
+
+#include<stdio.h>
+#include<stdint.h>
+#include<chunk.h>
+#include<net_helper.h>
+#include<trade_sig_ha.h>
+
+/* Binary event tracer for the chunk and signalling logs: the streaming
+ * loop appends fixed size records to a lock-free single producer ring and
+ * a flusher thread writes them to a file. Peers are recorded as indexes in
+ * a per-instance table; their addresses are written once, as TRACE_PEER
+ * records, the first time they appear. A full ring drops the new records.
+ * tracer_decode regenerates the [CHUNK_LOG] and [SIGNAL_LOG] CSV lines. */
+
+#define DEFAULT_TRACE_RECORDS 65536
+#define TRACE_MAX_PEERS 4096
+#define TRACE_NO_PEER 0xFFFF  // printed as ND
+#define TRACE_NAME_PIECE 24  // address bytes per TRACE_PEER record
+
+enum trace_event {TRACE_PEER, TRACE_CHUNK, TRACE_SIGNAL};
+
+enum trace_note {TRACE_SENT, TRACE_RECEIVED, TRACE_TOO_OLD, TRACE_DUPLICATED, TRACE_CANNOT_PARSE, TRACE_CACHE_MISS, TRACE_ERROR};
+
+struct trace_record {
+	uint64_t time;  // wall clock, microseconds
+	uint8_t event;
+	uint8_t note;  // piece number for TRACE_PEER
+	uint16_t from;  // peer indexes
+	uint16_t to;
+	uint16_t trans_id;
+	union {
+		struct {
+			uint64_t timestamp;
+			int32_t id;
+			int32_t size;
+			uint16_t hopcount;
+		} chunk;
+		struct {
+			int32_t cidset_size;
+			uint8_t type;  // enum signaling_type
+		} signal;
+		char name[TRACE_NAME_PIECE];
+	} u;
+};
+
+struct tracer;
+
+/* reads trace_file and trace_records, NULL if tracing is not configured */
+struct tracer * tracer_create(const char * config);
+
+/* writes out the pending records */
+void tracer_destroy(struct tracer ** t);
+
+/* c may be NULL */
+int8_t tracer_chunk(struct tracer * t, const struct nodeID * from, const struct nodeID * to, const struct chunk * c, enum trace_note note);
+
+int8_t tracer_signal(struct tracer * t, const struct nodeID * from, const struct nodeID * to, int cidset_size, uint16_t trans_id, enum signaling_type type, enum trace_note note);
+
+uint64_t tracer_dropped(const struct tracer * t);
+
+/* prints the CSV line of a chunk or signal record */
+void tracer_print_record(FILE * out, const struct trace_record * r, const char * from, const char * to);
+
+/* converts a trace file into CSV lines; returns the decoded events or -1
+ * if in is not a trace */
+int64_t tracer_decode(FILE * in, FILE * out);
+
+#endif
@@ -29,11 +29,13 @@
 #include "dbg.h"
 #include "measures.h"
 #include "transaction.h"
+#include "mono_clock.h"
 
 typedef struct {
 	uint16_t trans_id;
 	double offer_sent_time;
 	double accept_received_time;
+	size_t sent_bytes;
 	struct nodeID *id;
 	} service_time;
 
@@ -68,17 +70,19 @@ void _transaction_remove(struct service_times_element ** head, struct service_ti
 }	
 
 // Check the service times list to find elements over the timeout
-void check_neighbor_status_list(struct service_times_element ** stl) {
+// return the number of removed elements
+uint16_t check_neighbor_status_list(struct service_times_element ** stl) {
 	struct service_times_element *stl_iterator, *stl_aux;
 	struct timeval current_time;
+	uint16_t removed = 0;
 
-	gettimeofday(&current_time, NULL);
+	mono_clock_precise(&current_time);  // rtt and byterate need full resolution
 	
         dprintf("LIST: check trans_id list\n");
 	
 	// Check if list is empty
 	if (*stl == NULL) {
-		return;
+		return removed;
 		}
         
 	// Start from the beginning of the list
@@ -92,6 +96,7 @@ void check_neighbor_status_list(struct service_times_element ** stl) {
 			 dprintf("LIST TIMEOUT: trans_id %d, offer_sent_time %f, accept_received_time %f\n", stl_iterator->st.trans_id, (double) ((current_time.tv_sec + current_time.tv_usec*1e-6) - stl_iterator->st.offer_sent_time  ), (double) ((current_time.tv_sec + current_time.tv_usec*1e-6) - stl_iterator->st.accept_received_time));
 			 //fprintf(stderr, "LIST TIMEOUT: trans_id %d, offer_sent_time %f, accept_received_time %f\n", stl_iterator->st.trans_id, (double) ((current_time.tv_sec + current_time.tv_usec*1e-6) - stl_iterator->st.offer_sent_time  ), (double) ((current_time.tv_sec + current_time.tv_usec*1e-6) - stl_iterator->st.accept_received_time));
 		_transaction_remove(stl, stl_iterator);
+		removed++;
 
 			// Free the memory
 		}
@@ -99,7 +104,16 @@ void check_neighbor_status_list(struct service_times_element ** stl) {
 		if (stl_iterator)
 			stl_aux = stl_aux->forward;
 	}
-	return;
+	return removed;
+}
+
+// remove the transactions over the timeout
+// return the number of expired transactions
+uint16_t transaction_expire(struct service_times_element ** stl)
+{
+	if (stl)
+		return check_neighbor_status_list(stl);
+	return 0;
 }
 
 // register the moment when a transaction is started
@@ -113,13 +127,14 @@ uint16_t transaction_create(struct service_times_element ** stl, struct nodeID *
 	{
 		check_neighbor_status_list(stl);
 
-		gettimeofday(&current_time, NULL);
+		mono_clock_precise(&current_time);
 
 
 		// create a new element in the list with its offer_sent_time and set accept_received_time to -1.0
 		stl2 = (struct service_times_element*) malloc(sizeof(struct service_times_element));
 		stl2->st.offer_sent_time = current_time.tv_sec + current_time.tv_usec*1e-6;
 		stl2->st.accept_received_time = -1.0;
+		stl2->st.sent_bytes = 0;
 		stl2->st.id = nodeid_dup(id);
 
 		stl2->backward = NULL;
@@ -143,6 +158,13 @@ uint16_t transaction_create(struct service_times_element ** stl, struct nodeID *
 }
 
 
+static struct service_times_element * transaction_find(const struct service_times_element * stl, uint16_t trans_id)
+{
+	while (stl != NULL && stl->st.trans_id != trans_id)
+		stl = stl->forward;
+	return (struct service_times_element *) stl;
+}
+
 // Add the moment I received a positive select in a list
 // return true if a valid trans_id is found
 bool transaction_reg_accept(struct service_times_element * stl, uint16_t trans_id,const struct nodeID *id)
@@ -152,23 +174,75 @@ bool transaction_reg_accept(struct service_times_element * stl, uint16_t trans_i
 
 	if (stl && id && trans_id)
 	{
-		gettimeofday(&current_time, NULL);
-		stl_iterator = stl;
+		mono_clock_precise(&current_time);
 
 		// if an accept was received, look for the trans_id and add current_time to accept_received_time field
 		dprintf("LIST: changing trans_id %d to the list, accept received %f\n", trans_id, current_time.tv_sec + current_time.tv_usec*1e-6);
-		// Iterate the list until you get the right element
-		while (stl_iterator != NULL) {
-				if (stl_iterator->st.trans_id == trans_id) {
-					stl_iterator->st.accept_received_time = current_time.tv_sec + current_time.tv_usec*1e-6;
-					return true;
-					}
-				stl_iterator = stl_iterator->forward;
+		stl_iterator = transaction_find(stl, trans_id);
+		if (stl_iterator) {
+			stl_iterator->st.accept_received_time = current_time.tv_sec + current_time.tv_usec*1e-6;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Add the amount of bytes sent in reply to a positive select
+// return true if a valid trans_id is found
+bool transaction_reg_sent_bytes(struct service_times_element * stl, uint16_t trans_id, size_t bytes)
+{
+	struct service_times_element *stl_iterator;
+
+	if (stl && trans_id)
+	{
+		stl_iterator = transaction_find(stl, trans_id);
+		if (stl_iterator)
+		{
+			stl_iterator->st.sent_bytes += bytes;
+			return true;
 		}
 	}
 	return false;
 }
 
+// Used to get the time elapsed from the moment I sent the offer to the moment I got the positive select
+// it return -1.0 in case no trans_id is found or no select has been registered
+double transaction_rtt(const struct service_times_element * stl, uint16_t trans_id)
+{
+	const struct service_times_element *stl_iterator;
+
+	if (stl && trans_id)
+	{
+		stl_iterator = transaction_find(stl, trans_id);
+		if (stl_iterator && stl_iterator->st.accept_received_time > 0.0)
+			return stl_iterator->st.accept_received_time - stl_iterator->st.offer_sent_time;
+	}
+	return -1.0;
+}
+
+// Used to get the bytes per second delivered from the moment I got the positive select up to now
+// (i.e., upon the reception of the ACK)
+// it return -1.0 in case no trans_id is found or nothing has been sent
+double transaction_byterate(const struct service_times_element * stl, uint16_t trans_id)
+{
+	const struct service_times_element *stl_iterator;
+	struct timeval current_time;
+	double elapsed;
+
+	if (stl && trans_id)
+	{
+		stl_iterator = transaction_find(stl, trans_id);
+		if (stl_iterator && stl_iterator->st.accept_received_time > 0.0 && stl_iterator->st.sent_bytes > 0)
+		{
+			mono_clock_precise(&current_time);
+			elapsed = current_time.tv_sec + current_time.tv_usec*1e-6 - stl_iterator->st.accept_received_time;
+			if (elapsed > 0.0)
+				return stl_iterator->st.sent_bytes / elapsed;
+		}
+	}
+	return -1.0;
+}
+
 // Used to get the time elapsed from the moment I get a positive select to the moment i get the ACK
 // related to the same chunk
 // it return -1.0 in case no trans_id is found
@@ -199,6 +273,15 @@ double transaction_remove(struct service_times_element ** stl, uint16_t trans_id
 	return to_return;
 }
 
+uint16_t transaction_count(const struct service_times_element * head)
+{
+	uint16_t count = 0;
+
+	for (; head; head = head->forward)
+		count++;
+	return count;
+}
+
 void transaction_destroy(struct service_times_element ** head)
 {
 	while(*head)
@@ -40,11 +40,31 @@ uint16_t transaction_create(struct service_times_element ** head, struct nodeID
 // return true if a valid trans_id is found
 bool transaction_reg_accept(struct service_times_element * head, uint16_t trans_id,const struct nodeID *id);
 
+// Add the amount of bytes sent in reply to a positive select
+// return true if a valid trans_id is found
+bool transaction_reg_sent_bytes(struct service_times_element * head, uint16_t trans_id, size_t bytes);
+
+// Used to get the time elapsed from the moment I sent the offer to the moment I got the positive select
+// it return -1.0 in case no trans_id is found or no select has been registered
+double transaction_rtt(const struct service_times_element * head, uint16_t trans_id);
+
+// Used to get the bytes per second delivered from the moment I got the positive select up to now
+// (i.e., upon the reception of the ACK)
+// it return -1.0 in case no trans_id is found or nothing has been sent
+double transaction_byterate(const struct service_times_element * head, uint16_t trans_id);
+
 // Used to get the time elapsed from the moment I get a positive select to the moment i get the ACK
 // related to the same chunk
 // it return -1.0 in case no trans_id is found
 double transaction_remove(struct service_times_element ** head, uint16_t trans_id);
 
+// remove the transactions over the timeout
+// return the number of expired transactions
+uint16_t transaction_expire(struct service_times_element ** head);
+
+// return the number of open transactions
+uint16_t transaction_count(const struct service_times_element * head);
+
 void transaction_destroy(struct service_times_element ** head);
 
 #endif // TRANSACTION_H
@@ -0,0 +1,119 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<stdlib.h>
+#include<chunk_archive.h>
+#include<mono_clock.h>
+
+void fill_chunk(struct chunk * c, int id, uint8_t * data, int size)
+{
+	memset(data, id, size);
+	c->id = id;
+	c->timestamp = 1000 + id;
+	c->size = size;
+	c->data = data;
+	c->attributes_size = 0;
+	c->attributes = NULL;
+}
+
+void chunk_archive_create_test()
+{
+	struct chunk_archive * ca;
+
+	assert(chunk_archive_create(NULL) == NULL);
+	assert(chunk_archive_create("archive_minutes=1") == NULL);
+	assert(chunk_archive_create("archive_dir=/nonexistent") == NULL);
+	ca = chunk_archive_create("archive_dir=/tmp");
+	assert(ca);
+	assert(chunk_archive_get(ca, 3) == NULL);
+	assert(chunk_archive_add(ca, NULL) < 0);
+	chunk_archive_destroy(&ca);
+	assert(ca == NULL);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void chunk_archive_get_test()
+{
+	struct chunk_archive * ca;
+	struct shared_chunk * sc;
+	const struct chunk * c;
+	struct chunk ch;
+	uint8_t data[100], attr[2] = {4, 2};
+	int i;
+
+	mono_clock_fake_set(1000000);
+	ca = chunk_archive_create("archive_dir=/tmp");
+	for (i = 10; i > 0; i--)  // out of order
+	{
+		fill_chunk(&ch, i, data, i * 10);
+		if (i == 5)
+		{
+			ch.attributes = attr;
+			ch.attributes_size = 2;
+		}
+		assert(chunk_archive_add(ca, &ch) == 0);
+	}
+	assert(chunk_archive_add(ca, &ch) == 1);
+	assert(chunk_archive_chunks(ca) == 10);
+	assert(chunk_archive_contains(ca, 7));
+	assert(!chunk_archive_contains(ca, 11));
+
+	sc = chunk_archive_get(ca, 5);
+	assert(sc);
+	c = shared_chunk_get(sc);
+	assert(c->id == 5 && c->timestamp == 1005 && c->size == 50);
+	assert(c->data[0] == 5 && c->data[49] == 5);
+	assert(c->attributes_size == 2 && ((uint8_t *) c->attributes)[1] == 2);
+	shared_chunk_unref(&sc);
+
+	sc = chunk_archive_get(ca, 10);
+	assert(sc && shared_chunk_get(sc)->size == 100);
+	shared_chunk_unref(&sc);
+
+	chunk_archive_destroy(&ca);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void chunk_archive_expire_test()
+{
+	struct chunk_archive * ca;
+	struct shared_chunk * sc;
+	struct chunk ch;
+	uint8_t data[10];
+	int i;
+
+	mono_clock_fake_set(1000000);
+	ca = chunk_archive_create("archive_dir=/tmp,archive_minutes=1,archive_segment=10");
+	for (i = 0; i < 100; i++)  // a chunk per second, 10 segments
+	{
+		fill_chunk(&ch, i, data, sizeof(data));
+		assert(chunk_archive_add(ca, &ch) == 0);
+		mono_clock_fake_advance(1000000);
+	}
+	assert(chunk_archive_chunks(ca) == 70);  // expired at the last segment rotation, 91s
+	fill_chunk(&ch, 100, data, sizeof(data));
+	assert(chunk_archive_add(ca, &ch) == 0);
+	// at 101s, chunks up to 39 (added at 40s) are older than one minute
+	assert(chunk_archive_chunks(ca) == 61);
+	assert(!chunk_archive_contains(ca, 39));
+	assert(chunk_archive_get(ca, 39) == NULL);
+	sc = chunk_archive_get(ca, 40);
+	assert(sc && shared_chunk_get(sc)->data[0] == 40);
+	shared_chunk_unref(&sc);
+
+	chunk_archive_destroy(&ca);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	chunk_archive_create_test();
+	chunk_archive_get_test();
+	chunk_archive_expire_test();
+	return 0;
+}
@@ -0,0 +1,122 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<stdlib.h>
+#include<unistd.h>
+#include<stdio.h>
+#include<chunk_file.h>
+
+#define CHUNKS 100
+
+uint8_t * write_container(const char * path, size_t * len)
+{
+	struct chunk_file_writer * w;
+	struct chunk c;
+	uint8_t data[64], attr[2] = {7, 7}, * buff;
+	FILE * fp;
+	int i;
+
+	w = chunk_file_writer_create(path, 100000);
+	assert(w);
+	for (i = 0; i < CHUNKS; i++)
+	{
+		memset(data, i, sizeof(data));
+		c.id = 1000 + i;
+		c.timestamp = 5000000 + i * 20000;  // an index entry every 5 chunks
+		c.size = i % 64 + 1;
+		c.data = data;
+		c.attributes_size = i % 2 ? 2 : 0;
+		c.attributes = i % 2 ? attr : NULL;
+		assert(chunk_file_write(w, &c) == 0);
+	}
+	c.timestamp = 0;
+	assert(chunk_file_write(w, &c) < 0);  // timestamps must not decrease
+	assert(chunk_file_writer_close(&w) == 0);
+	assert(w == NULL);
+
+	fp = fopen(path, "rb");
+	fseek(fp, 0, SEEK_END);
+	*len = ftell(fp);
+	rewind(fp);
+	buff = malloc(*len);
+	assert(fread(buff, *len, 1, fp) == 1);
+	fclose(fp);
+	return buff;
+}
+
+void chunk_file_read_test()
+{
+	char path[] = "/tmp/chunk_file_testXXXXXX";
+	struct chunk_file * f;
+	struct chunk c;
+	uint8_t * buff;
+	size_t len;
+	int i;
+
+	close(mkstemp(path));
+	buff = write_container(path, &len);
+	assert(chunk_file_open(buff, CHUNK_FILE_HEADER_SIZE - 1) == NULL);
+	f = chunk_file_open(buff, len);
+	assert(f);
+	assert(chunk_file_chunks(f) == CHUNKS);
+	assert(chunk_file_first_timestamp(f) == 5000000);
+	assert(chunk_file_interval(f) == 20000);
+
+	for (i = 0; i < CHUNKS; i++)
+	{
+		assert(chunk_file_next(f, &c) == 1);
+		assert(c.id == 1000 + i);
+		assert(c.size == i % 64 + 1 && c.data[0] == i && c.data[c.size - 1] == i);
+		assert(c.attributes_size == (i % 2 ? 2 : 0));
+		assert(i % 2 == 0 || ((uint8_t *) c.attributes)[1] == 7);
+	}
+	assert(chunk_file_next(f, &c) == 0);
+
+	chunk_file_close(&f);
+	assert(f == NULL);
+	free(buff);
+	unlink(path);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void chunk_file_seek_test()
+{
+	char path[] = "/tmp/chunk_file_testXXXXXX";
+	struct chunk_file * f;
+	struct chunk c;
+	uint8_t * buff;
+	size_t len;
+
+	close(mkstemp(path));
+	buff = write_container(path, &len);
+	f = chunk_file_open(buff, len);
+
+	assert(chunk_file_seek(f, 0) == 0);
+	assert(chunk_file_next(f, &c) == 1 && c.id == 1000);
+	assert(chunk_file_seek(f, 5000000 + 37 * 20000) == 0);
+	assert(chunk_file_next(f, &c) == 1 && c.id == 1037);
+	assert(chunk_file_seek(f, 5000000 + 37 * 20000 + 1) == 0);  // next chunk boundary
+	assert(chunk_file_next(f, &c) == 1 && c.id == 1038);
+	assert(chunk_file_seek(f, 5000000 + (CHUNKS - 1) * 20000) == 0);
+	assert(chunk_file_next(f, &c) == 1 && c.id == 1000 + CHUNKS - 1);
+	assert(chunk_file_seek(f, 5000000 + CHUNKS * 20000) < 0);
+	assert(chunk_file_next(f, &c) == 0);
+
+	buff[CHUNK_FILE_HEADER_SIZE + 12] = 0x7f;  // corrupted size of the first record
+	assert(chunk_file_seek(f, 0) < 0);
+	assert(chunk_file_next(f, &c) < 0);
+
+	chunk_file_close(&f);
+	free(buff);
+	unlink(path);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	chunk_file_read_test();
+	chunk_file_seek_test();
+	return 0;
+}
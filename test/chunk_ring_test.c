@@ -0,0 +1,126 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<chunk.h>
+#include<chunkbuffer.h>
+#include<chunkidset.h>
+#include<chunk_ring.h>
+
+struct chunk * create_chunk(int id, int size)
+{
+	struct chunk * c;
+
+	c = malloc(sizeof(struct chunk));
+	memset(c, 0, sizeof(struct chunk));
+	c->id = id;
+	c->size = size;
+	c->data = malloc(size);
+	memset(c->data, id, size);
+	c->attributes_size = 2;
+	c->attributes = malloc(2);
+	return c;
+}
+
+void destroy_chunk(struct chunk ** c)
+{
+	free((*c)->data);
+	free((*c)->attributes);
+	free(*c);
+	*c = NULL;
+}
+
+int add_chunk(struct chunk_ring * r, int id, int size)
+{
+	struct chunk * c;
+	int res;
+
+	c = create_chunk(id, size);
+	res = chunk_ring_add(r, c);
+	destroy_chunk(&c);
+	return res;
+}
+
+void chunk_ring_create_test()
+{
+	struct chunk_ring * r;
+
+	assert(chunk_ring_create(0, 16) == NULL);
+	r = chunk_ring_create(5, 16);
+	assert(r);
+	assert(chunk_ring_size(r) == 5);
+	assert(chunk_ring_count(r) == 0);
+	assert(chunk_ring_get(r, 0) == NULL);
+	chunk_ring_destroy(&r);
+	assert(r == NULL);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void chunk_ring_add_test()
+{
+	struct chunk_ring * r;
+	const struct chunk * c;
+	int ids[5];
+
+	r = chunk_ring_create(5, 16);
+
+	assert(chunk_ring_add(NULL, NULL) == E_CB_OLD);
+	assert(add_chunk(r, 3, 10) == 0);
+	assert(add_chunk(r, 3, 10) == E_CB_DUPLICATE);
+	assert(add_chunk(r, 1, 10) == 0);
+	assert(add_chunk(r, 5, 100) == 0);  // larger than the slab
+	assert(chunk_ring_count(r) == 3);
+	assert(chunk_ring_contains(r, 1));
+	assert(!chunk_ring_contains(r, 2));
+
+	c = chunk_ring_get(r, 5);
+	assert(c && c->id == 5 && c->size == 100);
+	assert(c->data[0] == 5 && c->data[99] == 5);
+	c = chunk_ring_get(r, 3);
+	assert(c && c->size == 10 && c->data[9] == 3);
+
+	assert(add_chunk(r, 7, 10) == 0);  // evicts 1 and 2
+	assert(!chunk_ring_contains(r, 1));
+	assert(add_chunk(r, 2, 10) == E_CB_OLD);
+	assert(chunk_ring_count(r) == 3);
+	assert(chunk_ring_ids(r, ids) == 3);
+	assert(ids[0] == 3 && ids[1] == 5 && ids[2] == 7);
+
+	assert(add_chunk(r, 20, 10) == 0);  // evicts everything else
+	assert(chunk_ring_count(r) == 1);
+	assert(!chunk_ring_contains(r, 5));
+	assert(chunk_ring_get(r, 20)->data[0] == 20);
+
+	chunk_ring_destroy(&r);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void chunk_ring_to_idset_test()
+{
+	struct chunk_ring * r;
+	struct chunkID_set * cset;
+
+	r = chunk_ring_create(4, 16);
+	cset = chunk_ring_to_idset(r);
+	assert(chunkID_set_size(cset) == 0);
+	chunkID_set_free(cset);
+
+	add_chunk(r, 10, 1);
+	add_chunk(r, 12, 1);
+	cset = chunk_ring_to_idset(r);
+	assert(chunkID_set_size(cset) == 2);
+	assert(chunkID_set_check(cset, 10) >= 0);
+	assert(chunkID_set_check(cset, 12) >= 0);
+	chunkID_set_free(cset);
+
+	chunk_ring_destroy(&r);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	chunk_ring_create_test();
+	chunk_ring_add_test();
+	chunk_ring_to_idset_test();
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<int_coding.h>
+#include<chunk_trader.h>
+
+int encode_chunk_msg(uint8_t * buff, uint16_t transid, int id, int size, int attributes_size)
+	/* transaction ID and chunk header, as sent after the message type */
+{
+	int16_cpy(buff, transid);
+	int_cpy(buff + 2, id);
+	int_cpy(buff + 6, 0);
+	int_cpy(buff + 10, 1000);
+	int_cpy(buff + 14, size);
+	int_cpy(buff + 18, attributes_size);
+	return 22;
+}
+
+void chunk_decode_inplace_test()
+{
+	uint8_t buff[64];
+	struct chunk c;
+	uint16_t transid;
+	int len;
+
+	len = encode_chunk_msg(buff, 7, 42, 8, 2);
+	memset(buff + len, 0xaa, 10);
+	assert(chunk_decode_inplace(&c, buff, len + 10, &transid) == len + 10);
+	assert(transid == 7);
+	assert(c.id == 42);
+	assert(c.timestamp == 1000);
+	assert(c.size == 8);
+	assert(c.data == buff + len);
+	assert(c.attributes == buff + len + 8);
+
+	assert(chunk_decode_inplace(&c, buff, len - 1, &transid) == -1);
+	assert(chunk_decode_inplace(&c, buff, len + 9, &transid) == -2);  // truncated
+
+	encode_chunk_msg(buff, 7, 42, -1, 0);
+	assert(chunk_decode_inplace(&c, buff, sizeof(buff), &transid) == -2);
+
+	encode_chunk_msg(buff, 7, 42, 0x7fffffff, 0x7fffffff);  // the sum overflows an int
+	assert(chunk_decode_inplace(&c, buff, sizeof(buff), &transid) == -2);
+	encode_chunk_msg(buff, 7, 42, 0x7fffffff, 0);
+	assert(chunk_decode_inplace(&c, buff, sizeof(buff), &transid) == -2);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	chunk_decode_inplace_test();
+	return 0;
+}
@@ -4,6 +4,7 @@
 #include<net_helper.h>
 #include<peer.h>
 #include<unistd.h>
+#include<mono_clock.h>
 
 struct peer * create_peer()
 {
@@ -119,6 +120,50 @@ void chunk_timed_out_test()
 	fprintf(stderr,"%s successfully passed!\n",__func__);
 }
 
+void chunk_locks_count_peer_test()
+{
+	struct chunk_locks * locks = NULL;
+	struct peer * p;
+
+	locks = chunk_locks_create(1000);
+	p = create_peer();
+
+	assert(chunk_locks_count_peer(NULL, p->id) == 0);
+	assert(chunk_locks_count_peer(locks, NULL) == 0);
+	assert(chunk_locks_count_peer(locks, p->id) == 0);
+
+	chunk_lock(locks, 32, p);
+	chunk_lock(locks, 33, p);
+	assert(chunk_locks_count_peer(locks, p->id) == 2);
+	chunk_unlock(locks, 32);
+	assert(chunk_locks_count_peer(locks, p->id) == 1);
+
+	destroy_peer(&p);
+	chunk_locks_destroy(&locks);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void chunk_fake_clock_test()
+{
+	struct chunk_locks * locks = NULL;
+	struct peer * p;
+
+	mono_clock_fake_set(1000000);
+	locks = chunk_locks_create(80);
+	p = create_peer();
+
+	chunk_lock(locks, 32, p);
+	mono_clock_fake_advance(79000);
+	assert(chunk_islocked(locks, 32));
+	mono_clock_fake_advance(2000);
+	assert(chunk_islocked(locks, 32) == 0);
+
+	destroy_peer(&p);
+	chunk_locks_destroy(&locks);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
 int main()
 {
 	chunk_locks_create_test();
@@ -126,5 +171,7 @@ int main()
 	chunk_unlock_test();
 	chunk_islocked_test();
 	chunk_timed_out_test();
+	chunk_locks_count_peer_test();
+	chunk_fake_clock_test();
 	return 0;
 }
@@ -0,0 +1,73 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<stdlib.h>
+#include<dbg.h>
+
+int evaluated = 0;
+
+const struct chunk * chunk_arg(const struct chunk * c)
+{
+	evaluated++;
+	return c;
+}
+
+void log_configure_test()
+{
+	struct log_rates l, other;
+	char buff[80];
+
+	assert(log_configure(NULL, "log_chunk=1") < 0);
+	log_rates_init(&l);
+	log_rates_init(&other);
+	assert(log_configure(&l, "log_chunk=0,log_signal=0") == 0);
+	assert(l.rate[LOG_CAT_CHUNK] == 0 && l.rate[LOG_CAT_SIGNAL] == 0);
+	assert(log_configure(&l, "log_chunk=1000") == 0);
+	assert(l.rate[LOG_CAT_CHUNK] == 1000 && l.rate[LOG_CAT_SIGNAL] == 0);
+	assert(log_configure(&l, "port=6000,log_signal=-3") == 0);  // negative rates disable
+	assert(l.rate[LOG_CAT_CHUNK] == 1000 && l.rate[LOG_CAT_SIGNAL] == 0);
+
+	log_config_str(&l, buff, sizeof(buff));
+	assert(strcmp(buff, "log_chunk=1000,log_signal=0") == 0);
+
+	assert(log_configure(&other, "log_chunk=7") == 0);  // rates are not shared
+	assert(l.rate[LOG_CAT_CHUNK] == 1000 && other.rate[LOG_CAT_CHUNK] == 7);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void log_sampling_test()
+{
+	struct log_rates l;
+	struct chunk c;
+	int i, logged = 0;
+
+	memset(&c, 0, sizeof(struct chunk));
+	log_rates_init(&l);
+	log_configure(&l, "log_chunk=0");
+	for (i = 0; i < 100; i++)
+		LOG_CHUNK_EVENT(&l, NULL, NULL, NULL, chunk_arg(&c), TRACE_SENT);
+	assert(evaluated == 0);  // arguments are not even evaluated
+
+	log_configure(&l, "log_chunk=10");
+	for (i = 0; i < 100; i++)
+		logged += log_sample(&l, LOG_CAT_CHUNK);
+	assert(logged == 10);
+	evaluated = 0;
+	for (i = 0; i < 100; i++)
+		LOG_CHUNK_EVENT(&l, NULL, NULL, NULL, chunk_arg(&c), TRACE_SENT);
+	assert(evaluated == 10);
+
+	log_configure(&l, "log_chunk=1");
+	for (i = 0, logged = 0; i < 100; i++)
+		logged += log_sample(&l, LOG_CAT_CHUNK);
+	assert(logged == 100);
+	log_configure(&l, "log_chunk=0");
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	log_configure_test();
+	log_sampling_test();
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<stdlib.h>
+#include<unistd.h>
+#include<chunk.h>
+#include<input.h>
+#include<chunk_file.h>
+#include<chunk_attributes.h>
+#include<poll.h>
+
+void input_mmap_test()
+{
+	struct input_desc * in;
+	struct chunk * c[3], next;
+	char path[] = "/tmp/input_mmap_testXXXXXX";
+	uint8_t buff[40000];
+	int fds[FDSSIZE], fd, i;
+	suseconds_t delta;
+
+	for (i = 0; i < (int) sizeof(buff); i++)
+		buff[i] = i % 251;
+	fd = mkstemp(path);
+	assert(fd >= 0);
+	assert(write(fd, buff, sizeof(buff)) == sizeof(buff));
+	close(fd);
+
+	in = input_open(path, fds, FDSSIZE, "input_mmap=1,input_chunk_size=16384,input_chunk_interval=1000");
+	assert(in);
+	assert(fds[0] == -1);
+
+	for (i = 0; i < 3; i++)
+	{
+		c[i] = input_chunk(in, &delta);
+		assert(c[i]);
+		assert(c[i]->id == i);
+		assert(c[i]->attributes);
+		assert(delta >= 0 && delta <= 1000 * (i + 1));
+	}
+	assert(c[0]->size == 16384 && c[1]->size == 16384 && c[2]->size == 40000 - 2 * 16384);
+	assert(c[1]->data == c[0]->data + 16384);  // slices of the same mapping
+	assert(input_chunk(in, &delta) == NULL);
+	assert(delta == 1000);
+	assert(input_next(in, &next) == -1);  // readers like pschunker stop here
+
+	input_chunk_release(&c[0]);
+	input_close(in);
+	assert(memcmp(c[1]->data, buff + 16384, c[1]->size) == 0);  // mapping outlives the input
+	assert(memcmp(c[2]->data, buff + 2 * 16384, c[2]->size) == 0);
+	input_chunk_release(&c[1]);
+	input_chunk_release(&c[2]);
+	assert(c[2] == NULL);
+	unlink(path);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void input_mmap_loop_test()
+{
+	struct input_desc * in;
+	struct chunk * c;
+	char path[] = "/tmp/input_mmap_testXXXXXX";
+	int fds[FDSSIZE], fd, i;
+	suseconds_t delta;
+
+	fd = mkstemp(path);
+	assert(write(fd, "0123456789", 10) == 10);
+	close(fd);
+
+	assert(input_open("/nonexistent", fds, FDSSIZE, "input_mmap=1") == NULL);
+	in = input_open(path, fds, FDSSIZE, "input_mmap=1,input_chunk_size=4,input_loop=1");
+	assert(in);
+	for (i = 0; i < 4; i++)
+	{
+		c = input_chunk(in, &delta);
+		assert(c);
+		assert(c->size == (i == 2 ? 2 : 4));
+		assert(c->data[0] == "0480"[i]);
+		input_chunk_release(&c);
+	}
+	input_close(in);
+	unlink(path);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void input_prechunked_test()
+{
+	struct chunk_file_writer * w;
+	struct input_desc * in;
+	struct chunk c, * ch;
+	char path[] = "/tmp/input_prechunked_testXXXXXX";
+	uint8_t data[4] = {0, 1, 2, 3};
+	uint16_t attributes[2] = {0, 1};  // hopcount and track
+	int fds[FDSSIZE], i;
+	suseconds_t delta;
+
+	close(mkstemp(path));
+	w = chunk_file_writer_create(path, 0);
+	memset(&c, 0, sizeof(struct chunk));
+	c.data = data;
+	c.size = sizeof(data);
+	c.attributes = attributes;
+	c.attributes_size = sizeof(attributes);
+	for (i = 0; i < 10; i++)
+	{
+		c.id = 50 + i;
+		c.timestamp = i * 1000;
+		assert(chunk_file_write(w, &c) == 0);
+	}
+	assert(chunk_file_writer_close(&w) == 0);
+
+	assert(input_open(path, fds, FDSSIZE, "input_prechunked=1,input_seek=20") == NULL);  // beyond the end
+	in = input_open(path, fds, FDSSIZE, "input_prechunked=1,input_seek=7,input_loop=1");
+	assert(in);
+	for (i = 0; i < 5; i++)  // 57, 58, 59, then IDs keep growing from the start again
+	{
+		ch = input_chunk(in, &delta);
+		assert(ch);
+		assert(ch->id == 57 + i);
+		assert(ch->size == 4 && ch->data[3] == 3);
+		assert(chunk_attributes_get_track(ch) == 1);  // the recorded attributes are kept
+		input_chunk_release(&ch);
+	}
+	input_close(in);
+
+	in = input_open(path, fds, FDSSIZE, "input_prechunked=1,input_seek=8");
+	assert(in);
+	for (i = 0; i < 2; i++)
+		assert(input_next(in, &c) == 1);
+	assert(input_next(in, &c) == -1);  // the end, as for the other inputs
+	input_close(in);
+	unlink(path);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void input_multi_track_test()
+{
+	struct input_desc * in;
+	struct chunk * c, next;
+	struct pollfd pfd;
+	char paths[2][32] = {"/tmp/input_track_testXXXXXX", "/tmp/input_track_testXXXXXX"};
+	char fname[80];
+	int fds[FDSSIZE], fd, i, n = 0, per_track[2] = {0, 0};
+	suseconds_t delta;
+
+	for (i = 0; i < 2; i++)
+	{
+		fd = mkstemp(paths[i]);
+		assert(write(fd, i ? "BBBBBBBBBBBB" : "AAAAAAAAAAAA", 12) == 12);  // 3 chunks each
+		close(fd);
+	}
+	sprintf(fname, "%s|%s", paths[0], paths[1]);
+	in = input_open(fname, fds, FDSSIZE, "input_mmap=1,input_chunk_size=4,input_chunk_interval=1000");
+	assert(in);
+	assert(fds[0] >= 0 && fds[1] == -1);  // the merged stream wakes the source up
+
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	while (n < 6 && poll(&pfd, 1, 1000) == 1)
+	{
+		c = input_chunk(in, &delta);
+		assert(c);
+		assert(c->id == n++);  // a single ID space
+		i = chunk_attributes_get_track(c);
+		assert(i < 2);
+		assert(c->size == 4 && c->data[0] == (i ? 'B' : 'A'));
+		per_track[i]++;
+		input_chunk_release(&c);
+	}
+	assert(n == 6 && per_track[0] == 3 && per_track[1] == 3);
+	assert(input_next(in, &next) < 0);
+
+	input_close(in);
+	unlink(paths[0]);
+	unlink(paths[1]);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	input_mmap_test();
+	input_mmap_loop_test();
+	input_prechunked_test();
+	input_multi_track_test();
+	return 0;
+}
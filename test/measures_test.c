@@ -0,0 +1,180 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<sys/time.h>
+#include<measures.h>
+#include<histogram.h>
+#include<chunk_attributes.h>
+#include<net_helper.h>
+
+void chunk_fill(struct chunk * c, int id, uint64_t timestamp)
+{
+	memset(c, 0, sizeof(struct chunk));
+	c->id = id;
+	c->timestamp = timestamp;
+	c->size = 1000;
+}
+
+uint64_t wall_us()
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+void histogram_test()
+{
+	struct histogram h, m;
+	uint64_t v;
+
+	histogram_reset(&h);
+	assert(h.count == 0);
+	assert(histogram_percentile(&h, 50) == 0);
+
+	for (v = 1; v <= 1000; v++)
+		histogram_add(&h, v);
+	assert(h.count == 1000);
+	assert(h.max == 1000);
+	assert(histogram_mean(&h) == 500.5);
+	v = histogram_percentile(&h, 50);
+	assert(v >= 470 && v <= 530);  // within the bucket resolution
+	v = histogram_percentile(&h, 99);
+	assert(v >= 940 && v <= 1000);
+	assert(histogram_percentile(&h, 100) == 1000);
+
+	histogram_reset(&m);
+	for (v = 1001; v <= 2000; v++)
+		histogram_add(&m, v);
+	histogram_merge(&m, &h);
+	assert(m.count == 2000);
+	assert(m.max == 2000);
+	assert(histogram_mean(&m) == 1000.5);
+	v = histogram_percentile(&m, 50);
+	assert(v >= 940 && v <= 1060);
+
+	histogram_add(&h, 1ULL << 50);  // beyond the largest bucket
+	assert(h.max == 1ULL << 50);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void measures_chunk_interval_test()
+{
+	struct measures * m;
+	struct chunk c;
+
+	m = measures_create("test");
+	assert(m);
+	assert(chunk_interval_measure(m) == 1000000/25);
+
+	chunk_fill(&c, 10, 1000000);
+	reg_chunk_receive(m, &c);
+	assert(chunk_interval_measure(m) == 1000000/25);  // still loading
+	chunk_fill(&c, 12, 1000000 + 2 * 20000);
+	reg_chunk_receive(m, &c);
+	assert(chunk_interval_measure(m) == 20000);
+	chunk_fill(&c, 20, 1000000 + 10 * 30000);
+	reg_chunk_receive(m, &c);
+	assert(chunk_interval_measure(m) == 30000);
+
+	measures_destroy(&m);
+	assert(m == NULL);
+	measures_destroy(&m);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void measures_summary_test()
+{
+	struct measures * m;
+	struct measures_summary s;
+	struct measures_node nodes[4];
+	struct nodeID * a, * b;
+	uint64_t hops[MEASURES_MAX_HOPS];
+	struct chunk c;
+	int id;
+
+	m = measures_create("test");
+	a = create_node("10.0.0.1", 6000);
+	b = create_node("10.0.0.2", 6000);
+	assert(measures_summary(NULL, &s) < 0);
+	assert(measures_summary(m, &s) == 0);
+	assert(s.chunks == 0 && s.loss == 0);
+
+	reg_chunk_accept(m, a, 10);
+	for (id = 0; id < 10; id++)
+		if (id % 5 != 4)  // 2 lost
+		{
+			chunk_fill(&c, id, wall_us() - 2000);
+			chunk_attributes_init(&c);
+			chunk_attributes_update_upon_reception(&c);
+			reg_chunk_download(m, a, &c, 0);
+			reg_chunk_receive(m, &c);
+			chunk_attributes_deinit(&c);
+		}
+	chunk_fill(&c, 3, wall_us());
+	reg_chunk_download(m, b, &c, 1);
+	reg_chunk_upload(m, b, &c);
+	reg_signalling_receive(m, 2000);
+
+	assert(measures_summary(m, &s) == 0);
+	assert(s.chunks == 8);
+	assert(s.duplicates == 1);
+	assert(s.lost == 1);  // chunk 9 is not known yet to be missing
+	assert(s.loss > 0.1 && s.loss < 0.2);
+	assert(s.delay_p50 >= 1500 && s.delay_p50 < 1000000);
+	assert(s.delay_max >= s.delay_p99 && s.delay_p99 >= s.delay_p50);
+	assert(s.hopcount_mean == 1);
+	assert(s.download_bps == 9 * 1000 * 8.0 / MEASURES_WINDOW);
+	assert(s.upload_bps == 1000 * 8.0 / MEASURES_WINDOW);
+	assert(s.signalling_overhead == 2000.0 / 11000);
+
+	assert(measures_hopcounts(m, hops, MEASURES_MAX_HOPS) == MEASURES_MAX_HOPS);
+	assert(hops[0] == 0 && hops[1] == 8);
+
+	assert(measures_nodes(m, nodes, 4) == 2);
+	assert(nodeid_equal(nodes[0].id, a));
+	assert(nodes[0].chunks_received == 8);
+	assert(nodes[0].accepted == 10);
+	assert(nodes[0].loss > 0.19 && nodes[0].loss < 0.21);
+	assert(nodes[0].delay_mean >= 1500);
+	assert(nodes[1].duplicates == 1 && nodes[1].chunks_sent == 1);
+	assert(nodes[1].upload_bps == 1000 * 8.0 / MEASURES_WINDOW);
+
+	nodeid_free(a);
+	nodeid_free(b);
+	measures_destroy(&m);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void measures_node_eviction_test()
+{
+	struct measures * m;
+	struct measures_node nodes[MEASURES_MAX_NODES];
+	struct nodeID * id;
+	int i;
+
+	m = measures_create("test");
+	for (i = 0; i < MEASURES_MAX_NODES + 10; i++)
+	{
+		id = create_node("10.0.0.1", 6000 + i);
+		assert(measures_add_node(m, id) == 0);
+		nodeid_free(id);
+	}
+	assert(measures_nodes(m, nodes, MEASURES_MAX_NODES) == MEASURES_MAX_NODES);
+	id = create_node("10.0.0.1", 6000 + MEASURES_MAX_NODES + 9);
+	for (i = 0; i < MEASURES_MAX_NODES && !nodeid_equal(nodes[i].id, id); i++);
+	assert(i < MEASURES_MAX_NODES);
+	nodeid_free(id);
+
+	measures_destroy(&m);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	histogram_test();
+	measures_chunk_interval_test();
+	measures_summary_test();
+	measures_node_eviction_test();
+	return 0;
+}
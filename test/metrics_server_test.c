@@ -0,0 +1,154 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<stdlib.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/stat.h>
+#include<sys/un.h>
+#include<metrics_server.h>
+#include<psinstance.h>
+
+#define SOCKET_PATH "/tmp/metrics_server_test.sock"
+#define CONTROL_PATH SOCKET_PATH METRICS_CONTROL_SUFFIX
+
+int request(const char * path, const char * command, char * buff, int len)
+{
+	struct sockaddr_un addr;
+	int fd, n, res = 0;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(struct sockaddr_un));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	assert(connect(fd, (struct sockaddr *) &addr, sizeof(struct sockaddr_un)) == 0);
+	if (command)
+		assert(write(fd, command, strlen(command)) == (int) strlen(command));
+	while ((n = read(fd, buff + res, len - res - 1)) > 0)
+		res += n;
+	buff[res] = '\0';
+	close(fd);
+	return res;
+}
+
+int scrape(char * buff, int len)
+{
+	return request(SOCKET_PATH, NULL, buff, len);
+}
+
+int send_command(const char * command, char * buff, int len)
+{
+	return request(CONTROL_PATH, command, buff, len);
+}
+
+void metrics_text_test()
+{
+	struct metrics_text t;
+
+	memset(&t, 0, sizeof(struct metrics_text));
+	metrics_text_metric(&t, "a_total", "counter", "A counter", 42);
+	metrics_text_family(&t, "b", "gauge", "A gauge");
+	metrics_text_sample(&t, "b", "peer=\"x\"", 0.5);
+	assert(strcmp(t.buf, "# HELP a_total A counter\n# TYPE a_total counter\na_total 42\n"
+				"# HELP b A gauge\n# TYPE b gauge\nb{peer=\"x\"} 0.5\n") == 0);
+	assert(t.len == strlen(t.buf));
+
+	metrics_text_reset(&t);
+	assert(t.len == 0);
+	metrics_text_printf(&t, "%0999d", 1);  // grows the buffer
+	assert(t.len == 999 && t.buf[998] == '1');
+	metrics_text_deinit(&t);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void metrics_server_scrape_test()
+{
+	struct metrics_server * ms;
+	struct metrics_text t;
+	struct stat st;
+	char buff[256];
+	FILE * fp;
+
+	assert(metrics_server_create(NULL, NULL, NULL) == NULL);
+	unlink(SOCKET_PATH);
+	fp = fopen(SOCKET_PATH, "w");  // not a stale socket, must be left alone
+	fclose(fp);
+	assert(metrics_server_create(SOCKET_PATH, NULL, NULL) == NULL);
+	assert(access(SOCKET_PATH, F_OK) == 0);
+	unlink(SOCKET_PATH);
+
+	ms = metrics_server_create(SOCKET_PATH, NULL, NULL);
+	assert(ms);
+	assert(stat(SOCKET_PATH, &st) == 0);
+	assert(S_ISSOCK(st.st_mode));
+	assert((st.st_mode & 0777) == 0600);
+	assert(access(CONTROL_PATH, F_OK) != 0);  // no command handler
+
+	assert(scrape(buff, sizeof(buff)) == 0);  // nothing published yet
+
+	memset(&t, 0, sizeof(struct metrics_text));
+	metrics_text_metric(&t, "x", "gauge", "X", 1);
+	assert(metrics_server_publish(ms, &t) == 0);
+	assert(scrape(buff, sizeof(buff)) == (int) t.len);
+	assert(strcmp(buff, t.buf) == 0);
+
+	metrics_text_reset(&t);
+	metrics_text_metric(&t, "x", "gauge", "X", 2);
+	metrics_server_publish(ms, &t);
+	scrape(buff, sizeof(buff));
+	assert(strstr(buff, "\nx 2\n"));
+	assert(metrics_server_scrapes(ms) == 3);
+
+	metrics_text_deinit(&t);
+	metrics_server_destroy(&ms);
+	assert(ms == NULL);
+	assert(access(SOCKET_PATH, F_OK) != 0);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void psinstance_metrics_test()
+{
+	struct psinstance * ps, * other;
+	struct stat st;
+	char buff[8192];
+	int len;
+
+	ps = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8010,metrics_socket=" SOCKET_PATH);
+	assert(ps);
+	assert(psinstance_metrics(NULL, buff, sizeof(buff)) < 0);
+	len = psinstance_metrics(ps, buff, sizeof(buff));
+	assert(len > 0 && len < (int) sizeof(buff));
+	assert(strstr(buff, "\npstreamer_chunks_received_total 0\n"));
+	assert(strstr(buff, "# TYPE pstreamer_delay_seconds summary\n"));
+	assert(strstr(buff, "pstreamer_trader_buffered_chunks 0\n"));
+
+	psinstance_run_timers(ps, NULL);  // publishes the first snapshot
+	assert(scrape(buff, sizeof(buff)) > 0);
+	assert(strstr(buff, "pstreamer_net_outqueue_messages"));
+
+	assert(send_command("log_chunk=1000,log_signal=0\n", buff, sizeof(buff)) > 0);
+	assert(strcmp(buff, "log_chunk=1000,log_signal=0\n") == 0);
+	assert(stat(CONTROL_PATH, &st) == 0 && (st.st_mode & 0777) == 0600);
+	assert(psinstance_set_log(ps, "log_chunk=0") == 0);
+	send_command("\n", buff, sizeof(buff));
+	assert(strcmp(buff, "log_chunk=0,log_signal=0\n") == 0);
+
+	other = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8011,log_chunk=5");
+	assert(other);  // does not touch the rates of ps
+	send_command("\n", buff, sizeof(buff));
+	assert(strcmp(buff, "log_chunk=0,log_signal=0\n") == 0);
+	psinstance_destroy(&other);
+
+	psinstance_destroy(&ps);
+	assert(access(SOCKET_PATH, F_OK) != 0);
+	assert(access(CONTROL_PATH, F_OK) != 0);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	metrics_text_test();
+	metrics_server_scrape_test();
+	psinstance_metrics_test();
+	return 0;
+}
@@ -0,0 +1,94 @@
+#include<malloc.h>
+#include<assert.h>
+#include<offer_controller.h>
+
+void offer_controller_create_test()
+{
+	struct offer_controller * oc;
+
+	oc = offer_controller_create(1, NULL);
+	assert(oc);
+	assert(offer_controller_rate(oc) == 1);
+	assert(offer_controller_chunks_per_offer(oc) == 1);
+	offer_controller_destroy(&oc);
+	assert(oc == NULL);
+
+	assert(offer_controller_rate(NULL) == 1);
+	assert(offer_controller_update(NULL, 0) == 0);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void fill_window(struct offer_controller * oc, int accepts, int chunks)
+{
+	int i;
+
+	for (i = 0; i < OFFER_CONTROL_WINDOW; i++)
+	{
+		offer_controller_reg_offer(oc);
+		if (i < accepts)
+			offer_controller_reg_accept(oc, chunks);
+	}
+}
+
+void offer_controller_increase_test()
+{
+	struct offer_controller * oc;
+
+	oc = offer_controller_create(1, "max_chunks_per_peer_offer=2");
+
+	offer_controller_reg_offer(oc);
+	assert(offer_controller_update(oc, 0) == 0);  // window not complete yet
+
+	fill_window(oc, OFFER_CONTROL_WINDOW, 1);
+	assert(offer_controller_update(oc, 0) == 1);
+	assert(offer_controller_rate(oc) > 1);
+	assert(offer_controller_chunks_per_offer(oc) == 2);
+
+	fill_window(oc, OFFER_CONTROL_WINDOW, 2);
+	offer_controller_update(oc, 0);
+	assert(offer_controller_chunks_per_offer(oc) == 2);  // upper bound
+
+	offer_controller_destroy(&oc);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void offer_controller_decrease_test()
+{
+	struct offer_controller * oc;
+	double rate;
+
+	oc = offer_controller_create(1, "outqueue_threshold=100");
+
+	fill_window(oc, OFFER_CONTROL_WINDOW, 1);
+	offer_controller_update(oc, 0);
+	rate = offer_controller_rate(oc);
+
+	fill_window(oc, OFFER_CONTROL_WINDOW, 1);
+	offer_controller_update(oc, 200);  // saturated upload queue
+	assert(offer_controller_rate(oc) < rate);
+	assert(offer_controller_chunks_per_offer(oc) == 1);
+	rate = offer_controller_rate(oc);
+
+	fill_window(oc, OFFER_CONTROL_WINDOW, 1);
+	offer_controller_reg_timeouts(oc, 1);
+	offer_controller_update(oc, 0);
+	assert(offer_controller_rate(oc) < rate);
+
+	fill_window(oc, OFFER_CONTROL_WINDOW, 1);
+	offer_controller_update(oc, 1000);
+	fill_window(oc, OFFER_CONTROL_WINDOW, 1);
+	offer_controller_update(oc, 1000);
+	assert(offer_controller_rate(oc) > 0);
+
+	offer_controller_destroy(&oc);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	offer_controller_create_test();
+	offer_controller_increase_test();
+	offer_controller_decrease_test();
+	return 0;
+}
@@ -3,6 +3,9 @@
 #include<output.h>
 #include<chunk.h>
 #include<string.h>
+#include<mono_clock.h>
+#include<stdlib.h>
+#include<unistd.h>
 
 
 struct chunk * create_chunk(int id)
@@ -321,6 +324,99 @@ void output_destroy_test()
 	fprintf(stderr,"%s successfully passed!\n",__func__);
 }
 
+int deliver_at(struct chunk_output * outg, int id, uint64_t now)
+{
+	struct chunk * c;
+	int res;
+
+	mono_clock_fake_set(now);
+	c = create_chunk(id);
+	c->timestamp = id * 40000;
+	res = output_deliver(outg, c);
+	destroy_chunk(&c);
+	return res;
+}
+
+void output_jitter_buffer_test()
+{
+	struct chunk_output * outg;
+	struct output_playout_stats stats;
+	uint64_t t0 = 1000000;
+
+	outg = output_create(NULL, "dechunkiser=dummy");
+	assert(output_periodic(outg) < 0);  // ID based reordering
+	assert(output_playout_stats(outg, &stats) < 0);
+	output_destroy(&outg);
+
+	outg = output_create(NULL, "dechunkiser=dummy,playout_delay=100,adaptive_playout=0");
+	assert(deliver_at(outg, 1, t0) == 0);  // held until t0 + 100ms
+	assert(deliver_at(outg, 3, t0 + 80000) == 0);  // chunk 2 is missing
+
+	mono_clock_fake_set(t0 + 100000);
+	assert(output_periodic(outg) > 0);
+	assert(output_playout_stats(outg, &stats) == 0);
+	assert(stats.released == 1 && stats.skipped == 0);
+
+	mono_clock_fake_set(t0 + 180000);  // chunk 3 is due, the hole is skipped
+	output_periodic(outg);
+	output_playout_stats(outg, &stats);
+	assert(stats.released == 2 && stats.skipped == 1);
+
+	assert(deliver_at(outg, 2, t0 + 190000) == 0);
+	output_playout_stats(outg, &stats);
+	assert(stats.late == 1);
+	assert(stats.delay == 100000);  // not adaptive
+
+	assert(deliver_at(outg, 4, t0 + 300000) == 1);  // arrived past its deadline, played at once
+	output_destroy(&outg);
+
+	outg = output_create(NULL, "dechunkiser=dummy,playout_delay=10,playout_delay_max=200");
+	deliver_at(outg, 1, t0);
+	deliver_at(outg, 2, t0 + 140000);  // 100ms of jitter
+	output_playout_stats(outg, &stats);
+	assert(stats.jitter > 0);
+	assert(stats.delay > 10000 && stats.delay <= 200000);
+	output_destroy(&outg);
+
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void output_raw_batch_test()
+{
+	struct chunk * c;
+	struct chunk_output * outg;
+	char path[] = "/tmp/output_raw_testXXXXXX";
+	char buff[256];
+	int fd, res, ids[] = {1, 3, 4, 2, 5};
+	ssize_t len;
+	uint8_t i;
+
+	fd = mkstemp(path);
+	assert(fd >= 0);
+	sprintf(buff, "output_raw=%s,outbuff_size=8", path);
+	outg = output_create(NULL, buff);
+	assert(outg);
+
+	for (i = 0; i < 5; i++)
+	{
+		c = create_chunk(ids[i]);
+		res = output_deliver(outg, c);
+		destroy_chunk(&c);
+	}
+	assert(res == 1);
+	output_destroy(&outg);
+
+	len = read(fd, buff, sizeof(buff) - 1);
+	assert(len > 0);
+	buff[len] = '\0';
+	assert(strcmp(buff, "ciao - 1ciao - 2ciao - 3ciao - 4ciao - 5") == 0);
+	close(fd);
+	unlink(path);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
 int main()
 {
 	output_create_test();
@@ -331,6 +427,8 @@ int main()
 	output_ordering_duplicates_test();
 	output_noreordering_test();
 	output_destroy_test();
+	output_jitter_buffer_test();
+	output_raw_batch_test();
 	return 0;
 }
 
@@ -0,0 +1,117 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<unistd.h>
+#include<output_writer.h>
+
+int written[256];
+int written_len;
+volatile int gate_open;
+
+void record_write(void * arg, const struct chunk ** chunks, int n)
+{
+	int i;
+
+	(void) arg;
+	while (!__atomic_load_n(&gate_open, __ATOMIC_ACQUIRE))
+		usleep(100);
+	for (i = 0; i < n; i++)
+		written[written_len++] = chunks[i]->id;
+}
+
+struct shared_chunk * new_chunk(int id)
+{
+	struct chunk c;
+	uint8_t data[4];
+
+	memset(&c, 0, sizeof(struct chunk));
+	c.id = id;
+	c.size = 4;
+	c.data = data;
+	return shared_chunk_create(NULL, &c);
+}
+
+void output_writer_block_test()
+{
+	struct output_writer * w;
+	struct output_writer_stats stats;
+	int i;
+
+	assert(output_writer_create(0, OUTPUT_BLOCK, record_write, NULL) == NULL);
+	assert(output_writer_push(NULL, NULL) < 0);
+
+	written_len = 0;
+	gate_open = 1;
+	w = output_writer_create(4, OUTPUT_BLOCK, record_write, NULL);
+	for (i = 0; i < 20; i++)
+		assert(output_writer_push(w, new_chunk(i)) == 0);
+	output_writer_stats(w, &stats);
+	assert(stats.queued == 20);
+	assert(stats.dropped == 0);
+	assert(stats.max_lag <= 4);
+	output_writer_destroy(&w);
+	assert(w == NULL);
+
+	assert(written_len == 20);
+	for (i = 0; i < 20; i++)
+		assert(written[i] == i);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void output_writer_drop_test()
+{
+	struct output_writer * w;
+	struct output_writer_stats stats;
+	int i;
+
+	written_len = 0;
+	gate_open = 0;  // the sink is stuck
+	w = output_writer_create(4, OUTPUT_DROP_OLDEST, record_write, NULL);
+	for (i = 0; i < 20; i++)
+		assert(output_writer_push(w, new_chunk(i)) >= 0);  // never waits
+	output_writer_stats(w, &stats);
+	assert(stats.queued == 20);
+	assert(stats.written == 0);
+	/* the first write never returns: its batch holds at most a queue size
+	 * worth of chunks and the queue holds the other 4 kept */
+	assert(stats.dropped >= 12);
+	assert(stats.lag == stats.queued - stats.dropped);
+
+	__atomic_store_n(&gate_open, 1, __ATOMIC_RELEASE);
+	output_writer_destroy(&w);
+	assert(written_len == 20 - (int) stats.dropped);
+	assert(written[written_len - 1] == 19);  // the newest are kept
+	for (i = 1; i < written_len; i++)
+		assert(written[i] > written[i-1]);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void output_writer_small_queue_test()
+{
+	struct output_writer * w;
+	int i;
+
+	written_len = 0;
+	gate_open = 1;
+	w = output_writer_create(2, OUTPUT_BLOCK, record_write, NULL);  // smaller than a batch
+	for (i = 0; i < 200; i++)
+		assert(output_writer_push(w, new_chunk(i)) == 0);
+	output_writer_destroy(&w);  // must not wait for room in the done ring forever
+	assert(w == NULL);
+
+	assert(written_len == 200);
+	for (i = 0; i < 200; i++)
+		assert(written[i] == i);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	output_writer_block_test();
+	output_writer_drop_test();
+	output_writer_small_queue_test();
+	return 0;
+}
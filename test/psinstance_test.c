@@ -1,7 +1,12 @@
 #include<malloc.h>
 #include<assert.h>
 #include<string.h>
+#include<unistd.h>
 #include<psinstance.h>
+#include<psinstance_internal.h>
+#include<net_helpers.h>
+#include<mono_clock.h>
+#include<grapes_msg_types.h>
 
 void psinstance_create_test()
 {
@@ -58,10 +63,225 @@ void psinstance_port_test()
 	fprintf(stderr,"%s successfully passed!\n",__func__);
 }
 
+void send_messages(struct nodeID * from, struct nodeID * to, int n)
+	/* empty topology messages, which the instance only counts */
+{
+	struct timeval interval = {0, 0};
+	uint8_t msg[4] = {MSG_TYPE_TOPOLOGY, 0, 0, 0};
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		assert(send_to_peer(from, to, msg, sizeof(msg)) > 0);
+		net_helper_periodic(from, &interval);
+	}
+	usleep(10000);
+}
+
+void psinstance_poll_all_test()
+{
+	struct psinstance * ps = NULL;
+	struct psinstance_poll_summary sum;
+	struct nodeID * sender, * dst;
+	int res;
+
+	assert(psinstance_poll_all(NULL, 1000, &sum) < 0);
+
+	ps = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8002,poll_budget=4");
+	res = psinstance_poll_all(ps, 100000, &sum);  // we wake up at the first offer deadline
+	assert(res >= 0);
+	assert(sum.data_state == 0);
+	assert(sum.messages == 0);
+	assert(sum.injections == 0);
+	assert(sum.offers <= 1);
+	assert(!sum.budget_exhausted);
+	assert(psinstance_poll_all(ps, 0, NULL) >= 0);
+
+	sender = net_helper_init("127.0.0.1", 8020, NULL);
+	dst = create_node("127.0.0.1", 8002);
+	send_messages(sender, dst, 3);
+	assert(psinstance_poll_all(ps, 0, &sum) >= 3);  // all of them in one call
+	assert(sum.data_state == 1);
+	assert(sum.messages == 3);
+	assert(!sum.budget_exhausted);
+
+	send_messages(sender, dst, 6);
+	psinstance_poll_all(ps, 0, &sum);
+	assert(sum.messages == 4);  // up to poll_budget
+	assert(sum.budget_exhausted);
+	psinstance_poll_all(ps, 0, &sum);
+	assert(sum.messages == 2);
+	assert(!sum.budget_exhausted);
+
+	nodeid_free(dst);
+	net_helper_deinit(sender);
+	psinstance_destroy(&ps);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void psinstance_poll_all_timers_test()
+{
+	struct psinstance * ps;
+	struct psinstance_poll_summary sum;
+
+	mono_clock_fake_set(1000000000);
+	ps = psinstance_create("127.0.0.1", 0, "iface=lo,port=8021,source_pacing=select");
+
+	// the injection is due at once, the offer after 40 ms
+	mono_clock_fake_advance(10000);
+	psinstance_poll_all(ps, 0, &sum);
+	assert(sum.injections == 1);
+	assert(sum.offers == 0);
+
+	psinstance_destroy(&ps);
+	ps = psinstance_create("127.0.0.1", 0, "iface=lo,port=8021,source_pacing=select");
+	mono_clock_fake_advance(100000);  // both expired, in deadline order
+	psinstance_poll_all(ps, 0, &sum);
+	assert(sum.injections == 1);
+	assert(sum.offers == 1);
+	assert(!sum.offer_first);
+
+	psinstance_destroy(&ps);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void psinstance_poll_all_inputs_test()
+{
+	struct psinstance * ps;
+	struct psinstance_poll_summary sum;
+	struct nodeID * sender, * dst;
+
+	ps = psinstance_create("127.0.0.1", 0, "iface=lo,port=8022");  // paced by a timerfd
+	psinstance_poll_all(ps, 100000, &sum);  // the first chunk is due at once
+	assert(sum.data_state == 2);
+	assert(sum.injections == 1);
+	assert(sum.messages == 0);
+
+	sender = net_helper_init("127.0.0.1", 8023, NULL);
+	dst = create_node("127.0.0.1", 8022);
+	send_messages(sender, dst, 3);
+	usleep(50000);  // the next chunk is due too
+	psinstance_poll_all(ps, 0, &sum);
+	assert(sum.messages == 3);  // both the network and the input are served
+	assert(sum.injections == 1);
+
+	nodeid_free(dst);
+	net_helper_deinit(sender);
+	psinstance_destroy(&ps);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void psinstance_wait4data_test()
+{
+	struct nodeID * node;
+	int p1[2], p2[2], fds[3], i;
+	struct timeval tout;
+	char b;
+
+	node = net_helper_init("127.0.0.1", 8005, NULL);
+	assert(node);
+	assert(pipe(p1) == 0 && pipe(p2) == 0);
+	fds[0] = p1[0];
+	fds[1] = p2[0];
+	fds[2] = -1;
+
+	assert(write(p2[1], "x", 1) == 1);  // only the second input is ready
+	for (i = 0; i < 2; i++)
+	{
+		timerclear(&tout);
+		assert(psinstance_wait4data(node, &tout, fds) == 2);
+		assert(fds[0] == p1[0] && fds[1] == p2[0] && fds[2] == -1);
+	}
+	assert(read(p2[0], &b, 1) == 1);
+
+	assert(write(p1[1], "x", 1) == 1);  // the first input is still polled
+	timerclear(&tout);
+	assert(psinstance_wait4data(node, &tout, fds) == 2);
+	assert(read(p1[0], &b, 1) == 1);
+	timerclear(&tout);
+	assert(psinstance_wait4data(node, &tout, fds) == 0);
+	assert(fds[0] == p1[0] && fds[1] == p2[0] && fds[2] == -1);
+
+	close(p1[0]);
+	close(p1[1]);
+	close(p2[0]);
+	close(p2[1]);
+	net_helper_deinit(node);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void psinstance_set_clock_test()
+{
+	struct psinstance * ps;
+
+	assert(psinstance_set_clock("clock=fast") < 0);
+	assert(psinstance_set_clock(NULL) == 0);  // nothing to set
+	assert(psinstance_set_clock("clock=precise") == 0);
+	assert(mono_clock_mode() == MONO_CLOCK_PRECISE);
+
+	ps = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8024,clock=coarse");
+	assert(ps);
+	assert(mono_clock_mode() == MONO_CLOCK_PRECISE);  // instances do not override it
+	psinstance_destroy(&ps);
+
+	assert(psinstance_set_clock("clock=coarse") == 0);
+	assert(mono_clock_mode() == MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void psinstance_event_loop_test()
+{
+	struct psinstance * ps1, * ps2;
+	struct psinstance_fd fds[FDSSIZE];
+	suseconds_t next;
+	int n;
+
+	assert(psinstance_fds(NULL, fds, FDSSIZE) < 0);
+	assert(psinstance_next_deadline(NULL) < 0);
+	assert(psinstance_on_readable(NULL, 0) < 0);
+	assert(psinstance_on_writable(NULL) < 0);
+	assert(psinstance_on_timer(NULL) < 0);
+
+	ps1 = psinstance_create("127.0.0.1", 0, "iface=lo,port=8003");  // source, no input
+	ps2 = psinstance_create("127.0.0.1", 8003, "iface=lo,port=8004");
+	n = psinstance_fds(ps2, fds, FDSSIZE);
+	assert(n == 1);
+	assert(fds[0].events & POLLIN);
+	assert(psinstance_fds(ps2, fds, 0) == 0);
+
+	next = psinstance_next_deadline(ps2);
+	assert(next >= 0 && next <= 1000000);
+	assert(psinstance_on_readable(ps2, fds[0].fd) == 0);  // nothing to read, must not block
+	assert(psinstance_on_writable(ps2) >= 0);
+
+	usleep(next);
+	assert(psinstance_on_timer(ps2) > 0);  // at least the topology task
+	for (n = 0; n < 100 && psinstance_next_deadline(ps2) == 0; n++)
+		psinstance_on_writable(ps2);  // flushing the topology messages
+
+	assert(psinstance_fds(ps1, fds, FDSSIZE) == 2);  // inputs without fds are paced by a timerfd
+	assert(psinstance_on_readable(ps1, fds[0].fd) >= 0);
+	assert(psinstance_on_readable(ps1, fds[1].fd) >= 0);
+	psinstance_destroy(&ps1);
+
+	ps1 = psinstance_create("127.0.0.1", 0, "iface=lo,port=8003,source_pacing=select");
+	assert(psinstance_fds(ps1, fds, FDSSIZE) == 1);  // or by the chunk timer
+	psinstance_destroy(&ps1);
+	psinstance_destroy(&ps2);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
 int main()
 {
 	psinstance_create_test();
 	psinstance_ip_address_test();
 	psinstance_port_test();
+	psinstance_poll_all_test();
+	psinstance_poll_all_timers_test();
+	psinstance_poll_all_inputs_test();
+	psinstance_wait4data_test();
+	psinstance_set_clock_test();
+	psinstance_event_loop_test();
 	return 0;
 }
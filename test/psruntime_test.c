@@ -0,0 +1,78 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<unistd.h>
+#include<psinstance.h>
+#include<psruntime.h>
+
+void psruntime_single_thread_test()
+{
+	struct psruntime * rt = NULL;
+	struct psinstance * ps1, * ps2;
+	int i;
+
+	psruntime_destroy(NULL);
+	psruntime_destroy(&rt);
+	assert(psruntime_add(NULL, NULL) < 0);
+	assert(psruntime_run_once(NULL, 0) < 0);
+
+	rt = psruntime_create(NULL);
+	assert(rt);
+	assert(psruntime_instances(rt) == 0);
+	assert(psruntime_start(rt) < 0);  // no threads configured
+
+	ps1 = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8010");
+	ps2 = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8011");
+	assert(psruntime_add(rt, ps1) == 0);
+	assert(psruntime_add(rt, ps2) == 0);
+	assert(psruntime_instances(rt) == 2);
+
+	for (i = 0; i < 5; i++)
+		assert(psruntime_run_once(rt, 10000) >= 0);
+
+	assert(psruntime_remove(rt, ps1) == 0);
+	assert(psruntime_remove(rt, ps1) < 0);
+	assert(psruntime_instances(rt) == 1);
+	assert(psruntime_run_once(rt, 0) >= 0);
+
+	psruntime_destroy(&rt);
+	assert(rt == NULL);
+	psinstance_destroy(&ps1);
+	psinstance_destroy(&ps2);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void psruntime_thread_pool_test()
+{
+	struct psruntime * rt = NULL;
+	struct psinstance * ps1, * ps2;
+
+	rt = psruntime_create("threads=2");
+	assert(rt);
+	assert(psruntime_run_once(rt, 0) < 0);  // reactors belong to the pool
+
+	ps1 = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8012");
+	ps2 = psinstance_create("127.0.0.1", 5000, "iface=lo,port=8013");
+	assert(psruntime_add(rt, ps1) == 0);
+	assert(psruntime_add(rt, ps2) == 0);
+	assert(psruntime_start(rt) == 0);
+	assert(psruntime_start(rt) < 0);
+	usleep(50000);
+
+	assert(psruntime_remove(rt, ps1) == 0);  // while the reactors run
+	psinstance_destroy(&ps1);
+	usleep(50000);
+	psruntime_stop(rt);
+
+	assert(psruntime_remove(rt, ps2) == 0);
+	psruntime_destroy(&rt);
+	psinstance_destroy(&ps2);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	psruntime_single_thread_test();
+	psruntime_thread_pool_test();
+	return 0;
+}
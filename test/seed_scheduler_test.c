@@ -0,0 +1,146 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<net_helper.h>
+#include<peer.h>
+#include<peer_metadata.h>
+#include<chunkidset.h>
+#include<seed_scheduler.h>
+
+#define N_PEERS 6
+
+struct peer * create_peer(int port)
+{
+	struct peer * p;
+
+	p = malloc(sizeof(struct peer));
+	p->id = create_node("10.0.0.1", port);
+	peer_data_init(p);
+	return p;
+}
+
+void destroy_peer(struct peer ** p)
+{
+	if (p && *p)
+	{
+		peer_data_deinit(*p);
+		nodeid_free((*p)->id);
+		free(*p);
+		*p = NULL;
+	}
+}
+
+double double_weight_first(struct peer **p)
+{
+	return node_port((*p)->id) == 6000 ? 2 : 1;
+}
+
+void seed_scheduler_create_test()
+{
+	struct seed_scheduler * ss;
+	size_t n;
+
+	ss = seed_scheduler_create(NULL);
+	assert(ss);
+	assert(seed_scheduler_multiplicity(ss, 5) == 5);
+	assert(seed_scheduler_select(ss, NULL, 0, 1, 3, NULL, &n) == NULL);
+	assert(n == 0);
+	seed_scheduler_destroy(&ss);
+	assert(ss == NULL);
+
+	ss = seed_scheduler_create("adaptive_multiplicity=1,source_multiplicity=2");
+	assert(seed_scheduler_multiplicity(ss, 5) == 2);
+	seed_scheduler_destroy(&ss);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void seed_scheduler_rotation_test()
+{
+	struct seed_scheduler * ss;
+	struct peer * peers[N_PEERS];
+	struct PeerChunk * pairs;
+	struct nodeID * prev[3] = {NULL, NULL, NULL};
+	int i, j, k, seeded[N_PEERS];
+	size_t n;
+
+	ss = seed_scheduler_create(NULL);
+	for (i = 0; i < N_PEERS; i++)
+	{
+		peers[i] = create_peer(6000 + i);
+		seeded[i] = 0;
+	}
+
+	for (i = 0; i < 40; i++)
+	{
+		pairs = seed_scheduler_select(ss, peers, N_PEERS, i, 3, double_weight_first, &n);
+		assert(n == 3);
+		for (j = 0; j < 3; j++)
+		{
+			assert(pairs[j].chunk == i);
+			for (k = 0; k < 3; k++)  // seed sets of consecutive chunks are distinct
+				assert(prev[k] == NULL || !nodeid_equal(prev[k], pairs[j].peer->id));
+			seeded[node_port(pairs[j].peer->id) - 6000]++;
+		}
+		for (j = 0; j < 3; j++)
+			prev[j] = pairs[j].peer->id;
+	}
+	for (i = 0; i < N_PEERS; i++)
+		assert(seeded[i] > 0);
+	assert(seeded[0] >= seeded[1]);
+
+	// too small neighbourhood, repetitions are unavoidable
+	pairs = seed_scheduler_select(ss, peers, 2, 41, 3, NULL, &n);
+	assert(n == 2);
+	assert(!nodeid_equal(pairs[0].peer->id, pairs[1].peer->id));
+
+	for (i = 0; i < N_PEERS; i++)
+		destroy_peer(&(peers[i]));
+	seed_scheduler_destroy(&ss);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void seed_scheduler_adapt_test()
+{
+	struct seed_scheduler * ss;
+	struct peer * peers[N_PEERS];
+	int i, j;
+
+	ss = seed_scheduler_create("adaptive_multiplicity=1,source_multiplicity=2,max_source_multiplicity=3");
+	for (i = 0; i < N_PEERS; i++)
+		peers[i] = create_peer(6000 + i);
+
+	assert(seed_scheduler_adapt(ss, peers, N_PEERS, 5) == 0);  // window not complete
+
+	// only one peer got chunk 10
+	for (i = 0; i < N_PEERS; i++)
+		chunkID_set_add_chunk(peer_bmap(peers[i]), 20);
+	chunkID_set_add_chunk(peer_bmap(peers[0]), 10);
+	for (j = 0; j < SEED_ADAPT_WINDOW - 2; j++)
+		seed_scheduler_adapt(ss, peers, N_PEERS, 20);
+	assert(seed_scheduler_adapt(ss, peers, N_PEERS, 20) == 1);
+	assert(seed_scheduler_multiplicity(ss, 0) == 3);
+	for (j = 0; j < SEED_ADAPT_WINDOW; j++)
+		seed_scheduler_adapt(ss, peers, N_PEERS, 20);
+	assert(seed_scheduler_multiplicity(ss, 0) == 3);  // upper bound
+
+	// everybody got chunk 10
+	for (i = 0; i < N_PEERS; i++)
+		chunkID_set_add_chunk(peer_bmap(peers[i]), 10);
+	for (j = 0; j < SEED_ADAPT_WINDOW; j++)
+		seed_scheduler_adapt(ss, peers, N_PEERS, 20);
+	assert(seed_scheduler_multiplicity(ss, 0) == 2);
+
+	for (i = 0; i < N_PEERS; i++)
+		destroy_peer(&(peers[i]));
+	seed_scheduler_destroy(&ss);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	seed_scheduler_create_test();
+	seed_scheduler_rotation_test();
+	seed_scheduler_adapt_test();
+	return 0;
+}
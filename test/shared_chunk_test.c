@@ -0,0 +1,138 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<shared_chunk.h>
+#include<net_helpers.h>
+#include<int_coding.h>
+#include<grapes_msg_types.h>
+
+struct chunk * create_chunk(int id, int size)
+{
+	struct chunk * c;
+
+	c = malloc(sizeof(struct chunk));
+	memset(c, 0, sizeof(struct chunk));
+	c->id = id;
+	c->size = size;
+	c->timestamp = 42;
+	c->data = malloc(size);
+	memset(c->data, id, size);
+	c->attributes_size = 2;
+	c->attributes = malloc(2);
+	memset(c->attributes, 7, 2);
+	return c;
+}
+
+void destroy_chunk(struct chunk ** c)
+{
+	free((*c)->data);
+	free((*c)->attributes);
+	free(*c);
+	*c = NULL;
+}
+
+void shared_chunk_create_test()
+{
+	struct shared_chunk * sc, * sc2;
+	const struct chunk * sh;
+	struct chunk * c;
+
+	assert(shared_chunk_create(NULL, NULL) == NULL);
+	assert(shared_chunk_get(NULL) == NULL);
+	shared_chunk_unref(NULL);
+
+	c = create_chunk(3, 100);
+	sc = shared_chunk_create(NULL, c);
+	destroy_chunk(&c);  // the shared chunk has its own copy
+
+	sh = shared_chunk_get(sc);
+	assert(sh->id == 3 && sh->size == 100 && sh->timestamp == 42);
+	assert(sh->data[0] == 3 && sh->data[99] == 3);
+	assert(sh->attributes_size == 2 && ((uint8_t *)sh->attributes)[1] == 7);
+	assert(shared_chunk_footprint(sc) >= 102);
+
+	assert(shared_chunk_refs(sc) == 1);
+	sc2 = shared_chunk_ref(sc);
+	assert(sc2 == sc && shared_chunk_refs(sc) == 2);
+	shared_chunk_unref(&sc2);
+	assert(sc2 == NULL && shared_chunk_refs(sc) == 1);
+	shared_chunk_unref(&sc);
+	assert(sc == NULL);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void shared_chunk_pool_test()
+{
+	struct shared_chunk_pool * p;
+	struct shared_chunk * sc, * big;
+	const struct chunk * sh;
+	struct chunk * c;
+
+	p = shared_chunk_pool_create(64, 1);
+	c = create_chunk(1, 50);
+	sc = shared_chunk_create(p, c);
+	sh = shared_chunk_get(sc);
+	shared_chunk_unref(&sc);  // back to the pool
+
+	c->id = 2;
+	sc = shared_chunk_create(p, c);
+	assert(shared_chunk_get(sc) == sh);  // recycled block
+	assert(sh->id == 2);
+
+	c->size = 1000;
+	c->data = realloc(c->data, 1000);
+	big = shared_chunk_create(p, c);  // larger than the pool blocks
+	assert(shared_chunk_get(big)->size == 1000);
+	destroy_chunk(&c);
+
+	shared_chunk_pool_destroy(&p);
+	assert(p == NULL);
+	assert(shared_chunk_get(sc)->id == 2);  // blocks outlive their pool owner
+	shared_chunk_unref(&sc);
+	shared_chunk_unref(&big);
+
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void shared_chunk_send_test()
+{
+	struct nodeID * n1, * n2, * r;
+	struct shared_chunk * sc;
+	struct timeval interval = {0, 0};
+	struct chunk * c;
+	uint8_t buff[256];
+	uint16_t i, transids[2] = {5, 9};
+
+	n1 = net_helper_init("127.0.0.1", 6020, NULL);
+	n2 = net_helper_init("127.0.0.1", 6021, NULL);
+	c = create_chunk(3, 100);
+	sc = shared_chunk_create(NULL, c);
+	destroy_chunk(&c);
+
+	assert(shared_chunk_send(NULL, n1, n2, 1) < 0);
+	for (i = 0; i < 2; i++)
+	{
+		assert(shared_chunk_send(sc, n1, n2, transids[i]) > 100);
+		net_helper_periodic(n1, &interval);
+		assert(recv_from_peer(n2, &r, buff, sizeof(buff)) > 100);
+		nodeid_free(r);
+		assert(buff[0] == MSG_TYPE_CHUNK);
+		assert(int16_rcpy(buff + 1) == transids[i]);  // each send its own ID
+		assert(int_rcpy(buff + 3) == 3);
+	}
+	assert(shared_chunk_get(sc)->data[0] == 3);
+
+	shared_chunk_unref(&sc);
+	net_helper_deinit(n1);
+	net_helper_deinit(n2);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	shared_chunk_create_test();
+	shared_chunk_pool_test();
+	shared_chunk_send_test();
+	return 0;
+}
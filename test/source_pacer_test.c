@@ -0,0 +1,116 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<stdlib.h>
+#include<unistd.h>
+#include<poll.h>
+#include<source_pacer.h>
+#include<mono_clock.h>
+#include<chunk.h>
+#include<input.h>
+
+#define INTERVAL 5000  // microseconds
+#define CHUNKS 40
+
+uint64_t now_us()
+{
+	struct timeval tv;
+
+	mono_clock_precise(&tv);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+void source_pacer_arm_test()
+{
+	struct source_pacer * sp;
+	struct source_pacer_stats stats;
+	struct pollfd pfd;
+
+	assert(source_pacer_arm(NULL, 0) < 0);
+	assert(source_pacer_expired(NULL) < 0);
+	sp = source_pacer_create();
+	assert(sp);
+	assert(source_pacer_expired(sp) < 0);  // not armed
+
+	assert(source_pacer_arm(sp, now_us() + 1000000) == 0);
+	assert(source_pacer_expired(sp) == 0);
+	assert(source_pacer_arm(sp, now_us() + INTERVAL) == 0);
+	pfd.fd = source_pacer_fd(sp);
+	pfd.events = POLLIN;
+	assert(poll(&pfd, 1, 1000) == 1);
+	assert(source_pacer_expired(sp) == 1);
+
+	assert(source_pacer_arm(sp, 0) == 0);  // in the past
+	assert(poll(&pfd, 1, 1000) == 1);
+	assert(source_pacer_expired(sp) == 1);
+	source_pacer_stats(sp, &stats);
+	assert(stats.ticks == 2);
+
+	source_pacer_destroy(&sp);
+	assert(sp == NULL);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void source_pacer_jitter_test()
+	/* paces a mapped input, as a source does, and measures the injection
+	 * jitter and the drift against the media clock */
+{
+	struct source_pacer * sp;
+	struct source_pacer_stats stats;
+	struct input_desc * in;
+	struct chunk * c;
+	struct pollfd pfd;
+	char path[] = "/tmp/source_pacer_testXXXXXX";
+	char config[80];
+	uint8_t data[CHUNKS];
+	int fds[FDSSIZE], fd, i;
+	uint64_t start, t;
+	suseconds_t delta;
+	int64_t drift, max_drift = 0;
+
+	fd = mkstemp(path);
+	memset(data, 0, sizeof(data));
+	assert(write(fd, data, sizeof(data)) == sizeof(data));
+	close(fd);
+	sprintf(config, "input_mmap=1,input_chunk_size=1,input_chunk_interval=%d", INTERVAL);
+	start = now_us();  // the media clock starts when the input is opened
+	in = input_open(path, fds, FDSSIZE, config);
+	assert(in);
+
+	sp = source_pacer_create();
+	pfd.fd = source_pacer_fd(sp);
+	pfd.events = POLLIN;
+	source_pacer_arm(sp, input_deadline(in));
+	for (i = 0; i < CHUNKS; i++)
+	{
+		assert(poll(&pfd, 1, 1000) == 1);
+		assert(source_pacer_expired(sp) == 1);
+		t = now_us();
+		drift = (int64_t) (t - start) - (int64_t) i * INTERVAL;
+		if (drift > max_drift)
+			max_drift = drift;
+		assert(drift >= 0);  // never early
+		c = input_chunk(in, &delta);
+		assert(c);
+		input_chunk_release(&c);
+		source_pacer_arm(sp, input_deadline(in));
+	}
+	source_pacer_stats(sp, &stats);
+	fprintf(stderr, "injection lateness max %ldus, jitter %ldus, drift max %ldus\n",
+			(long) stats.max_lateness, (long) stats.jitter, (long) max_drift);
+	assert(stats.ticks == CHUNKS);
+	assert(stats.jitter < INTERVAL / 2);
+	assert(max_drift < 4 * INTERVAL);  // lateness is not accumulated
+
+	source_pacer_destroy(&sp);
+	input_close(in);
+	unlink(path);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	source_pacer_arm_test();
+	source_pacer_jitter_test();
+	return 0;
+}
@@ -0,0 +1,42 @@
+#define STAGE_TIMERS
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<unistd.h>
+#include<stage_timers.h>
+
+void stage_timers_record_test()
+{
+	struct stage_timers st;
+	struct stage_summary sum;
+	double tick_ns;
+	int i;
+
+	stage_timers_init(&st);
+	assert(stage_timers_summary(NULL, STAGE_WAIT, &sum) < 0);
+	assert(stage_timers_summary(&st, STAGES, &sum) < 0);
+	assert(stage_timers_summary(&st, STAGE_RECV, &sum) == 0);
+	assert(sum.count == 0 && sum.p99 == 0);
+
+	for (i = 0; i < 10; i++)
+		STAGE_TIMED(&st, STAGE_WAIT, usleep(1000));
+	usleep(10000);  // calibration span
+	tick_ns = stage_timers_tick_ns(&st);
+	assert(tick_ns > 0);
+	assert(stage_timers_summary(&st, STAGE_WAIT, &sum) == 0);
+	assert(sum.count == 10);
+	assert(sum.p50 > 900000 && sum.p50 < 100000000);  // about a millisecond
+	assert(sum.max >= sum.p99 && sum.p99 >= sum.p50);
+	assert(sum.sum >= 10 * 900000);
+
+	stage_timers_add(&st, STAGES, 1);  // ignored
+	assert(strcmp(stage_name(STAGE_PARSE_CHUNK), "parse_chunk") == 0);
+	assert(strcmp(stage_name(STAGES), "unknown") == 0);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	stage_timers_record_test();
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<streaming_timers.h>
+#include<mono_clock.h>
+
+int runs[3];
+int order[8];
+int order_len;
+
+suseconds_t task_a(void * arg)
+{
+	(void) arg;
+	runs[0]++;
+	order[order_len++] = 0;
+	return 10000;
+}
+
+suseconds_t task_b(void * arg)
+{
+	(void) arg;
+	runs[1]++;
+	order[order_len++] = 1;
+	return 25000;
+}
+
+suseconds_t task_once(void * arg)
+{
+	(void) arg;
+	runs[2]++;
+	order[order_len++] = 2;
+	return -1;
+}
+
+void reset_runs()
+{
+	memset(runs, 0, sizeof(runs));
+	order_len = 0;
+}
+
+void streaming_timers_add_task_test()
+{
+	struct streaming_timers psl;
+	uint32_t id;
+
+	mono_clock_fake_set(1000000);
+	streaming_timers_init(&psl, 40000);
+	assert(streaming_timers_add_task(NULL, task_a, NULL, 0) == 0);
+	assert(streaming_timers_add_task(&psl, NULL, NULL, 0) == 0);
+	assert(streaming_timers_add_task(&psl, task_a, NULL, -1) == 0);
+
+	id = streaming_timers_add_task(&psl, task_a, NULL, 1000);
+	assert(id > 0);
+	assert(streaming_timers_remove_task(&psl, id) == 0);
+	assert(streaming_timers_remove_task(&psl, id) < 0);
+	assert(psl.tasks_len == 0);
+
+	streaming_timers_deinit(&psl);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void streaming_timers_run_tasks_test()
+{
+	struct streaming_timers psl;
+
+	reset_runs();
+	mono_clock_fake_set(1000000);
+	streaming_timers_init(&psl, 40000);
+	streaming_timers_add_task(&psl, task_b, NULL, 5000);
+	streaming_timers_add_task(&psl, task_a, NULL, 10000);
+	streaming_timers_add_task(&psl, task_once, NULL, 2000);
+
+	assert(streaming_timers_run_tasks(&psl) == 0);
+
+	// the sleep timer is set to the earliest deadline
+	streaming_timers_set_timeout(&psl, 1000000, 0);
+	assert(psl.sleep_timer.tv_sec == 0 && psl.sleep_timer.tv_usec == 2000);
+
+	mono_clock_fake_advance(10000);
+	assert(streaming_timers_run_tasks(&psl) == 3);
+	assert(order[0] == 2 && order[1] == 1 && order[2] == 0);  // deadline order
+	assert(psl.tasks_len == 2);  // task_once is gone
+
+	mono_clock_fake_advance(10000);
+	assert(streaming_timers_run_tasks(&psl) == 1);
+	assert(runs[0] == 2 && runs[1] == 1 && runs[2] == 1);
+
+	mono_clock_fake_advance(1000000);  // late, each task runs once
+	assert(streaming_timers_run_tasks(&psl) == 2);
+
+	streaming_timers_deinit(&psl);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void streaming_timers_expired_test()
+{
+	struct streaming_timers psl;
+	enum streaming_action actions[2];
+
+	mono_clock_fake_set(1000000);
+	streaming_timers_init(&psl, 40000);  // injection due now, offer in 40 ms
+	assert(streaming_timers_expired(&psl, 1, actions) == 0);
+
+	mono_clock_fake_advance(50000);
+	assert(streaming_timers_expired(&psl, 0, actions) == 1);
+	assert(actions[0] == OFFER_ACTION);
+	assert(streaming_timers_expired(&psl, 1, actions) == 2);
+	assert(actions[0] == INJECT_ACTION && actions[1] == OFFER_ACTION);
+
+	streaming_timers_update_chunk_time(&psl, 60000);  // now the offer comes first
+	mono_clock_fake_advance(100000);
+	assert(streaming_timers_expired(&psl, 1, actions) == 2);
+	assert(actions[0] == OFFER_ACTION && actions[1] == INJECT_ACTION);
+
+	streaming_timers_deinit(&psl);
+	mono_clock_set_mode(MONO_CLOCK_COARSE);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	streaming_timers_add_task_test();
+	streaming_timers_run_tasks_test();
+	streaming_timers_expired_test();
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include<malloc.h>
+#include<assert.h>
+#include<string.h>
+#include<stdlib.h>
+#include<unistd.h>
+#include<tracer.h>
+#include<chunk_attributes.h>
+#include<net_helper.h>
+
+#define TRACE_PATH "/tmp/tracer_test.trace"
+
+void tracer_create_test()
+{
+	struct tracer * t;
+
+	assert(tracer_create(NULL) == NULL);
+	assert(tracer_create("port=6000") == NULL);
+	assert(tracer_create("trace_file=/nonexistent/dir/trace") == NULL);
+	assert(tracer_chunk(NULL, NULL, NULL, NULL, TRACE_SENT) < 0);
+
+	t = tracer_create("trace_file=" TRACE_PATH);
+	assert(t);
+	assert(tracer_dropped(t) == 0);
+	tracer_destroy(&t);
+	assert(t == NULL);
+	unlink(TRACE_PATH);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+void tracer_decode_test()
+{
+	struct tracer * t;
+	struct nodeID * me, * peer;
+	struct chunk c;
+	FILE * in, * out;
+	char * csv, line[256], addr[64];
+	uint64_t dropped;
+	size_t len;
+	int i;
+
+	me = create_node("10.0.0.1", 6000);
+	peer = create_node("10.0.0.2", 6001);
+	memset(&c, 0, sizeof(struct chunk));
+	c.id = 42;
+	c.size = 1000;
+	c.timestamp = 123456;
+	chunk_attributes_init(&c);
+	chunk_attributes_update_upon_reception(&c);
+
+	t = tracer_create("trace_file=" TRACE_PATH ",trace_records=16");
+	for (i = 0; i < 100; i++)  // wraps the ring
+	{
+		tracer_chunk(t, peer, me, &c, TRACE_RECEIVED);
+		if (i % 10 == 0)
+			usleep(20000);  // lets the flusher catch up
+	}
+	tracer_chunk(t, me, NULL, NULL, TRACE_CACHE_MISS);
+	tracer_signal(t, me, peer, 3, 7, sig_accept, TRACE_SENT);
+	dropped = tracer_dropped(t);
+	assert(dropped < 100);
+	tracer_destroy(&t);
+
+	in = fopen(TRACE_PATH, "r");
+	assert(in);
+	out = open_memstream(&csv, &len);
+	assert(tracer_decode(in, out) == 102 - (int64_t) dropped);
+	fclose(out);
+	fclose(in);
+
+	in = fmemopen(csv, len, "r");
+	assert(fgets(line, sizeof(line), in));
+	assert(strncmp(line, "[CHUNK_LOG],", 12) == 0);
+	assert(strstr(line, ",42,1000,123456,1,RECEIVED\n"));
+	node_addr(peer, addr, sizeof(addr));
+	assert(strstr(line, addr));
+	assert(strstr(csv, ",ND,-1,-1,0,0,CACHE_MISS\n"));
+	assert(strstr(csv, "[SIGNAL_LOG],"));
+	assert(strstr(csv, ",7,ACCEPT_SIG,SENT\n"));
+	fclose(in);
+	free(csv);
+
+	in = fopen("/dev/null", "r");
+	assert(tracer_decode(in, stdout) < 0);
+	fclose(in);
+
+	chunk_attributes_deinit(&c);
+	nodeid_free(me);
+	nodeid_free(peer);
+	unlink(TRACE_PATH);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
+int main()
+{
+	tracer_create_test();
+	tracer_decode_test();
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include<malloc.h>
 #include<assert.h>
+#include<unistd.h>
 #include<transaction.h>
 
 void transaction_create_test()
@@ -54,9 +55,41 @@ void transaction_reg_accept_test()
 	fprintf(stderr,"%s successfully passed!\n",__func__);
 }
 
+void transaction_measures_test()
+{
+	struct service_times_element * head = NULL;
+	struct nodeID * id = NULL;
+	uint16_t tid;
+
+	assert(transaction_rtt(head, 1) < 0);
+	assert(transaction_byterate(head, 1) < 0);
+	assert(!transaction_reg_sent_bytes(head, 1, 100));
+
+	id = create_node("127.0.0.1", 6000);
+	tid = transaction_create(&head, id);
+
+	assert(transaction_rtt(head, tid) < 0);  // no accept yet
+	assert(transaction_reg_sent_bytes(head, tid, 1000));
+	assert(transaction_byterate(head, tid) < 0);  // no accept yet
+
+	usleep(1000);
+	transaction_reg_accept(head, tid, id);
+	assert(transaction_rtt(head, tid) > 0);
+	assert(transaction_rtt(head, tid+1) < 0);
+
+	usleep(1000);
+	assert(transaction_byterate(head, tid) > 0);
+	assert(transaction_byterate(head, tid) < 1000000);
+
+	nodeid_free(id);
+	transaction_destroy(&head);
+	fprintf(stderr,"%s successfully passed!\n",__func__);
+}
+
 int main()
 {
 	transaction_create_test();
 	transaction_reg_accept_test();
+	transaction_measures_test();
 	return 0;
 }